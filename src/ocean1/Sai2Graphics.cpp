@@ -7,14 +7,25 @@
 
 #include "Sai2Graphics.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <deque>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <unordered_map>
 
 #ifdef MACOSX
 #include <filesystem>
 #endif
 
+#include "frame_writer.h"
+#include "mesh_cache.h"
 #include "parser/UrdfToSai2Graphics.h"
 
 using namespace std;
@@ -129,11 +140,38 @@ void mouseScroll(GLFWwindow* window, double xoffset, double yoffset) {
 	}
 }
 
-GLFWwindow* glfwInitialize(const std::string& window_name) {
+// size of the window that holds the context when rendering offscreen. Its
+// framebuffer is not used, the frames are captured in their own
+const int OFFSCREEN_WINDOW_WIDTH = 640;
+const int OFFSCREEN_WINDOW_HEIGHT = 480;
+
+GLFWwindow* glfwInitialize(const std::string& window_name, bool offscreen,
+						   int context_creation_api) {
 	/*------- Set up visualization -------*/
 	// set up error callback
 	glfwSetErrorCallback(glfwError);
 
+	if (offscreen) {
+#ifdef GLFW_PLATFORM_NULL
+		// no display server needed
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+		glfwInit();
+		glfwWindowHint(GLFW_VISIBLE, 0);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, context_creation_api);
+		GLFWwindow* window =
+			glfwCreateWindow(OFFSCREEN_WINDOW_WIDTH, OFFSCREEN_WINDOW_HEIGHT,
+							 window_name.c_str(), NULL, NULL);
+		if (!window) {
+			throw std::runtime_error(
+				"could not create the offscreen OpenGL context");
+		}
+		glfwMakeContextCurrent(window);
+		// nothing to synchronize with
+		glfwSwapInterval(0);
+		return window;
+	}
+
 	// initialize GLFW
 	glfwInit();
 
@@ -160,14 +198,327 @@ GLFWwindow* glfwInitialize(const std::string& window_name) {
 
 	return window;
 }
+
+// arrays of a mesh in the cache layout, from a mapped cache file or a parsed
+// obj file
+struct MeshArrays {
+	const Ocean1::MeshVertex* vertices;
+	size_t num_vertices;
+	const uint32_t* indices;
+	const Ocean1::MeshSubmesh* submeshes;
+	size_t num_submeshes;
+	const Ocean1::MeshMaterial* materials;
+	size_t num_materials;
+};
+
+MeshArrays meshArrays(const Ocean1::MappedMesh& mesh) {
+	return {mesh.vertices(),  mesh.numVertices(),	mesh.indices(),
+			mesh.submeshes(), mesh.numSubmeshes(), mesh.materials(),
+			mesh.numMaterials()};
+}
+
+MeshArrays meshArrays(const Ocean1::MeshData& mesh) {
+	return {mesh.vertices.data(),  mesh.vertices.size(),	mesh.indices.data(),
+			mesh.submeshes.data(), mesh.submeshes.size(), mesh.materials.data(),
+			mesh.materials.size()};
+}
+
+// build the chai meshes of a mesh, one per submesh like the chai obj loader,
+// not attached to any multi mesh. Does not use OpenGL, so it can run on any
+// thread.
+std::vector<cMesh*> buildMeshes(const MeshArrays& source_mesh,
+								const std::string& source_directory) {
+	std::vector<cMaterialPtr> materials;
+	std::vector<cTexture2dPtr> textures;
+	for (size_t i = 0; i < source_mesh.num_materials; ++i) {
+		const Ocean1::MeshMaterial& source = source_mesh.materials[i];
+		cMaterialPtr material = cMaterial::create();
+		material->m_ambient.set(source.ambient[0], source.ambient[1],
+								source.ambient[2], source.opacity);
+		material->m_diffuse.set(source.diffuse[0], source.diffuse[1],
+								source.diffuse[2], source.opacity);
+		material->m_specular.set(source.specular[0], source.specular[1],
+								 source.specular[2], source.opacity);
+		material->setShininess(source.shininess);
+		materials.push_back(material);
+
+		cTexture2dPtr texture;
+		if (source.texture[0] != '\0') {
+			texture = cTexture2d::create();
+			if (!texture->loadFromFile(source_directory + "/" +
+									   source.texture)) {
+				texture.reset();
+			}
+		}
+		textures.push_back(texture);
+	}
+
+	std::vector<cMesh*> meshes;
+	// index of the source vertices in the current mesh
+	std::vector<int> mesh_indices(source_mesh.num_vertices, -1);
+	for (size_t i = 0; i < source_mesh.num_submeshes; ++i) {
+		const Ocean1::MeshSubmesh& submesh = source_mesh.submeshes[i];
+		cMesh* mesh = new cMesh();
+		std::fill(mesh_indices.begin(), mesh_indices.end(), -1);
+		const uint32_t* indices = source_mesh.indices + submesh.index_offset;
+		for (uint32_t j = 0; j + 2 < submesh.index_count; j += 3) {
+			unsigned int triangle[3];
+			for (int k = 0; k < 3; ++k) {
+				const uint32_t index = indices[j + k];
+				if (mesh_indices[index] < 0) {
+					const Ocean1::MeshVertex& vertex =
+						source_mesh.vertices[index];
+					mesh_indices[index] =
+						mesh->newVertex(vertex.position[0], vertex.position[1],
+										vertex.position[2]);
+					mesh->m_vertices->setNormal(mesh_indices[index],
+												vertex.normal[0],
+												vertex.normal[1],
+												vertex.normal[2]);
+					mesh->m_vertices->setTexCoord(mesh_indices[index],
+												  vertex.uv[0], vertex.uv[1]);
+				}
+				triangle[k] = mesh_indices[index];
+			}
+			mesh->newTriangle(triangle[0], triangle[1], triangle[2]);
+		}
+
+		if (submesh.material >= 0 &&
+			submesh.material < (int)source_mesh.num_materials) {
+			const Ocean1::MeshMaterial& source =
+				source_mesh.materials[submesh.material];
+			mesh->setMaterial(materials[submesh.material]);
+			mesh->setUseMaterial(true);
+			if (source.opacity < 1.0f) {
+				mesh->setUseTransparency(true);
+				mesh->setTransparencyLevel(source.opacity);
+			}
+			if (textures[submesh.material]) {
+				mesh->setTexture(textures[submesh.material]);
+				mesh->setUseTexture(true);
+			}
+		}
+		mesh->computeBoundaryBox(true);
+		meshes.push_back(mesh);
+	}
+	return meshes;
+}
+
+// chai meshes of every level of detail of a mesh file, from its cache files
+// if they are fresh and valid and from the obj file otherwise. Throws
+// std::runtime_error if the full mesh cannot be loaded.
+std::vector<std::vector<cMesh*>> buildMeshLevels(const std::string& cache_dir,
+												 const std::string& filename) {
+	const std::string directory = filename.substr(0, filename.find_last_of('/'));
+	std::vector<std::vector<cMesh*>> levels;
+	const std::string cache_path =
+		cache_dir.empty() ? "" : Ocean1::meshCachePath(cache_dir, filename);
+	if (!cache_path.empty() && Ocean1::isMeshCacheFresh(cache_path, filename)) {
+		try {
+			levels.push_back(buildMeshes(
+				meshArrays(Ocean1::MappedMesh(cache_path)), directory));
+		} catch (const std::runtime_error& e) {
+			cerr << "ignoring mesh cache: " << e.what() << endl;
+		}
+	}
+	if (levels.empty()) {
+		levels.push_back(buildMeshes(
+			meshArrays(Ocean1::parseObjMesh(filename)), directory));
+		return levels;
+	}
+	for (int lod = 1; lod <= Ocean1::MESH_CACHE_LOD_LEVELS; ++lod) {
+		const std::string lod_path =
+			Ocean1::meshCachePath(cache_dir, filename, lod);
+		if (!Ocean1::isMeshCacheFresh(lod_path, filename)) {
+			break;
+		}
+		try {
+			levels.push_back(
+				buildMeshes(meshArrays(Ocean1::MappedMesh(lod_path)), directory));
+		} catch (const std::runtime_error& e) {
+			cerr << "ignoring mesh cache: " << e.what() << endl;
+			break;
+		}
+	}
+	return levels;
+}
+
+void deleteMeshLevels(std::vector<std::vector<cMesh*>>& levels) {
+	for (auto& level : levels) {
+		for (auto mesh : level) {
+			delete mesh;
+		}
+	}
+	levels.clear();
+}
+
+bool isObjFile(const std::string& filename) {
+	const size_t dot = filename.find_last_of('.');
+	if (dot == std::string::npos) {
+		return false;
+	}
+	std::string extension = filename.substr(dot + 1);
+	for (auto& c : extension) {
+		c = tolower(c);
+	}
+	return extension == "obj";
+}
+
+// size of the placeholder of the meshes without cache file, whose bounding
+// box is unknown until they are parsed
+const double PLACEHOLDER_HALF_SIZE = 0.01;
+// vertices of the placeholder box at its lower and upper corners
+const unsigned int PLACEHOLDER_LOWER_VERTEX = 0;
+const unsigned int PLACEHOLDER_UPPER_VERTEX = 7;
+
+// grey box spanning lower to upper, shown while a mesh loads
+cMesh* newPlaceholderBox(cMultiMesh* multi_mesh, const Eigen::Vector3d& lower,
+						 const Eigen::Vector3d& upper) {
+	cMesh* box = multi_mesh->newMesh();
+	for (int i = 0; i < 8; ++i) {
+		box->newVertex(i & 4 ? upper(0) : lower(0), i & 2 ? upper(1) : lower(1),
+					   i & 1 ? upper(2) : lower(2));
+	}
+	const unsigned int faces[12][3] = {{0, 1, 3}, {0, 3, 2}, {4, 6, 7},
+									   {4, 7, 5}, {0, 4, 5}, {0, 5, 1},
+									   {2, 3, 7}, {2, 7, 6}, {0, 2, 6},
+									   {0, 6, 4}, {1, 5, 7}, {1, 7, 3}};
+	for (const auto& face : faces) {
+		box->newTriangle(face[0], face[1], face[2]);
+	}
+	cMaterialPtr material = cMaterial::create();
+	material->m_ambient.set(0.3f, 0.3f, 0.3f);
+	material->m_diffuse.set(0.5f, 0.5f, 0.5f);
+	material->m_specular.set(0.0f, 0.0f, 0.0f);
+	box->setMaterial(material);
+	box->setUseMaterial(true);
+	box->computeBoundaryBox(true);
+	return box;
+}
+
+// worker threads building the meshes loaded by Sai2Graphics::loadMesh
+class MeshLoadPool {
+public:
+	~MeshLoadPool() { setNumThreads(0); }
+
+	int numThreads() const { return _threads.size(); }
+
+	// waits for the queued jobs before changing the number of threads
+	void setNumThreads(int num_threads) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_all();
+		for (auto& thread : _threads) {
+			thread.join();
+		}
+		_threads.clear();
+		_stop = false;
+		for (int i = 0; i < num_threads; ++i) {
+			_threads.emplace_back(&MeshLoadPool::work, this);
+		}
+	}
+
+	void submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push_back(std::move(job));
+		}
+		_condition.notify_one();
+	}
+
+private:
+	void work() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this] { return _stop || !_jobs.empty(); });
+				if (_jobs.empty()) {
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::vector<std::thread> _threads;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stop = false;
+};
+
+MeshLoadPool& meshLoadPool() {
+	static MeshLoadPool pool;
+	return pool;
+}
+
+// hand the frame read into a pixel buffer to the writer. Nothing is mapped,
+// and the frame is dropped, if the writer has no free slot
+void writePixelBuffer(GLuint pixel_buffer, Ocean1::FrameWriter& writer) {
+	uint8_t* frame = writer.beginFrame();
+	if (!frame) {
+		return;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+	const void* pixels = glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER, 0, writer.frameBytes(), GL_MAP_READ_BIT);
+	if (pixels) {
+		memcpy(frame, pixels, writer.frameBytes());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		writer.commitFrame();
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 }  // namespace
 
 namespace Sai2Graphics {
 
+struct Sai2Graphics::PendingMesh {
+	std::string filename;
+	cMultiMesh* multi_mesh;
+	cMesh* placeholder;
+	cMaterialPtr placeholder_material;
+	Eigen::Vector3d placeholder_lower;
+	Eigen::Vector3d placeholder_upper;
+	// set by the worker, and ready once it is done
+	std::vector<std::vector<cMesh*>> levels;
+	std::promise<void> loaded_promise;
+	std::future<void> loaded;
+};
+
+struct Sai2Graphics::FrameCapture {
+	std::unique_ptr<Ocean1::FrameWriter> writer;
+	std::string camera_name;
+	int width;
+	int height;
+	std::chrono::steady_clock::duration period;
+	std::chrono::steady_clock::time_point next_frame;
+	GLuint framebuffer;
+	GLuint color_buffer;
+	GLuint depth_buffer;
+	// frames are read into one pixel buffer while the other one, read during
+	// the previous frame, is copied to the writer
+	GLuint pixel_buffers[2];
+	int next_pixel_buffer;
+	bool pending_readback;
+};
+
 Sai2Graphics::Sai2Graphics(const std::string& path_to_world_file,
-						   const std::string& window_name, bool verbose) {
+						   const std::string& window_name, bool verbose)
+	: Sai2Graphics(path_to_world_file, {}, window_name, verbose) {}
+
+Sai2Graphics::Sai2Graphics(
+	const std::string& path_to_world_file,
+	const std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>>&
+		robot_models,
+	const std::string& window_name, bool verbose) {
 	// initialize a chai world
-	initializeWorld(path_to_world_file, verbose);
+	initializeWorld(path_to_world_file, verbose, robot_models);
 #ifdef MACOSX
 	auto path = std::__fs::filesystem::current_path();
 	initializeWindow(window_name);
@@ -179,6 +530,7 @@ Sai2Graphics::Sai2Graphics(const std::string& path_to_world_file,
 
 // dtor
 Sai2Graphics::~Sai2Graphics() {
+	stopFrameCapture();
 	glfwDestroyWindow(_window);
 	glfwTerminate();
 	clearWorld();
@@ -191,54 +543,172 @@ void Sai2Graphics::resetWorld(const std::string& path_to_world_file,
 	initializeWorld(path_to_world_file, verbose);
 }
 
-void Sai2Graphics::initializeWorld(const std::string& path_to_world_file,
-								   const bool verbose) {
+void Sai2Graphics::initializeWorld(
+	const std::string& path_to_world_file, const bool verbose,
+	const std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>>&
+		robot_models) {
 	_world = new chai3d::cWorld();
+	std::map<std::string, std::shared_ptr<Eigen::Affine3d>> object_poses;
 	Parser::UrdfToSai2GraphicsWorld(path_to_world_file, _world,
-									_robot_filenames, _object_poses,
+									_robot_filenames, object_poses,
 									_camera_names, verbose);
+	_mesh_lods = std::move(_loaded_mesh_lods);
+	_loaded_mesh_lods.clear();
+	for (auto& lods : _mesh_lods) {
+		// after the parser scaled the mesh
+		computeLodBounds(lods);
+	}
+	_pending_meshes = std::move(_loading_meshes);
+	_loading_meshes.clear();
 	_current_camera_index = 0;
+	_scene_dirty = true;
+	_shadow_maps_dirty = true;
+	_frame_pending = false;
+	_last_rendered_camera = NULL;
+	_last_rendered_width = 0;
+	_last_rendered_height = 0;
+	buildWorldIndex(object_poses);
 	for (auto robot_filename : _robot_filenames) {
 		// get robot base object in chai world
-		cRobotBase* base = NULL;
-		for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-			if (robot_filename.first == _world->getChild(i)->m_name) {
-				// cast to cRobotBase
-				base = dynamic_cast<cRobotBase*>(_world->getChild(i));
-				if (base != NULL) {
-					break;
-				}
-			}
-		}
+		RobotEntry& robot = _robots[_robot_indices.at(robot_filename.first)];
+		cRobotBase* base = robot.base;
 		Eigen::Affine3d T_robot_base;
 		T_robot_base.translation() = base->getLocalPos().eigen();
 		T_robot_base.linear() = base->getLocalRot().eigen();
+		auto robot_model = robot_models.find(robot_filename.first);
 		_robot_models[robot_filename.first] =
-			std::make_shared<Sai2Model::Sai2Model>(robot_filename.second);
+			robot_model != robot_models.end()
+				? robot_model->second
+				: std::make_shared<Sai2Model::Sai2Model>(robot_filename.second);
 		_robot_models[robot_filename.first]->setTRobotBase(T_robot_base);
+		robot.model = _robot_models[robot_filename.first];
 		updateRobotGraphics(robot_filename.first,
 							_robot_models[robot_filename.first]->q());
 	}
-	for (auto object_pose : _object_poses) {
-		_object_velocities[object_pose.first] =
-			std::make_shared<Eigen::Vector6d>(Eigen::Vector6d::Zero());
-	}
 	_right_click_interaction_occurring = false;
 }
 
+void Sai2Graphics::indexLinksRecursive(cGenericObject* parent,
+									   int parent_index, RobotEntry& robot) {
+	cRobotLink* child;
+	for (unsigned int i = 0; i < parent->getNumChildren(); ++i) {
+		child = dynamic_cast<cRobotLink*>(parent->getChild(i));
+		if (child != NULL) {
+			// keep the first link found with a given name
+			robot.links.emplace(child->m_name, child);
+			const int index = robot.link_order.size();
+			robot.link_order.push_back(child);
+			robot.link_names.push_back(child->m_name);
+			robot.link_parents.push_back(parent_index);
+			indexLinksRecursive(child, index, robot);
+		}
+	}
+}
+
+void Sai2Graphics::buildWorldIndex(
+	const std::map<std::string, std::shared_ptr<Eigen::Affine3d>>&
+		object_poses) {
+	_robots.clear();
+	_robot_indices.clear();
+	_objects = ObjectRegistry();
+	_object_indices.clear();
+	_cameras.clear();
+	_camera_indices.clear();
+	_camera_poses.clear();
+	std::unordered_map<std::string, cGenericObject*> world_objects;
+
+	// the first child with a given name is indexed, as the linear searches
+	// over the world children did
+	for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
+		cGenericObject* child = _world->getChild(i);
+		const std::string& name = child->m_name;
+
+		cRobotBase* base = dynamic_cast<cRobotBase*>(child);
+		if (base != NULL && _robot_filenames.count(name) > 0 &&
+			_robot_indices.count(name) == 0) {
+			_robot_indices[name] = _robots.size();
+			_robots.push_back(RobotEntry());
+			RobotEntry& robot = _robots.back();
+			robot.base = base;
+			robot.kinematics_stale = false;
+			robot.links_dirty = true;
+			robot.pose_version = 0;
+			indexLinksRecursive(base, -1, robot);
+			robot.link_poses.resize(robot.link_order.size(),
+									Eigen::Affine3d::Identity());
+		}
+
+		cCamera* camera = dynamic_cast<cCamera*>(child);
+		if (camera != NULL && _camera_indices.count(name) == 0) {
+			_camera_indices[name] = _cameras.size();
+			_cameras.push_back(camera);
+			_camera_poses.push_back(CameraPose{Eigen::Vector3d::Zero(),
+											   Eigen::Vector3d::Zero(),
+											   Eigen::Vector3d::Zero(), false});
+		}
+
+		if (object_poses.count(name) > 0) {
+			world_objects.emplace(name, child);
+		}
+	}
+
+	for (const auto& robot_filename : _robot_filenames) {
+		if (_robot_indices.count(robot_filename.first) == 0) {
+			throw std::invalid_argument("robot " + robot_filename.first +
+										" not found in the chai world in "
+										"Sai2Graphics::buildWorldIndex");
+		}
+	}
+	// the object registry follows the order of the object names. Objects
+	// missing from the chai world are only reported when updated.
+	for (const auto& object_pose : object_poses) {
+		auto world_object = world_objects.find(object_pose.first);
+		_object_indices[object_pose.first] = _objects.names.size();
+		_objects.names.push_back(object_pose.first);
+		_objects.objects.push_back(world_object == world_objects.end()
+									   ? NULL
+									   : world_object->second);
+		_objects.positions.push_back(object_pose.second->translation());
+		_objects.rotations.push_back(object_pose.second->linear());
+		_objects.velocities.push_back(Eigen::Vector6d::Zero());
+	}
+}
+
 void Sai2Graphics::clearWorld() {
+	// meshes still loading were never attached to the world
+	for (auto& pending : _pending_meshes) {
+		pending->loaded.wait();
+		deleteMeshLevels(pending->levels);
+	}
+	_pending_meshes.clear();
 	delete _world;
 	_robot_filenames.clear();
 	_robot_models.clear();
-	_object_poses.clear();
-	_object_velocities.clear();
+	_robots.clear();
+	_robot_indices.clear();
+	_objects = ObjectRegistry();
+	_object_indices.clear();
+	_object_widget_states.clear();
+	_cameras.clear();
+	_camera_indices.clear();
+	_camera_poses.clear();
 	_camera_names.clear();
 	_force_sensor_displays.clear();
+	_force_sensor_display_states.clear();
 	_ui_force_widgets.clear();
+	_mesh_lods.clear();
 }
 
 void Sai2Graphics::initializeWindow(const std::string& window_name) {
-	_window = glfwInitialize(window_name);
+	_window = glfwInitialize(window_name, _offscreen, _context_creation_api);
+	_next_frame_time = std::chrono::steady_clock::now();
+#ifdef GLEW_VERSION
+	// the framebuffer and pixel buffer objects of the frame capture are
+	// extensions on some platforms
+	if (glewInit() != GLEW_OK) {
+		std::cerr << "Sai2Graphics: failed to initialize GLEW" << std::endl;
+	}
+#endif
 
 	// set callbacks
 	glfwSetKeyCallback(_window, keySelect);
@@ -246,15 +716,16 @@ void Sai2Graphics::initializeWindow(const std::string& window_name) {
 	glfwSetScrollCallback(_window, mouseScroll);
 }
 
-void Sai2Graphics::addForceSensorDisplay(
+ForceSensorHandle Sai2Graphics::addForceSensorDisplay(
 	const Sai2Model::ForceSensorData& sensor_data) {
+	ForceSensorHandle sensor;
 	if (!robotExistsInGraphicsWorld(sensor_data.robot_name,
 									sensor_data.link_name)) {
 		std::cout << "\n\nWARNING: trying to add a force sensor display to an "
 					 "unexisting robot or link in "
 					 "Sai2Simulation::addForceSensorDisplay\n"
 				  << std::endl;
-		return;
+		return sensor;
 	}
 	if (findForceSensorDisplay(sensor_data.robot_name, sensor_data.link_name) !=
 		-1) {
@@ -262,26 +733,33 @@ void Sai2Graphics::addForceSensorDisplay(
 					 "link in Sai2Graphics::addForceSensorDisplay. Not "
 					 "adding the second one\n"
 				  << std::endl;
-		return;
+		return sensor;
 	}
 	_force_sensor_displays.push_back(std::make_shared<ForceSensorDisplay>(
 		sensor_data.robot_name, sensor_data.link_name,
 		sensor_data.transform_in_link, _robot_models[sensor_data.robot_name],
 		_world));
+	_force_sensor_display_states.push_back(ForceSensorDisplayState{
+		_robot_indices.at(sensor_data.robot_name), Eigen::Vector3d::Zero(),
+		Eigen::Vector3d::Zero(), 0, true});
+	markSceneDirty();
+	sensor.index = _force_sensor_displays.size() - 1;
+	return sensor;
 }
 
 void Sai2Graphics::updateDisplayedForceSensor(
 	const Sai2Model::ForceSensorData& force_data) {
-	int sensor_index =
+	ForceSensorHandle sensor;
+	sensor.index =
 		findForceSensorDisplay(force_data.robot_name, force_data.link_name);
-	if (sensor_index == -1) {
+	if (sensor.index == -1) {
 		throw std::invalid_argument(
 			"no force sensor on robot " + force_data.robot_name + " on link " +
 			force_data.link_name +
 			". Impossible to update the displayed force in graphics world");
 		return;
 	}
-	if (!_force_sensor_displays.at(sensor_index)
+	if (!_force_sensor_displays.at(sensor.index)
 			 ->T_link_sensor()
 			 .isApprox(force_data.transform_in_link)) {
 		throw std::invalid_argument(
@@ -290,8 +768,37 @@ void Sai2Graphics::updateDisplayedForceSensor(
 			"Sai2Graphics::updateDisplayedForceSensor");
 		return;
 	}
-	_force_sensor_displays.at(sensor_index)
-		->update(force_data.force_world_frame, force_data.moment_world_frame);
+	updateDisplayedForceSensor(sensor, force_data.force_world_frame,
+							   force_data.moment_world_frame);
+}
+
+void Sai2Graphics::updateDisplayedForceSensor(
+	const ForceSensorHandle& sensor, const Eigen::Vector3d& force_world_frame,
+	const Eigen::Vector3d& moment_world_frame) {
+	if (sensor.index < 0 || sensor.index >= _force_sensor_displays.size()) {
+		throw std::invalid_argument(
+			"invalid force sensor handle in "
+			"Sai2Graphics::updateDisplayedForceSensor");
+	}
+	// skip the update if neither the force nor the robot moved
+	ForceSensorDisplayState& state =
+		_force_sensor_display_states[sensor.index];
+	RobotEntry& robot = _robots[state.robot_index];
+	if (!state.dirty && state.robot_pose_version == robot.pose_version &&
+		(force_world_frame - state.force).cwiseAbs().maxCoeff() <=
+			_update_thresholds.force &&
+		(moment_world_frame - state.moment).cwiseAbs().maxCoeff() <=
+			_update_thresholds.force) {
+		return;
+	}
+	updateRobotKinematicsIfStale(robot);
+	_force_sensor_displays[sensor.index]->update(force_world_frame,
+												 moment_world_frame);
+	state.force = force_world_frame;
+	state.moment = moment_world_frame;
+	state.robot_pose_version = robot.pose_version;
+	state.dirty = false;
+	markSceneDirty();
 }
 
 bool Sai2Graphics::robotExistsInGraphicsWorld(
@@ -308,8 +815,8 @@ bool Sai2Graphics::robotExistsInGraphicsWorld(
 
 bool Sai2Graphics::objectExistsInGraphicsWorld(
 	const std::string& object_name) const {
-	auto it = _object_poses.find(object_name);
-	if (it == _object_poses.end()) {
+	auto it = _object_indices.find(object_name);
+	if (it == _object_indices.end()) {
 		return false;
 	}
 	return true;
@@ -342,15 +849,20 @@ void Sai2Graphics::addUIForceInteraction(
 	}
 	chai3d::cShapeLine* display_line = new chai3d::cShapeLine();
 	_world->addChild(display_line);
+	markSceneDirty();
 	if (is_robot) {
 		_ui_force_widgets.push_back(std::make_shared<UIForceWidget>(
 			robot_or_object_name, interact_at_object_center,
 			_robot_models[robot_or_object_name], display_line));
 	} else {
+		const int index = _object_indices.at(robot_or_object_name);
+		ObjectWidgetState state{
+			index, std::make_shared<Eigen::Affine3d>(objectPose(index)),
+			std::make_shared<Eigen::Vector6d>(_objects.velocities[index])};
+		_object_widget_states.push_back(state);
 		_ui_force_widgets.push_back(std::make_shared<UIForceWidget>(
 			robot_or_object_name, interact_at_object_center,
-			_object_poses[robot_or_object_name],
-			_object_velocities[robot_or_object_name], display_line));
+			state.pose, state.velocity, display_line));
 	}
 }
 
@@ -362,6 +874,12 @@ Eigen::VectorXd Sai2Graphics::getUITorques(
 		throw std::invalid_argument(
 			"robot or object not found in Sai2Graphics::getUITorques");
 	}
+	if (is_robot) {
+		updateRobotKinematicsIfStale(
+			_robots[_robot_indices.at(robot_or_object_name)]);
+	} else {
+		syncObjectWidgetStates();
+	}
 	for (auto widget : _ui_force_widgets) {
 		if (robot_or_object_name == widget->getRobotOrObjectName()) {
 			return widget->getUIJointTorques();
@@ -381,14 +899,74 @@ const std::vector<std::string> Sai2Graphics::getRobotNames() const {
 }
 
 const std::vector<std::string> Sai2Graphics::getObjectNames() const {
-	std::vector<std::string> object_names;
-	for (const auto& it : _object_poses) {
-		object_names.push_back(it.first);
-	}
-	return object_names;
+	return _objects.names;
 }
 
 void Sai2Graphics::renderGraphicsWorld() {
+	// wait for the next frame, handling events in the meantime
+	const double wait = std::chrono::duration<double>(
+							_next_frame_time - std::chrono::steady_clock::now())
+							.count();
+	if (wait > 0) {
+		glfwWaitEventsTimeout(wait);
+	}
+	handleInputs();
+	presentFrame();
+}
+
+void Sai2Graphics::setFramePacing(const FramePacing& pacing) {
+	if (pacing.target_fps <= 0) {
+		throw std::invalid_argument(
+			"target frame rate must be positive in "
+			"Sai2Graphics::setFramePacing");
+	}
+	_frame_pacing = pacing;
+	glfwMakeContextCurrent(_window);
+	glfwSwapInterval(pacing.vsync && !_offscreen ? 1 : 0);
+	_next_frame_time = std::chrono::steady_clock::now();
+}
+
+bool Sai2Graphics::isFrameDue() const {
+	return std::chrono::steady_clock::now() >= _next_frame_time;
+}
+
+void Sai2Graphics::presentFrame() {
+	const auto now = std::chrono::steady_clock::now();
+	const auto period =
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / _frame_pacing.target_fps));
+	_next_frame_time += period;
+	if (_next_frame_time < now) {
+		// late: schedule from now rather than presenting frames back to back
+		_next_frame_time = now + period;
+	}
+
+	// swap in the meshes loaded since the last frame
+	integrateLoadedMeshes();
+
+	// update shadow maps, only if a node changed
+	if (_shadow_maps_dirty) {
+		_world->updateShadowMaps();
+		_shadow_maps_dirty = false;
+	}
+
+	if (_frame_capture) {
+		captureFrame();
+	}
+
+	// render and swap only if the scene changed. The swap is queued, the GPU
+	// finishes the frame while the loop goes on
+	glfwGetFramebufferSize(_window, &_window_width, &_window_height);
+	render(_camera_names[_current_camera_index]);
+	if (_frame_pending) {
+		glfwSwapBuffers(_window);
+		_frame_pending = false;
+	}
+}
+
+void Sai2Graphics::handleInputs() {
+	glfwPollEvents();
+
 	// swap camera if needed
 	if (consume_first_press(NEXT_CAMERA_KEY)) {
 		_current_camera_index =
@@ -400,13 +978,7 @@ void Sai2Graphics::renderGraphicsWorld() {
 	}
 	const std::string camera_name = _camera_names[_current_camera_index];
 
-	// update graphics. this automatically waits for the correct amount of time
 	glfwGetFramebufferSize(_window, &_window_width, &_window_height);
-	glfwSwapBuffers(_window);
-	glFinish();
-
-	// poll for events
-	glfwPollEvents();
 
 	// handle mouse button presses
 	Eigen::Vector3d camera_pos, camera_lookat_point, camera_up_axis;
@@ -442,6 +1014,14 @@ void Sai2Graphics::renderGraphicsWorld() {
 		int viewx = floor(cursorx / wwidth_scr * _window_width);
 		int viewy = floor(cursory / wheight_scr * _window_height);
 
+		// the widgets pick the robot links from the robot models and the
+		// objects from their poses, and draw the interaction line
+		for (auto& robot : _robots) {
+			updateRobotKinematicsIfStale(robot);
+		}
+		syncObjectWidgetStates();
+		markSceneDirty();
+
 		for (auto widget : _ui_force_widgets) {
 			if (widget->getState() == UIForceWidget::Active) {
 				_right_click_interaction_occurring = true;
@@ -550,82 +1130,83 @@ void Sai2Graphics::renderGraphicsWorld() {
 
 	//setCameraPose(camera_name, camera_pos, camera_up_axis, camera_lookat_point);
 	glfwGetCursorPos(_window, &_last_cursorx, &_last_cursory);
+}
 
-	// update shadow maps
-	_world->updateShadowMaps();
-
-	//render(camera_name);
-}
-
-static void updateGraphicsLink(
-	cRobotLink* link, std::shared_ptr<Sai2Model::Sai2Model> robot_model) {
-	cVector3d local_pos;
-	cMatrix3d local_rot;
-
-	// get link name
-	std::string link_name = link->m_name;
-
-	// get chai parent name
-	cGenericObject* parent = link->getParent();
-	std::string parent_name = parent->m_name;
-
-	// if parent is cRobotBase, then simply get transform relative to base from
-	// model
-	if (dynamic_cast<cRobotBase*>(parent) != NULL) {
-		Eigen::Affine3d T = robot_model->transform(link_name);
-		local_pos = cVector3d(T.translation());
-		local_rot = cMatrix3d(T.rotation());
-	} else if (dynamic_cast<cRobotLink*>(parent) != NULL) {
-		// if parent is cRobotLink, then calculate transform for both links,
-		// then apply inverse transform
-		Eigen::Affine3d T_me, T_parent, T_rel;
-		T_me = robot_model->transform(link_name);
-		T_parent = robot_model->transform(parent_name);
-		T_rel = T_parent.inverse() * T_me;
-		local_pos = cVector3d(T_rel.translation());
-		local_rot = cMatrix3d(T_rel.rotation());
-	} else {
-		cerr << "Parent to link " << link_name << " is neither link nor base"
-			 << endl;
-		abort();
-		// TODO: throw exception
+void Sai2Graphics::updateRobotLinks(
+	RobotEntry& robot, const std::vector<Eigen::Affine3d>& link_poses) {
+	Eigen::Affine3d T_rel;
+	for (unsigned int i = 0; i < robot.link_order.size(); ++i) {
+		const int parent = robot.link_parents[i];
+		// links attached to the base take their pose relative to the base,
+		// the others relative to their parent link (a rigid transform, so the
+		// inverse is cheap)
+		if (parent < 0) {
+			T_rel = link_poses[i];
+		} else {
+			T_rel = link_poses[parent].inverse(Eigen::Isometry) * link_poses[i];
+		}
+		robot.link_order[i]->setLocalPos(cVector3d(T_rel.translation()));
+		robot.link_order[i]->setLocalRot(cMatrix3d(T_rel.linear()));
 	}
-	link->setLocalPos(local_pos);
-	link->setLocalRot(local_rot);
+	robot.links_dirty = false;
+	++robot.pose_version;
+	markSceneDirty();
+}
 
-	// call on children
-	cRobotLink* child;
-	for (unsigned int i = 0; i < link->getNumChildren(); ++i) {
-		child = dynamic_cast<cRobotLink*>(link->getChild(i));
-		if (child != NULL) {
-			updateGraphicsLink(child, robot_model);
-		}
+void Sai2Graphics::updateRobotKinematicsIfStale(RobotEntry& robot) {
+	if (robot.kinematics_stale) {
+		robot.model->updateKinematics();
+		robot.kinematics_stale = false;
 	}
 }
 
 // update frame for a particular robot
 void Sai2Graphics::updateRobotGraphics(const std::string& robot_name,
 									   const Eigen::VectorXd& joint_angles) {
-	auto it = _robot_models.find(robot_name);
-	if (it == _robot_models.end()) {
+	auto it = _robot_indices.find(robot_name);
+	if (it == _robot_indices.end()) {
 		throw std::invalid_argument(
 			"Robot not found in Sai2Graphics::updateRobotGraphics");
 	}
-	updateRobotGraphics(
-		robot_name, joint_angles,
-		Eigen::VectorXd::Zero(_robot_models.at(robot_name)->dof()));
+	RobotHandle robot;
+	robot.index = it->second;
+	updateRobotGraphics(robot, joint_angles);
 }
 
 void Sai2Graphics::updateRobotGraphics(
 	const std::string& robot_name, const Eigen::VectorXd& joint_angles,
 	const Eigen::VectorXd& joint_velocities) {
-	// update corresponfing robot model
-	auto it = _robot_models.find(robot_name);
-	if (it == _robot_models.end()) {
+	auto it = _robot_indices.find(robot_name);
+	if (it == _robot_indices.end()) {
 		throw std::invalid_argument(
 			"Robot not found in Sai2Graphics::updateRobotGraphics");
 	}
-	auto robot_model = _robot_models.at(robot_name);
+	RobotHandle robot;
+	robot.index = it->second;
+	updateRobotGraphics(robot, joint_angles, joint_velocities);
+}
+
+void Sai2Graphics::updateRobotGraphics(const RobotHandle& robot,
+									   const Eigen::VectorXd& joint_angles) {
+	if (robot.index < 0 || robot.index >= _robots.size()) {
+		throw std::invalid_argument(
+			"invalid robot handle in Sai2Graphics::updateRobotGraphics");
+	}
+	updateRobotGraphics(
+		robot, joint_angles,
+		Eigen::VectorXd::Zero(_robots[robot.index].model->dof()));
+}
+
+void Sai2Graphics::updateRobotGraphics(
+	const RobotHandle& robot, const Eigen::VectorXd& joint_angles,
+	const Eigen::VectorXd& joint_velocities) {
+	// update corresponfing robot model
+	if (robot.index < 0 || robot.index >= _robots.size()) {
+		throw std::invalid_argument(
+			"invalid robot handle in Sai2Graphics::updateRobotGraphics");
+	}
+	RobotEntry& entry = _robots[robot.index];
+	const auto& robot_model = entry.model;
 	if (joint_angles.size() != robot_model->qSize()) {
 		throw std::invalid_argument(
 			"size of joint angles inconsistent with robot model in "
@@ -636,64 +1217,190 @@ void Sai2Graphics::updateRobotGraphics(
 			"size of joint velocities inconsistent with robot model in "
 			"Sai2Graphics::updateRobotGraphics");
 	}
+	// skip the forward kinematics and the link updates if the robot did not
+	// move
+	if (!entry.links_dirty &&
+		(joint_angles - robot_model->q()).cwiseAbs().maxCoeff() <=
+			_update_thresholds.joint_angle) {
+		if (joint_velocities.size() > 0 &&
+			(joint_velocities - robot_model->dq()).cwiseAbs().maxCoeff() >
+				_update_thresholds.joint_angle) {
+			robot_model->setDq(joint_velocities);
+			entry.kinematics_stale = true;
+		}
+		return;
+	}
 	robot_model->setQ(joint_angles);
 	robot_model->setDq(joint_velocities);
 	robot_model->updateKinematics();
+	entry.kinematics_stale = false;
 
-	// get robot base object in chai world
-	cRobotBase* base = NULL;
-	for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-		if (robot_name == _world->getChild(i)->m_name) {
-			// cast to cRobotBase
-			base = dynamic_cast<cRobotBase*>(_world->getChild(i));
-			if (base != NULL) {
-				break;
-			}
-		}
+	// one pass over the links, parents first
+	for (unsigned int i = 0; i < entry.link_order.size(); ++i) {
+		entry.link_poses[i] = robot_model->transform(entry.link_names[i]);
 	}
-	if (base == NULL) {
-		// TODO: throw exception
-		cerr << "Could not find robot in chai world: " << robot_name << endl;
-		abort();
+	updateRobotLinks(entry, entry.link_poses);
+}
+
+void Sai2Graphics::updateRobotGraphics(
+	const RobotHandle& robot, const Eigen::VectorXd& joint_angles,
+	const std::vector<Eigen::Affine3d>& link_poses) {
+	if (robot.index < 0 || robot.index >= _robots.size()) {
+		throw std::invalid_argument(
+			"invalid robot handle in Sai2Graphics::updateRobotGraphics");
 	}
-	// recursively update graphics for all children
-	cRobotLink* link;
-	for (unsigned int i = 0; i < base->getNumChildren(); ++i) {
-		link = dynamic_cast<cRobotLink*>(base->getChild(i));
-		if (link != NULL) {
-			updateGraphicsLink(link, robot_model);
-		}
+	RobotEntry& entry = _robots[robot.index];
+	if (joint_angles.size() != entry.model->qSize()) {
+		throw std::invalid_argument(
+			"size of joint angles inconsistent with robot model in "
+			"Sai2Graphics::updateRobotGraphics");
 	}
+	if (link_poses.size() != entry.link_order.size()) {
+		throw std::invalid_argument(
+			"number of link poses inconsistent with robot graphics in "
+			"Sai2Graphics::updateRobotGraphics");
+	}
+	if (!entry.links_dirty &&
+		(joint_angles - entry.model->q()).cwiseAbs().maxCoeff() <=
+			_update_thresholds.joint_angle) {
+		return;
+	}
+	entry.model->setQ(joint_angles);
+	entry.kinematics_stale = true;
+	updateRobotLinks(entry, link_poses);
+}
+
+const std::vector<std::string>& Sai2Graphics::getRobotLinkNames(
+	const RobotHandle& robot) const {
+	if (robot.index < 0 || robot.index >= _robots.size()) {
+		throw std::invalid_argument(
+			"invalid robot handle in Sai2Graphics::getRobotLinkNames");
+	}
+	return _robots[robot.index].link_names;
 }
 
 void Sai2Graphics::updateObjectGraphics(
 	const std::string& object_name, const Eigen::Affine3d& object_pose,
 	const Eigen::Vector6d& object_velocity) {
-	if (!objectExistsInGraphicsWorld(object_name)) {
+	auto it = _object_indices.find(object_name);
+	if (it == _object_indices.end()) {
 		throw std::invalid_argument(
 			"object not found in Sai2Graphics::updateObjectGraphics");
 	}
-	cGenericObject* object = NULL;
-	for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-		if (object_name == _world->getChild(i)->m_name) {
-			// cast to cRobotBase
-			object = _world->getChild(i);
-			if (object != NULL) {
-				break;
-			}
-		}
+	ObjectHandle object;
+	object.index = it->second;
+	updateObjectGraphics(object, object_pose, object_velocity);
+}
+
+void Sai2Graphics::updateObjectGraphics(
+	const ObjectHandle& object, const Eigen::Affine3d& object_pose,
+	const Eigen::Vector6d& object_velocity) {
+	checkObjectHandle(object, "updateObjectGraphics");
+	setObjectPose(object.index, object_pose, object_velocity);
+}
+
+void Sai2Graphics::updateObjectsGraphics(
+	Span<const ObjectHandle> objects, Span<const Eigen::Affine3d> object_poses,
+	Span<const Eigen::Vector6d> object_velocities) {
+	if (object_poses.size() != objects.size() ||
+		(!object_velocities.empty() &&
+		 object_velocities.size() != objects.size())) {
+		throw std::invalid_argument(
+			"number of poses or velocities inconsistent with the number of "
+			"objects in Sai2Graphics::updateObjectsGraphics");
 	}
-	if (object == NULL) {
-		// TODO: throw exception
-		cerr << "Could not find object in chai world: " << object_name << endl;
-		abort();
+	// check the whole batch first, so that nothing is updated if it is invalid
+	for (const auto& object : objects) {
+		checkObjectHandle(object, "updateObjectsGraphics");
+	}
+	const Eigen::Vector6d zero_velocity = Eigen::Vector6d::Zero();
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		setObjectPose(objects[i].index, object_poses[i],
+					  object_velocities.empty() ? zero_velocity
+												: object_velocities[i]);
+	}
+}
+
+void Sai2Graphics::checkObjectHandle(const ObjectHandle& object,
+									 const std::string& function_name) const {
+	if (object.index < 0 || object.index >= _objects.names.size()) {
+		throw std::invalid_argument("invalid object handle in Sai2Graphics::" +
+									function_name);
+	}
+	if (_objects.objects[object.index] == NULL) {
+		throw std::invalid_argument("object " + _objects.names[object.index] +
+									" not found in the chai world in "
+									"Sai2Graphics::" +
+									function_name);
+	}
+}
+
+Eigen::Affine3d Sai2Graphics::objectPose(int index) const {
+	Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+	pose.translation() = _objects.positions[index];
+	pose.linear() = _objects.rotations[index];
+	return pose;
+}
+
+void Sai2Graphics::setObjectPose(int index, const Eigen::Affine3d& object_pose,
+								 const Eigen::Vector6d& object_velocity) {
+	_objects.velocities[index] = object_velocity;
+	// still objects keep their chai transform and leave the scene clean
+	if ((object_pose.translation() - _objects.positions[index])
+				.cwiseAbs()
+				.maxCoeff() <= _update_thresholds.position &&
+		(object_pose.linear() - _objects.rotations[index])
+				.cwiseAbs()
+				.maxCoeff() <= _update_thresholds.rotation) {
+		return;
+	}
+	_objects.positions[index] = object_pose.translation();
+	_objects.rotations[index] = object_pose.linear();
+	_objects.objects[index]->setLocalPos(cVector3d(_objects.positions[index]));
+	_objects.objects[index]->setLocalRot(cMatrix3d(_objects.rotations[index]));
+	markSceneDirty();
+}
+
+void Sai2Graphics::syncObjectWidgetStates() {
+	for (const auto& state : _object_widget_states) {
+		*state.pose = objectPose(state.index);
+		*state.velocity = _objects.velocities[state.index];
+	}
+}
+
+RobotHandle Sai2Graphics::getRobotHandle(const std::string& robot_name) const {
+	auto it = _robot_indices.find(robot_name);
+	if (it == _robot_indices.end()) {
+		throw std::invalid_argument(
+			"robot not found in Sai2Graphics::getRobotHandle");
+	}
+	RobotHandle robot;
+	robot.index = it->second;
+	return robot;
+}
+
+ObjectHandle Sai2Graphics::getObjectHandle(
+	const std::string& object_name) const {
+	auto it = _object_indices.find(object_name);
+	if (it == _object_indices.end()) {
+		throw std::invalid_argument(
+			"object not found in Sai2Graphics::getObjectHandle");
 	}
+	ObjectHandle object;
+	object.index = it->second;
+	return object;
+}
 
-	// update pose
-	*_object_poses.at(object_name) = object_pose;
-	*_object_velocities.at(object_name) = object_velocity;
-	object->setLocalPos(object_pose.translation());
-	object->setLocalRot(object_pose.rotation());
+CameraHandle Sai2Graphics::getCameraHandle(
+	const std::string& camera_name) const {
+	auto it = _camera_indices.find(camera_name);
+	if (it == _camera_indices.end()) {
+		throw std::invalid_argument(
+			"camera not found in Sai2Graphics::getCameraHandle");
+	}
+	CameraHandle camera;
+	camera.index = it->second;
+	return camera;
 }
 
 Eigen::VectorXd Sai2Graphics::getRobotJointPos(const std::string& robot_name) {
@@ -710,26 +1417,81 @@ Eigen::Affine3d Sai2Graphics::getObjectPose(const std::string& object_name) {
 		throw std::invalid_argument(
 			"object not found in Sai2Graphics::getObjectPose");
 	}
-	return *_object_poses.at(object_name);
+	return objectPose(_object_indices.at(object_name));
 }
 
 void Sai2Graphics::render(const std::string& camera_name) {
+	if (_offscreen) {
+		// no window to show the frame in
+		return;
+	}
 	auto camera = getCamera(camera_name);
+	// the last rendered frame is still valid if nothing changed
+	if (!_scene_dirty && camera == _last_rendered_camera &&
+		_window_width == _last_rendered_width &&
+		_window_height == _last_rendered_height) {
+		return;
+	}
 	// TODO: support link mounted cameras
 	// TODO: support stereo. see cCamera::renderView
 	//	to do so, we need to search through the descendent tree
 	// render view from this camera
 	// NOTE: we don't use the display context id right now since chai no longer
 	// supports it in 3.2.0
+	selectLods(camera, _window_height);
 	camera->renderView(_window_width, _window_height);
+	_scene_dirty = false;
+	_last_rendered_camera = camera;
+	_last_rendered_width = _window_width;
+	_last_rendered_height = _window_height;
+	_frame_pending = true;
 }
 
-// get current camera pose
-void Sai2Graphics::getCameraPose(const std::string& camera_name,
-								 Eigen::Vector3d& ret_position,
-								 Eigen::Vector3d& ret_vertical_axis,
-								 Eigen::Vector3d& ret_lookat_point) {
-	auto camera = getCamera(camera_name);
+void Sai2Graphics::selectLods(cCamera* camera, int viewport_height) {
+	if (_mesh_lods.empty() || viewport_height <= 0) {
+		return;
+	}
+	const std::vector<double>& sizes = _lod_thresholds.pixel_sizes;
+	const double hysteresis = _lod_thresholds.hysteresis;
+	// global positions are those of the last rendered frame, the hysteresis
+	// absorbs the lag
+	const Eigen::Vector3d camera_position = camera->getGlobalPos().eigen();
+	const double pixels_per_meter =
+		0.5 * viewport_height / tan(0.5 * camera->getFieldViewAngleRad());
+	for (auto& lods : _mesh_lods) {
+		const Eigen::Vector3d center =
+			lods.multi_mesh->getGlobalPos().eigen() +
+			lods.multi_mesh->getGlobalRot().eigen() * lods.center;
+		const double distance = (center - camera_position).norm();
+		const double pixels =
+			distance > lods.radius
+				? 2 * lods.radius * pixels_per_meter / distance
+				: std::numeric_limits<double>::infinity();
+		const int num_levels =
+			std::min(lods.levels.size(), sizes.size() + 1);
+		int level = std::min(lods.current, num_levels - 1);
+		while (level > 0 && pixels > sizes[level - 1] * (1 + hysteresis)) {
+			--level;
+		}
+		while (level + 1 < num_levels &&
+			   pixels < sizes[level] * (1 - hysteresis)) {
+			++level;
+		}
+		if (level != lods.current) {
+			for (auto mesh : lods.levels[lods.current]) {
+				mesh->setShowEnabled(false);
+			}
+			for (auto mesh : lods.levels[level]) {
+				mesh->setShowEnabled(true);
+			}
+			lods.current = level;
+		}
+	}
+}
+
+static void getChaiCameraPose(cCamera* camera, Eigen::Vector3d& ret_position,
+							  Eigen::Vector3d& ret_vertical_axis,
+							  Eigen::Vector3d& ret_lookat_point) {
 	cVector3d pos, vert, lookat;
 	pos = camera->getLocalPos();
 	ret_position << pos.x(), pos.y(), pos.z();
@@ -740,98 +1502,105 @@ void Sai2Graphics::getCameraPose(const std::string& camera_name,
 	ret_lookat_point += ret_position;
 }
 
+static void setChaiCameraPose(cCamera* camera, const Eigen::Vector3d& position,
+							  const Eigen::Vector3d& vertical_axis,
+							  const Eigen::Vector3d& lookat_point) {
+	cVector3d pos(position[0], position[1], position[2]);
+	cVector3d vert(vertical_axis[0], vertical_axis[1], vertical_axis[2]);
+	cVector3d look(lookat_point[0], lookat_point[1], lookat_point[2]);
+	camera->set(pos, look, vert);
+}
+
+// get current camera pose
+void Sai2Graphics::getCameraPose(const std::string& camera_name,
+								 Eigen::Vector3d& ret_position,
+								 Eigen::Vector3d& ret_vertical_axis,
+								 Eigen::Vector3d& ret_lookat_point) {
+	getChaiCameraPose(getCamera(camera_name), ret_position, ret_vertical_axis,
+					  ret_lookat_point);
+}
+
+void Sai2Graphics::getCameraPose(const CameraHandle& camera,
+								 Eigen::Vector3d& ret_position,
+								 Eigen::Vector3d& ret_vertical_axis,
+								 Eigen::Vector3d& ret_lookat_point) {
+	getChaiCameraPose(getCamera(camera), ret_position, ret_vertical_axis,
+					  ret_lookat_point);
+}
+
 // set camera pose
 void Sai2Graphics::setCameraPose(const std::string& camera_name,
 								 const Eigen::Vector3d& position,
 								 const Eigen::Vector3d& vertical_axis,
 								 const Eigen::Vector3d& lookat_point) {
-	auto camera = getCamera(camera_name);
-	cVector3d pos(position[0], position[1], position[2]);
-	cVector3d vert(vertical_axis[0], vertical_axis[1], vertical_axis[2]);
-	cVector3d look(lookat_point[0], lookat_point[1], lookat_point[2]);
-	camera->set(pos, look, vert);
+	getCamera(camera_name);
+	CameraHandle camera;
+	camera.index = _camera_indices.at(camera_name);
+	setCameraPose(camera, position, vertical_axis, lookat_point);
+}
+
+void Sai2Graphics::setCameraPose(const CameraHandle& camera,
+								 const Eigen::Vector3d& position,
+								 const Eigen::Vector3d& vertical_axis,
+								 const Eigen::Vector3d& lookat_point) {
+	cCamera* chai_camera = getCamera(camera);
+	// the camera does not move if the pose is the same as the last one
+	CameraPose& last_pose = _camera_poses[camera.index];
+	if (last_pose.set &&
+		(position - last_pose.position).cwiseAbs().maxCoeff() <=
+			_update_thresholds.position &&
+		(lookat_point - last_pose.lookat).cwiseAbs().maxCoeff() <=
+			_update_thresholds.position &&
+		(vertical_axis - last_pose.vertical).cwiseAbs().maxCoeff() <=
+			_update_thresholds.rotation) {
+		return;
+	}
+	setChaiCameraPose(chai_camera, position, vertical_axis, lookat_point);
+	last_pose = CameraPose{position, vertical_axis, lookat_point, true};
+	_scene_dirty = true;
 }
 
 // get camera object
 cCamera* Sai2Graphics::getCamera(const std::string& camera_name) {
-	cCamera* camera;
-	// find camera among children
-	// TODO: this can be optimized by locally storing list of cameras
-	for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-		cGenericObject* child = _world->getChild(i);
-		if (camera_name == child->m_name) {
-			camera = dynamic_cast<cCamera*>(child);
-			if (camera) {
-				break;
-			}
-		}
-	}
-	if (!camera) {
+	auto it = _camera_indices.find(camera_name);
+	if (it == _camera_indices.end()) {
 		cerr << "Could not find camera named " << camera_name << endl;
 		abort();
 		// TODO: throw exception instead
 	}
-	return camera;
+	return _cameras[it->second];
 }
 
-cRobotLink* Sai2Graphics::findLinkObjectInParentLinkRecursive(
-	cRobotLink* parent, const std::string& link_name) {
-	// call on children
-	cRobotLink* child;
-	cRobotLink* ret_link = NULL;
-	for (unsigned int i = 0; i < parent->getNumChildren(); ++i) {
-		child = dynamic_cast<cRobotLink*>(parent->getChild(i));
-		if (child != NULL) {
-			if (child->m_name == link_name) {
-				ret_link = child;
-				break;
-			} else {
-				ret_link =
-					findLinkObjectInParentLinkRecursive(child, link_name);
-			}
-		}
+cCamera* Sai2Graphics::getCamera(const CameraHandle& camera) {
+	if (camera.index < 0 || camera.index >= _cameras.size()) {
+		throw std::invalid_argument(
+			"invalid camera handle in Sai2Graphics::getCamera");
 	}
-	return ret_link;
+	return _cameras[camera.index];
 }
 
-cRobotLink* Sai2Graphics::findLink(const std::string& robot_name,
-								   const std::string& link_name) {
-	// get robot base
-	cRobotBase* base = NULL;
-	for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-		if (robot_name == _world->getChild(i)->m_name) {
-			// cast to cRobotBase
-			base = dynamic_cast<cRobotBase*>(_world->getChild(i));
-			if (base != NULL) {
-				break;
-			}
-		}
-	}
-	if (base == NULL) {
+cRobotBase* Sai2Graphics::findRobotBase(const std::string& robot_name) {
+	auto it = _robot_indices.find(robot_name);
+	if (it == _robot_indices.end()) {
 		// TODO: throw exception
 		cerr << "Could not find robot in chai world: " << robot_name << endl;
 		abort();
 	}
+	return _robots[it->second].base;
+}
+
+cRobotLink* Sai2Graphics::findLink(const std::string& robot_name,
+								   const std::string& link_name) {
+	// get robot base
+	findRobotBase(robot_name);
+	const auto& links = _robots[_robot_indices.at(robot_name)].links;
 
-	cRobotLink* target_link = NULL;
 	// get target link
-	cRobotLink* base_link;
-	for (unsigned int i = 0; i < base->getNumChildren(); ++i) {
-		base_link = dynamic_cast<cRobotLink*>(base->getChild(i));
-		if (base_link != NULL) {
-			if (base_link->m_name == link_name) {
-				target_link = base_link;
-				break;
-			} else {
-				target_link =
-					findLinkObjectInParentLinkRecursive(base_link, link_name);
-				if (target_link != NULL) {
-					break;
-				}
-			}
-		}
+	auto it = links.find(link_name);
+	if (it == links.end()) {
+		return NULL;
 	}
-	return target_link;
+	return it->second;
 }
 
 void Sai2Graphics::showLinkFrameRecursive(cRobotLink* parent, bool show_frame,
@@ -860,22 +1629,7 @@ void Sai2Graphics::showLinkFrame(bool show_frame, const std::string& robot_name,
 	// apply frame show
 	if (fShouldApplyAllLinks) {
 		// get robot base
-		cRobotBase* base = NULL;
-		for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-			if (robot_name == _world->getChild(i)->m_name) {
-				// cast to cRobotBase
-				base = dynamic_cast<cRobotBase*>(_world->getChild(i));
-				if (base != NULL) {
-					break;
-				}
-			}
-		}
-		if (base == NULL) {
-			// TODO: throw exception
-			cerr << "Could not find robot in chai world: " << robot_name
-				 << endl;
-			abort();
-		}
+		cRobotBase* base = findRobotBase(robot_name);
 		base->setWireMode(show_frame, true);
 		base->setFrameSize(frame_pointer_length, false);
 		base->setShowFrame(show_frame, false);
@@ -897,6 +1651,7 @@ void Sai2Graphics::showLinkFrame(bool show_frame, const std::string& robot_name,
 		target_link->setFrameSize(frame_pointer_length, false);
 		target_link->setShowFrame(show_frame, false);
 	}
+	markSceneDirty();
 }
 
 // Show wire mesh for a particular link or all links on a robot.
@@ -911,22 +1666,7 @@ void Sai2Graphics::showWireMesh(bool show_wiremesh,
 	// apply frame show
 	if (fShouldApplyAllLinks) {
 		// get robot base
-		cRobotBase* base = NULL;
-		for (unsigned int i = 0; i < _world->getNumChildren(); ++i) {
-			if (robot_name == _world->getChild(i)->m_name) {
-				// cast to cRobotBase
-				base = dynamic_cast<cRobotBase*>(_world->getChild(i));
-				if (base != NULL) {
-					break;
-				}
-			}
-		}
-		if (base == NULL) {
-			// TODO: throw exception
-			cerr << "Could not find robot in chai world: " << robot_name
-				 << endl;
-			abort();
-		}
+		cRobotBase* base = findRobotBase(robot_name);
 		base->setWireMode(show_wiremesh, true);
 	} else {
 		auto target_link = findLink(robot_name, link_name);
@@ -934,6 +1674,275 @@ void Sai2Graphics::showWireMesh(bool show_wiremesh,
 		// set wireframe whenever we show frame
 		target_link->setWireMode(show_wiremesh, true);
 	}
+	markSceneDirty();
+}
+
+std::string Sai2Graphics::_mesh_cache_dir;
+std::vector<Sai2Graphics::MeshLods> Sai2Graphics::_loaded_mesh_lods;
+
+std::vector<std::shared_ptr<Sai2Graphics::PendingMesh>>
+	Sai2Graphics::_loading_meshes;
+
+void Sai2Graphics::setMeshLoadingThreads(int num_threads) {
+	meshLoadPool().setNumThreads(num_threads);
+}
+
+bool Sai2Graphics::_offscreen = false;
+int Sai2Graphics::_context_creation_api = GLFW_EGL_CONTEXT_API;
+
+void Sai2Graphics::startFrameCapture(const std::string& path, int width,
+									 int height, double fps,
+									 const std::string& camera_name) {
+	if (fps <= 0) {
+		throw std::invalid_argument(
+			"frame rate must be positive in Sai2Graphics::startFrameCapture");
+	}
+	if (!camera_name.empty() && _camera_indices.count(camera_name) == 0) {
+		throw std::invalid_argument(
+			"camera " + camera_name +
+			" not found in Sai2Graphics::startFrameCapture");
+	}
+	stopFrameCapture();
+
+	auto capture = std::make_unique<FrameCapture>();
+	capture->writer =
+		std::make_unique<Ocean1::FrameWriter>(path, width, height);
+	capture->camera_name = camera_name;
+	capture->width = width;
+	capture->height = height;
+	capture->period = std::chrono::duration_cast<
+		std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / fps));
+	capture->next_frame = std::chrono::steady_clock::now();
+
+	glfwMakeContextCurrent(_window);
+	glGenRenderbuffers(1, &capture->color_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, capture->color_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &capture->depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, capture->depth_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+						  height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &capture->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+							  GL_RENDERBUFFER, capture->color_buffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+							  GL_RENDERBUFFER, capture->depth_buffer);
+	const bool complete =
+		glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, capture->pixel_buffers);
+	for (GLuint pixel_buffer : capture->pixel_buffers) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, capture->writer->frameBytes(),
+					 NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	capture->next_pixel_buffer = 0;
+	capture->pending_readback = false;
+
+	_frame_capture = std::move(capture);
+	if (!complete) {
+		stopFrameCapture();
+		throw std::runtime_error(
+			"incomplete capture framebuffer in "
+			"Sai2Graphics::startFrameCapture");
+	}
+}
+
+void Sai2Graphics::stopFrameCapture() {
+	if (!_frame_capture) {
+		return;
+	}
+	FrameCapture& capture = *_frame_capture;
+	glfwMakeContextCurrent(_window);
+	if (capture.pending_readback) {
+		writePixelBuffer(capture.pixel_buffers[1 - capture.next_pixel_buffer],
+						 *capture.writer);
+	}
+	glDeleteBuffers(2, capture.pixel_buffers);
+	glDeleteFramebuffers(1, &capture.framebuffer);
+	glDeleteRenderbuffers(1, &capture.color_buffer);
+	glDeleteRenderbuffers(1, &capture.depth_buffer);
+	capture.writer->stop();
+	_frame_capture.reset();
+}
+
+void Sai2Graphics::captureFrame() {
+	FrameCapture& capture = *_frame_capture;
+	const auto now = std::chrono::steady_clock::now();
+	if (now < capture.next_frame) {
+		return;
+	}
+	capture.next_frame += capture.period;
+	if (capture.next_frame < now) {
+		// fell behind: do not capture a burst of frames to catch up
+		capture.next_frame = now + capture.period;
+	}
+
+	cCamera* camera = getCamera(capture.camera_name.empty()
+									? _camera_names[_current_camera_index]
+									: capture.camera_name);
+	selectLods(camera, capture.height);
+	glBindFramebuffer(GL_FRAMEBUFFER, capture.framebuffer);
+	camera->renderView(capture.width, capture.height, 0, C_STEREO_LEFT_EYE,
+					   false);
+	// with a pixel buffer bound, the read is queued and returns without
+	// waiting for the frame to be rendered
+	const int pixel_buffer = capture.next_pixel_buffer;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pixel_buffers[pixel_buffer]);
+	glReadPixels(0, 0, capture.width, capture.height, GL_RGBA,
+				 GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// the previous frame had a whole frame to be read back
+	if (capture.pending_readback) {
+		writePixelBuffer(capture.pixel_buffers[1 - pixel_buffer],
+						 *capture.writer);
+	}
+	capture.pending_readback = true;
+	capture.next_pixel_buffer = 1 - pixel_buffer;
+}
+
+bool Sai2Graphics::loadMesh(cMultiMesh* mesh, const std::string& filename) {
+	const std::string cache_path =
+		_mesh_cache_dir.empty()
+			? ""
+			: Ocean1::meshCachePath(_mesh_cache_dir, filename);
+	const bool cached =
+		!cache_path.empty() && Ocean1::isMeshCacheFresh(cache_path, filename);
+
+	if (meshLoadPool().numThreads() > 0 && (cached || isObjFile(filename))) {
+		// placeholder box now, meshes built by the pool and swapped in by
+		// renderGraphicsWorld
+		auto pending = std::make_shared<PendingMesh>();
+		pending->filename = filename;
+		pending->multi_mesh = mesh;
+		pending->placeholder_lower.setConstant(-PLACEHOLDER_HALF_SIZE);
+		pending->placeholder_upper.setConstant(PLACEHOLDER_HALF_SIZE);
+		if (cached) {
+			try {
+				const Ocean1::MappedMesh cache(cache_path);
+				for (int k = 0; k < 3; ++k) {
+					pending->placeholder_lower(k) = cache.header().lower[k];
+					pending->placeholder_upper(k) = cache.header().upper[k];
+				}
+			} catch (const std::runtime_error&) {
+				// the worker falls back to the obj file
+			}
+		}
+		pending->placeholder =
+			newPlaceholderBox(mesh, pending->placeholder_lower,
+							  pending->placeholder_upper);
+		pending->placeholder_material = pending->placeholder->m_material;
+		pending->loaded = pending->loaded_promise.get_future();
+		const std::string cache_dir = _mesh_cache_dir;
+		meshLoadPool().submit([pending, cache_dir]() {
+			try {
+				pending->levels = buildMeshLevels(cache_dir, pending->filename);
+			} catch (const std::exception& e) {
+				cerr << "could not load mesh " << pending->filename << ": "
+					 << e.what() << endl;
+			}
+			pending->loaded_promise.set_value();
+		});
+		_loading_meshes.push_back(pending);
+		return true;
+	}
+
+	if (!cached) {
+		return mesh->loadFromFile(filename);
+	}
+	std::vector<std::vector<cMesh*>> levels;
+	try {
+		levels = buildMeshLevels(_mesh_cache_dir, filename);
+	} catch (const std::runtime_error& e) {
+		cerr << "ignoring mesh cache: " << e.what() << endl;
+		return mesh->loadFromFile(filename);
+	}
+	for (size_t level = 0; level < levels.size(); ++level) {
+		for (auto level_mesh : levels[level]) {
+			level_mesh->setShowEnabled(level == 0);
+			mesh->addMesh(level_mesh);
+		}
+	}
+	mesh->computeBoundaryBox(true);
+	if (levels.size() > 1) {
+		_loaded_mesh_lods.push_back({mesh, levels, Eigen::Vector3d::Zero(), 0.0, 0});
+	}
+	return true;
+}
+
+void Sai2Graphics::integrateLoadedMeshes() {
+	for (auto it = _pending_meshes.begin(); it != _pending_meshes.end();) {
+		PendingMesh& pending = **it;
+		if (pending.loaded.wait_for(std::chrono::seconds(0)) !=
+			std::future_status::ready) {
+			++it;
+			continue;
+		}
+		cMultiMesh* multi_mesh = pending.multi_mesh;
+		cMesh* placeholder = pending.placeholder;
+
+		// the parser may have scaled the multi mesh or set its material after
+		// loadMesh, which only affected the placeholder: do the same to the
+		// loaded meshes
+		const Eigen::Vector3d lower =
+			placeholder->m_vertices->getLocalPos(PLACEHOLDER_LOWER_VERTEX).eigen();
+		const Eigen::Vector3d upper =
+			placeholder->m_vertices->getLocalPos(PLACEHOLDER_UPPER_VERTEX).eigen();
+		Eigen::Vector3d scale = Eigen::Vector3d::Ones();
+		for (int k = 0; k < 3; ++k) {
+			const double size =
+				pending.placeholder_upper(k) - pending.placeholder_lower(k);
+			if (size > 0) {
+				scale(k) = (upper(k) - lower(k)) / size;
+			}
+		}
+		const bool scaled = !scale.isApprox(Eigen::Vector3d::Ones());
+		const cMaterialPtr material = placeholder->m_material;
+		const bool material_changed =
+			material != pending.placeholder_material ||
+			material->m_diffuse.getR() != 0.5f ||
+			material->m_diffuse.getG() != 0.5f ||
+			material->m_diffuse.getB() != 0.5f ||
+			material->m_diffuse.getA() != 1.0f;
+
+		for (size_t level = 0; level < pending.levels.size(); ++level) {
+			for (auto mesh : pending.levels[level]) {
+				if (scaled) {
+					mesh->scaleXYZ(scale(0), scale(1), scale(2));
+				}
+				if (material_changed) {
+					mesh->setMaterial(material);
+					mesh->setUseTransparency(placeholder->getUseTransparency());
+				}
+				mesh->setShowEnabled(level == 0);
+				multi_mesh->addMesh(mesh);
+			}
+		}
+		multi_mesh->deleteMesh(placeholder);
+		multi_mesh->computeBoundaryBox(true);
+		if (pending.levels.size() > 1) {
+			MeshLods lods = {multi_mesh, pending.levels,
+							 Eigen::Vector3d::Zero(), 0.0, 0};
+			computeLodBounds(lods);
+			_mesh_lods.push_back(lods);
+		}
+		it = _pending_meshes.erase(it);
+		markSceneDirty();
+	}
+}
+
+void Sai2Graphics::computeLodBounds(MeshLods& lods) {
+	const Eigen::Vector3d lower = lods.multi_mesh->getBoundaryMin().eigen();
+	const Eigen::Vector3d upper = lods.multi_mesh->getBoundaryMax().eigen();
+	lods.center = 0.5 * (lower + upper);
+	lods.radius = 0.5 * (upper - lower).norm();
 }
 
 }  // namespace Sai2Graphics
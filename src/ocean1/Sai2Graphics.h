@@ -10,6 +10,10 @@
 
 #include <chai3d.h>
 
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
 #include "Sai2Model.h"
 #include "widgets/ForceSensorDisplay.h"
 #include "widgets/UIForceWidget.h"
@@ -20,6 +24,88 @@
 
 namespace Sai2Graphics {
 
+/**
+ * @brief handles on the robots, objects, cameras and force sensor displays of
+ * the graphics world.
+ * Updating through a handle does no name lookup. Handles are only valid until
+ * the world is reset.
+ */
+struct RobotHandle {
+	int index = -1;
+};
+struct ObjectHandle {
+	int index = -1;
+};
+struct CameraHandle {
+	int index = -1;
+};
+struct ForceSensorHandle {
+	int index = -1;
+};
+
+/**
+ * @brief changes below which an update of a robot, object or force sensor
+ * display is ignored, so that still nodes do not make the scene dirty
+ */
+struct UpdateThresholds {
+	// meters
+	double position = 1e-5;
+	// largest change of a rotation matrix coefficient (about radians)
+	double rotation = 1e-5;
+	// radians or meters
+	double joint_angle = 1e-5;
+	// newtons or newton meters
+	double force = 1e-3;
+};
+
+/**
+ * @brief projected sizes at which the meshes with levels of detail (see
+ * Sai2Graphics::loadMesh) switch to a coarser level. A mesh goes to a
+ * coarser level when it gets smaller than the size of that level times
+ * (1 - hysteresis), and back to a finer level when it gets larger than the
+ * size of the current level times (1 + hysteresis).
+ */
+struct LodThresholds {
+	// diameter of the bounding sphere in pixels, for levels 1, 2, ...
+	std::vector<double> pixel_sizes = {200.0, 60.0};
+	double hysteresis = 0.2;
+};
+
+/**
+ * @brief rate at which Sai2Graphics presents frames. With vsync the swap is
+ * also synchronized with the display refresh, so target_fps should not be
+ * above the refresh rate; without, frames are paced by target_fps only.
+ */
+struct FramePacing {
+	double target_fps = 60.0;
+	bool vsync = true;
+};
+
+/**
+ * @brief non owning view of a contiguous array, to pass batches of handles
+ * and poses (e.g. from a std::vector) without copying them
+ */
+template <typename T>
+class Span {
+public:
+	Span() : _data(nullptr), _size(0) {}
+	Span(T* data, size_t size) : _data(data), _size(size) {}
+	template <typename Container>
+	Span(Container& container)
+		: _data(container.data()), _size(container.size()) {}
+
+	T* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	T& operator[](size_t i) const { return _data[i]; }
+	T* begin() const { return _data; }
+	T* end() const { return _data + _size; }
+
+private:
+	T* _data;
+	size_t _size;
+};
+
 class Sai2Graphics {
 public:
 
@@ -47,6 +133,18 @@ public:
 				 const std::string& window_name = "sai2 world",
 				 bool verbose = false);
 
+	/**
+	 * @brief same, with robot models already built by the caller (by robot
+	 * name), so their robot files are not parsed again. The graphics set
+	 * their base pose and joint positions, so they must not be used by
+	 * another thread. Robots missing from the map get their own model.
+	 */
+	Sai2Graphics(
+		const std::string& path_to_world_file,
+		const std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>>&
+			robot_models,
+		const std::string& window_name = "sai2 world", bool verbose = false);
+
 	// dtor
 	~Sai2Graphics();
 
@@ -69,20 +167,49 @@ public:
 	bool isWindowOpen() { return !glfwWindowShouldClose(_window); }
 
 	/**
-	 * @brief renders the graphics world from the current camera (needs to be
-	 * called after all the update functions i.e. updateRobotGraphics)
-	 *
-	 * @param camera_name the name of the camera to display
+	 * @brief waits for the next frame (see setFramePacing) while handling
+	 * the window events, then handles the inputs and presents the frame
+	 * (needs to be called after all the update functions i.e.
+	 * updateRobotGraphics)
 	 */
 	void renderGraphicsWorld();
 
+	/**
+	 * @brief set the target frame rate and vsync mode of the frames
+	 * presented by renderGraphicsWorld and presentFrame
+	 */
+	void setFramePacing(const FramePacing& pacing);
+
+	/**
+	 * @brief poll the window events and apply the mouse and keyboard inputs
+	 * to the camera and the UI force widgets, without rendering. Does not
+	 * block, so it can run at its own rate, faster than the frames.
+	 */
+	void handleInputs();
+
+	/**
+	 * @brief true when the next frame is due according to the frame pacing
+	 */
+	bool isFrameDue() const;
+
+	/**
+	 * @brief render the current camera, if anything changed, and swap it to
+	 * the window, once, without waiting for the GPU to finish the frame.
+	 * Schedules the next frame. With vsync the swap may block until the next
+	 * display refresh.
+	 */
+	void presentFrame();
+
 	/**
 	 * @brief remove all interactions widgets
 	 * after calling that function, right clicking on the window won't
 	 * display lines and generate forces/joint torques
 	 *
 	 */
-	void clearUIForceWidgets() { _ui_force_widgets.clear(); }
+	void clearUIForceWidgets() {
+		_ui_force_widgets.clear();
+		_object_widget_states.clear();
+	}
 
 	/**
 	 * @brief get the joint torques from the ui interaction (right click on
@@ -127,6 +254,34 @@ public:
 							 const Eigen::VectorXd& joint_velocities);
 	void updateRobotGraphics(const std::string& robot_name,
 							 const Eigen::VectorXd& joint_angles);
+	void updateRobotGraphics(const RobotHandle& robot,
+							 const Eigen::VectorXd& joint_angles,
+							 const Eigen::VectorXd& joint_velocities);
+	void updateRobotGraphics(const RobotHandle& robot,
+							 const Eigen::VectorXd& joint_angles);
+
+	/**
+	 * @brief Update the graphics model for a robot from link poses already
+	 * computed elsewhere (e.g. by the simulation), without running the forward
+	 * kinematics of the graphics robot model. The kinematics of that model,
+	 * used by the force sensor displays and the UI force interaction, are
+	 * only updated when one of them needs it.
+	 * @param robot Handle on the robot.
+	 * @param joint_angles joint angles for that robot
+	 * @param link_poses pose of each link in the robot base frame (as given
+	 * by Sai2Model::transform), in the order of getRobotLinkNames
+	 */
+	void updateRobotGraphics(const RobotHandle& robot,
+							 const Eigen::VectorXd& joint_angles,
+							 const std::vector<Eigen::Affine3d>& link_poses);
+
+	/**
+	 * @brief Get the names of the links of a robot in the graphics world, in
+	 * the order of the link poses of updateRobotGraphics. Parents come before
+	 * their children.
+	 */
+	const std::vector<std::string>& getRobotLinkNames(
+		const RobotHandle& robot) const;
 
 	/**
 	 * @brief Update the graphics model for an object in the virtual world.
@@ -137,6 +292,31 @@ public:
 	void updateObjectGraphics(
 		const std::string& object_name, const Eigen::Affine3d& object_pose,
 		const Eigen::Vector6d& object_velocity = Eigen::Vector6d::Zero());
+	void updateObjectGraphics(
+		const ObjectHandle& object, const Eigen::Affine3d& object_pose,
+		const Eigen::Vector6d& object_velocity = Eigen::Vector6d::Zero());
+
+	/**
+	 * @brief Update the graphics model for a batch of objects, in one pass
+	 * over the object registry.
+	 * @param objects Handles on the objects.
+	 * @param object_poses pose of each object in the world
+	 * @param object_velocities velocity of each object, zero if empty
+	 */
+	void updateObjectsGraphics(
+		Span<const ObjectHandle> objects,
+		Span<const Eigen::Affine3d> object_poses,
+		Span<const Eigen::Vector6d> object_velocities =
+			Span<const Eigen::Vector6d>());
+
+	/**
+	 * @brief Get a handle on a robot, object or camera, to update it every
+	 * frame without any name lookup. Throws if there is none with that name.
+	 * @param name Name of the robot, object or camera.
+	 */
+	RobotHandle getRobotHandle(const std::string& robot_name) const;
+	ObjectHandle getObjectHandle(const std::string& object_name) const;
+	CameraHandle getCameraHandle(const std::string& camera_name) const;
 
 	Eigen::VectorXd getRobotJointPos(const std::string& robot_name);
 
@@ -167,6 +347,10 @@ public:
 					   Eigen::Vector3d& ret_position,
 					   Eigen::Vector3d& ret_vertical,
 					   Eigen::Vector3d& ret_lookat);
+	void getCameraPose(const CameraHandle& camera,
+					   Eigen::Vector3d& ret_position,
+					   Eigen::Vector3d& ret_vertical,
+					   Eigen::Vector3d& ret_lookat);
 
 	/**
 	 * @brief Sets the pose of the camera in the parent frame
@@ -179,6 +363,10 @@ public:
 					   const Eigen::Vector3d& position,
 					   const Eigen::Vector3d& vertical,
 					   const Eigen::Vector3d& lookat);
+	void setCameraPose(const CameraHandle& camera,
+					   const Eigen::Vector3d& position,
+					   const Eigen::Vector3d& vertical,
+					   const Eigen::Vector3d& lookat);
 
 
 	/**
@@ -193,24 +381,124 @@ public:
 	void setBackgroundColor(const double red, const double green,
 							const double blue) {
 		_world->setBackgroundColor(red, green, blue);
+		markSceneDirty();
+	}
+
+	/**
+	 * @brief set the changes below which updates are ignored. Render and
+	 * shadow maps are skipped while nothing changes.
+	 */
+	void setUpdateThresholds(const UpdateThresholds& thresholds) {
+		_update_thresholds = thresholds;
+	}
+
+	/**
+	 * @brief set the projected sizes at which meshes switch levels of detail
+	 */
+	void setLodThresholds(const LodThresholds& thresholds) {
+		_lod_thresholds = thresholds;
+		markSceneDirty();
 	}
 
 	std::string getCurrentCameraName() const {
 		return _camera_names[_current_camera_index];
 	}
 
-	void addForceSensorDisplay(const Sai2Model::ForceSensorData& sensor_data);
+	/**
+	 * @brief add a display of the force sensor, on its robot link. Returns
+	 * an invalid handle (with a warning) if the link does not exist or
+	 * already has a display.
+	 */
+	ForceSensorHandle addForceSensorDisplay(
+		const Sai2Model::ForceSensorData& sensor_data);
 
 	void updateDisplayedForceSensor(
 		const Sai2Model::ForceSensorData& force_data);
 
+	/**
+	 * @brief update a force sensor display with the force and moment in the
+	 * world frame. Does no name lookup nor sensor transform check.
+	 */
+	void updateDisplayedForceSensor(const ForceSensorHandle& sensor,
+									const Eigen::Vector3d& force_world_frame,
+									const Eigen::Vector3d& moment_world_frame);
+
 	bool isKeyPressed(int key) const {
 		return glfwGetKey(_window, key) == GLFW_PRESS;
 	}
 
+	/**
+	 * @brief set the directory of the binary mesh cache (see mesh_cache.h),
+	 * used by loadMesh. Needs to be called before the world is loaded. An
+	 * empty directory disables the cache.
+	 */
+	static void setMeshCacheDirectory(const std::string& cache_dir) {
+		_mesh_cache_dir = cache_dir;
+	}
+
+	/**
+	 * @brief load a visual mesh file into a multi mesh, from its memory mapped
+	 * cache file if there is one at least as recent as the mesh file, and
+	 * from the mesh file otherwise. The urdf parser calls it for every visual
+	 * mesh. The decimated levels of detail with fresh cache files are loaded
+	 * too, hidden; render shows the level matching the projected size of the
+	 * mesh (see LodThresholds).
+	 *
+	 * @return true if the mesh was loaded
+	 */
+	static bool loadMesh(chai3d::cMultiMesh* mesh, const std::string& filename);
+
+	/**
+	 * @brief set the number of worker threads building the meshes loaded by
+	 * loadMesh. With workers, loadMesh adds a placeholder box to the multi
+	 * mesh and returns immediately, and renderGraphicsWorld swaps in each
+	 * mesh once it is built. With 0 (the default), loadMesh builds the meshes
+	 * itself.
+	 */
+	static void setMeshLoadingThreads(int num_threads);
+
+	/**
+	 * @brief create the context without a visible window, for machines
+	 * without a display or a GPU. Needs to be called before the graphics are
+	 * constructed. The context comes from EGL (GLFW_EGL_CONTEXT_API) or
+	 * OSMesa (GLFW_OSMESA_CONTEXT_API), on the null platform of GLFW 3.4 and
+	 * later (older versions need an X display, e.g. Xvfb). Nothing is shown,
+	 * so render does nothing: use startFrameCapture to get the frames.
+	 */
+	static void setOffscreen(
+		bool offscreen, int context_creation_api = GLFW_EGL_CONTEXT_API) {
+		_offscreen = offscreen;
+		_context_creation_api = context_creation_api;
+	}
+
+	/**
+	 * @brief capture the world seen from a camera (the displayed camera if
+	 * camera_name is empty) at a fixed frame rate and resolution.
+	 * renderGraphicsWorld renders the frames into a framebuffer object and
+	 * reads them back through two pixel buffer objects, so that each frame
+	 * is copied out one frame later without waiting for the GPU. A background
+	 * thread writes them to path as raw RGBA frames (see frame_writer.h);
+	 * frames are dropped, and counted, if it falls behind. Throws
+	 * std::invalid_argument if the camera does not exist or fps is not
+	 * positive.
+	 */
+	void startFrameCapture(const std::string& path, int width, int height,
+						   double fps = 30.0,
+						   const std::string& camera_name = "");
+
+	/**
+	 * @brief write the last frame and stop the capture. Called by the
+	 * destructor.
+	 */
+	void stopFrameCapture();
+
+	bool isCapturingFrames() const { return _frame_capture != nullptr; }
+
 private:
-	void initializeWorld(const std::string& path_to_world_file,
-						 const bool verbose);
+	void initializeWorld(
+		const std::string& path_to_world_file, const bool verbose,
+		const std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>>&
+			robot_models = {});
 	void clearWorld();
 
 	/**
@@ -220,6 +508,14 @@ private:
 	 */
 	void initializeWindow(const std::string& window_name);
 
+	/**
+	 * @brief index the robots, their links, the objects and the cameras of
+	 * the chai world by name. Called once when the world is initialized.
+	 */
+	void buildWorldIndex(
+		const std::map<std::string, std::shared_ptr<Eigen::Affine3d>>&
+			object_poses);
+
 
 	/* CHAI specific interface */
 	/**
@@ -227,12 +523,12 @@ private:
 	 * @param camera_name Camera name.
 	 */
 	chai3d::cCamera* getCamera(const std::string& camera_name);
+	chai3d::cCamera* getCamera(const CameraHandle& camera);
 
 	/**
-	 * internal functions to find link
+	 * internal functions to find robots and links
 	 */
-	chai3d::cRobotLink* findLinkObjectInParentLinkRecursive(
-		chai3d::cRobotLink* parent, const std::string& link_name);
+	chai3d::cRobotBase* findRobotBase(const std::string& robot_name);
 
 	chai3d::cRobotLink* findLink(const std::string& robot_name,
 								 const std::string& link_name);
@@ -276,8 +572,96 @@ private:
 	std::map<std::string, std::string> _robot_filenames;
 	std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>> _robot_models;
 
-	std::map<std::string, std::shared_ptr<Eigen::Affine3d>> _object_poses;
-	std::map<std::string, std::shared_ptr<Eigen::Vector6d>> _object_velocities;
+
+	/**
+	 * @brief index of the chai world, built by buildWorldIndex. The handles
+	 * are indices in these vectors.
+	 *
+	 */
+	struct RobotEntry {
+		chai3d::cRobotBase* base;
+		std::shared_ptr<Sai2Model::Sai2Model> model;
+		std::unordered_map<std::string, chai3d::cRobotLink*> links;
+		// links in depth first order, with the index of their parent in that
+		// order (-1 for the links attached to the base)
+		std::vector<chai3d::cRobotLink*> link_order;
+		std::vector<std::string> link_names;
+		std::vector<int> link_parents;
+		// poses of the links in the base frame, computed once per update
+		std::vector<Eigen::Affine3d> link_poses;
+		// the joint angles of the model were set without updating its
+		// kinematics
+		bool kinematics_stale;
+		// the chai links must be written at the next update, even if the
+		// joint angles did not change
+		bool links_dirty;
+		// incremented each time the chai links are written
+		unsigned long pose_version;
+	};
+	/**
+	 * @brief objects of the world as a structure of arrays, indexed by the
+	 * object handles (in the order of the object names)
+	 */
+	struct ObjectRegistry {
+		std::vector<std::string> names;
+		// NULL if the object is missing from the chai world
+		std::vector<chai3d::cGenericObject*> objects;
+		std::vector<Eigen::Vector3d> positions;
+		std::vector<Eigen::Matrix3d> rotations;
+		std::vector<Eigen::Vector6d> velocities;
+	};
+	std::vector<RobotEntry> _robots;
+	std::unordered_map<std::string, int> _robot_indices;
+	ObjectRegistry _objects;
+	std::unordered_map<std::string, int> _object_indices;
+
+	/**
+	 * @brief pose and velocity of the objects that have a UI force widget,
+	 * copied from the registry only before the widgets use them
+	 */
+	struct ObjectWidgetState {
+		int index;
+		std::shared_ptr<Eigen::Affine3d> pose;
+		std::shared_ptr<Eigen::Vector6d> velocity;
+	};
+	std::vector<ObjectWidgetState> _object_widget_states;
+	std::vector<chai3d::cCamera*> _cameras;
+	std::unordered_map<std::string, int> _camera_indices;
+	// last pose set for each camera, to ignore calls that do not move it
+	struct CameraPose {
+		Eigen::Vector3d position;
+		Eigen::Vector3d vertical;
+		Eigen::Vector3d lookat;
+		bool set;
+	};
+	std::vector<CameraPose> _camera_poses;
+
+	/**
+	 * @brief index the links of a robot by name, and list them depth first
+	 * so that each link comes after its parent
+	 */
+	static void indexLinksRecursive(chai3d::cGenericObject* parent,
+									int parent_index, RobotEntry& robot);
+
+	/**
+	 * @brief set the local transforms of the chai links of a robot from the
+	 * poses of its links in the base frame, in one pass over the link order
+	 */
+	void updateRobotLinks(RobotEntry& robot,
+						  const std::vector<Eigen::Affine3d>& link_poses);
+
+	/**
+	 * @brief update the kinematics of the robot model if they were skipped
+	 * by the link poses update
+	 */
+	void updateRobotKinematicsIfStale(RobotEntry& robot);
+
+	Eigen::Affine3d objectPose(int index) const;
+	void setObjectPose(int index, const Eigen::Affine3d& object_pose,
+					   const Eigen::Vector6d& object_velocity);
+	void checkObjectHandle(const ObjectHandle& object,
+						   const std::string& function_name) const;
+	void syncObjectWidgetStates();
 
 	/**
 	 * @brief force sensor displays
@@ -285,6 +669,21 @@ private:
 	 */
 	std::vector<std::shared_ptr<ForceSensorDisplay>> _force_sensor_displays;
 
+	/**
+	 * @brief last displayed values of each force sensor display, to skip
+	 * updates that would not change it
+	 *
+	 */
+	struct ForceSensorDisplayState {
+		int robot_index;
+		Eigen::Vector3d force;
+		Eigen::Vector3d moment;
+		// pose version of the robot when the display was last updated
+		unsigned long robot_pose_version;
+		bool dirty;
+	};
+	std::vector<ForceSensorDisplayState> _force_sensor_display_states;
+
 	/**
 	 * @brief vector of camera names in the world and current camera index
 	 *
@@ -302,6 +701,85 @@ private:
 
 	int _window_width;
 	int _window_height;
+
+	/**
+	 * @brief dirty tracking. The scene is dirty when a node changed since the
+	 * last rendered frame, the shadow maps when a node changed since they
+	 * were last updated. A frame is pending when it was rendered but not
+	 * swapped to the window yet.
+	 *
+	 */
+	UpdateThresholds _update_thresholds;
+	bool _scene_dirty;
+	bool _shadow_maps_dirty;
+	bool _frame_pending;
+	FramePacing _frame_pacing;
+	std::chrono::steady_clock::time_point _next_frame_time;
+	chai3d::cCamera* _last_rendered_camera;
+	int _last_rendered_width;
+	int _last_rendered_height;
+
+	void markSceneDirty() {
+		_scene_dirty = true;
+		_shadow_maps_dirty = true;
+	}
+
+	static std::string _mesh_cache_dir;
+
+	/**
+	 * @brief meshes of each level of detail of a visual mesh (level 0 is the
+	 * full mesh), and its bounding sphere in the frame of the multi mesh
+	 */
+	struct MeshLods {
+		chai3d::cMultiMesh* multi_mesh;
+		std::vector<std::vector<chai3d::cMesh*>> levels;
+		Eigen::Vector3d center;
+		double radius;
+		int current;
+	};
+	LodThresholds _lod_thresholds;
+	std::vector<MeshLods> _mesh_lods;
+	// meshes with levels of detail loaded by loadMesh while the parser builds
+	// a world, picked up by initializeWorld
+	static std::vector<MeshLods> _loaded_mesh_lods;
+
+	/**
+	 * @brief show the level of detail of every mesh matching its projected
+	 * size from the camera, in a viewport of the given height
+	 */
+	void selectLods(chai3d::cCamera* camera, int viewport_height);
+
+	static void computeLodBounds(MeshLods& lods);
+
+	/**
+	 * @brief meshes built by the loading threads, with the placeholder shown
+	 * until they are ready. Those of the world being parsed are picked up by
+	 * initializeWorld.
+	 */
+	struct PendingMesh;
+	std::vector<std::shared_ptr<PendingMesh>> _pending_meshes;
+	static std::vector<std::shared_ptr<PendingMesh>> _loading_meshes;
+
+	/**
+	 * @brief replace the placeholders of the meshes that finished loading,
+	 * on the thread of the OpenGL context
+	 */
+	void integrateLoadedMeshes();
+
+	static bool _offscreen;
+	static int _context_creation_api;
+
+	/**
+	 * @brief framebuffer, pixel buffers and writer of the frame capture
+	 */
+	struct FrameCapture;
+	std::unique_ptr<FrameCapture> _frame_capture;
+
+	/**
+	 * @brief render and read back the next captured frame if it is due, and
+	 * hand the previous one to the writer
+	 */
+	void captureFrame();
 };
 
 }  // namespace Sai2Graphics
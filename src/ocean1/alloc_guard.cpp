@@ -0,0 +1,222 @@
+/**
+ * @file alloc_guard.cpp
+ * @brief Replacement of the global allocation functions counting the
+ * allocations made while an AllocGuard is started
+ *
+ */
+
+#include "alloc_guard.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "cli_args.h"
+
+#if defined(OCEAN1_ENABLE_ALLOC_GUARD) && defined(__GLIBC__)
+// the allocator behind malloc. Eigen allocates its dynamic matrices with
+// malloc, not operator new, so with glibc malloc and the aligned entry points
+// are replaced as well and forward to the glibc allocator. free does not need
+// a replacement.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+#endif
+
+namespace Ocean1 {
+
+namespace {
+
+// constant initialized, so that reading them never allocates
+thread_local AllocGuardMode t_mode = AllocGuardMode::OFF;
+thread_local uint64_t t_count = 0;
+
+#ifdef OCEAN1_ENABLE_ALLOC_GUARD
+
+inline void onAllocation() {
+	if (t_mode == AllocGuardMode::OFF) {
+		return;
+	}
+	++t_count;
+	if (t_mode == AllocGuardMode::ABORT) {
+		t_mode = AllocGuardMode::OFF;
+		static const char message[] =
+			"alloc guard: heap allocation inside the control tick\n";
+		ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+		(void)written;
+		std::abort();
+	}
+}
+
+inline void* rawMalloc(size_t size) {
+#if defined(__GLIBC__)
+	return __libc_malloc(size);
+#else
+	return std::malloc(size);
+#endif
+}
+
+inline void* rawAlignedMalloc(size_t alignment, size_t size) {
+#if defined(__GLIBC__)
+	return __libc_memalign(alignment, size);
+#else
+	void* ptr = nullptr;
+	return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+#endif
+}
+
+void* guardedNew(size_t size) {
+	onAllocation();
+	void* ptr = rawMalloc(size == 0 ? 1 : size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* guardedAlignedNew(size_t size, std::align_val_t alignment) {
+	onAllocation();
+	void* ptr =
+		rawAlignedMalloc(static_cast<size_t>(alignment), size == 0 ? 1 : size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+#endif	// OCEAN1_ENABLE_ALLOC_GUARD
+
+}  // namespace
+
+AllocGuardMode allocGuardModeFromArgs(int argc, char** argv) {
+#ifndef OCEAN1_ENABLE_ALLOC_GUARD
+	if (hasFlag(argc, argv, "--alloc-guard")) {
+		std::cerr << "--alloc-guard needs a build with "
+					 "-DOCEAN1_ENABLE_ALLOC_GUARD=ON, ignored\n";
+	}
+	return AllocGuardMode::OFF;
+#else
+	if (flagValue(argc, argv, "--alloc-guard") == "abort") {
+		return AllocGuardMode::ABORT;
+	}
+	if (hasFlag(argc, argv, "--alloc-guard")) {
+		return AllocGuardMode::COUNT;
+	}
+	return AllocGuardMode::OFF;
+#endif
+}
+
+void AllocGuard::start() {
+	_start_count = t_count;
+	t_mode = _mode;
+}
+
+uint64_t AllocGuard::stop() {
+	t_mode = AllocGuardMode::OFF;
+	const uint64_t tick_allocations = t_count - _start_count;
+	++_ticks;
+	if (tick_allocations > 0) {
+		++_ticks_with_allocations;
+		_allocations += tick_allocations;
+		if (tick_allocations > _max_allocations_per_tick) {
+			_max_allocations_per_tick = tick_allocations;
+		}
+	}
+	return tick_allocations;
+}
+
+void AllocGuard::printInfoPostRun() const {
+	std::cout << "guarded ticks: " << _ticks
+			  << ", ticks with allocations: " << _ticks_with_allocations
+			  << "\n";
+	std::cout << "allocations: " << _allocations << " (max "
+			  << _max_allocations_per_tick << " in one tick)\n";
+}
+
+}  // namespace Ocean1
+
+#ifdef OCEAN1_ENABLE_ALLOC_GUARD
+
+// global replacements. The matching operator delete of the standard library
+// frees with free, which fits the allocators used here.
+void* operator new(size_t size) { return Ocean1::guardedNew(size); }
+void* operator new[](size_t size) { return Ocean1::guardedNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return Ocean1::guardedNew(size);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return Ocean1::guardedNew(size);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+	return Ocean1::guardedAlignedNew(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return Ocean1::guardedAlignedNew(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* malloc(size_t size) {
+	Ocean1::onAllocation();
+	return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+	Ocean1::onAllocation();
+	return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+	Ocean1::onAllocation();
+	return __libc_realloc(ptr, size);
+}
+void* memalign(size_t alignment, size_t size) {
+	Ocean1::onAllocation();
+	return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+	Ocean1::onAllocation();
+	return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+	if (alignment % sizeof(void*) != 0 ||
+		(alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+	Ocean1::onAllocation();
+	void* result = __libc_memalign(alignment, size);
+	if (!result) {
+		return ENOMEM;
+	}
+	*ptr = result;
+	return 0;
+}
+}
+#endif	// __GLIBC__
+
+#endif	// OCEAN1_ENABLE_ALLOC_GUARD
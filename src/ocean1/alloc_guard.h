@@ -0,0 +1,65 @@
+/**
+ * @file alloc_guard.h
+ * @brief Detection of heap allocations inside the control tick. Built with
+ * OCEAN1_ENABLE_ALLOC_GUARD, alloc_guard.cpp replaces the global operator new
+ * (and, with glibc, malloc, calloc, realloc, memalign, aligned_alloc and
+ * posix_memalign) by versions that count the allocations made by a thread
+ * between AllocGuard::start() and AllocGuard::stop(). Not counted: valloc,
+ * pvalloc, mmap, and the allocations made by other threads. Without the
+ * option nothing is replaced and the guard stays off.
+ *
+ */
+
+#ifndef OCEAN1_ALLOC_GUARD_H
+#define OCEAN1_ALLOC_GUARD_H
+
+#include <cstdint>
+
+namespace Ocean1 {
+
+enum class AllocGuardMode { OFF, COUNT, ABORT };
+
+/**
+ * @brief select the mode from the command line: "--alloc-guard" counts the
+ * guarded allocations, "--alloc-guard=abort" aborts on the first one
+ */
+AllocGuardMode allocGuardModeFromArgs(int argc, char** argv);
+
+/**
+ * @brief Guard around the allocation free part of a loop iteration. Between
+ * start() and stop(), the allocations of the calling thread are counted, or
+ * abort the program in ABORT mode. Keeps per tick statistics.
+ *
+ */
+class AllocGuard {
+public:
+	explicit AllocGuard(AllocGuardMode mode) : _mode(mode) {}
+
+	bool enabled() const { return _mode != AllocGuardMode::OFF; }
+
+	/**
+	 * @brief start guarding the allocations of the calling thread
+	 */
+	void start();
+
+	/**
+	 * @brief stop guarding and record the tick
+	 *
+	 * @return number of allocations since start()
+	 */
+	uint64_t stop();
+
+	void printInfoPostRun() const;
+
+private:
+	AllocGuardMode _mode;
+	uint64_t _start_count = 0;
+	uint64_t _ticks = 0;
+	uint64_t _ticks_with_allocations = 0;
+	uint64_t _allocations = 0;
+	uint64_t _max_allocations_per_tick = 0;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_ALLOC_GUARD_H
@@ -0,0 +1,45 @@
+/**
+ * @file cli_args.h
+ * @brief Minimal command line flag helpers shared by the ocean1 executables
+ *
+ */
+
+#ifndef OCEAN1_CLI_ARGS_H
+#define OCEAN1_CLI_ARGS_H
+
+#include <string>
+
+namespace Ocean1 {
+
+/**
+ * @brief returns true if the exact flag (e.g. "--shm") was given on the
+ * command line
+ */
+inline bool hasFlag(int argc, char** argv, const std::string& flag) {
+	for (int i = 1; i < argc; ++i) {
+		if (flag == argv[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief returns the value of a "--name=value" flag, or default_value if the
+ * flag was not given
+ */
+inline std::string flagValue(int argc, char** argv, const std::string& flag,
+							 const std::string& default_value = "") {
+	const std::string prefix = flag + "=";
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg.compare(0, prefix.size(), prefix) == 0) {
+			return arg.substr(prefix.size());
+		}
+	}
+	return default_value;
+}
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_CLI_ARGS_H
@@ -1,105 +1,42 @@
 /**
  * @file controller.cpp
- * @brief Controller file
- * 
+ * @brief Controller file. Hosts the ocean1 controller (ocean1_controller.h)
+ * and exchanges its inputs and outputs with the simulator and the haptic
+ * devices.
+ *
  */
 
+#include <chrono>
 #include <iostream>
-#include <mutex>
-#include <random>
 #include <Sai2Model.h>
 #include <signal.h>
 #include <string>
-#include <fstream>
 #include <thread>
 #include <vector>
 
-#include "Sai2Graphics.h"
-#include "Sai2Primitives.h"
-#include "Sai2Simulation.h"
+#include "alloc_guard.h"
+#include "cli_args.h"
+#include "ocean1_controller.h"
+#include "phase_profiler.h"
 #include "redis_keys.h"
+#include "sim_transport.h"
+#include "telemetry_logger.h"
+#include "redis_binary_client.h"
 #include "redis/RedisClient.h"
 #include "redis/keys/chai_haptic_devices_driver.h"
 #include "timer/LoopTimer.h"
 
 using namespace std;
 using namespace Eigen;
-using namespace Sai2Primitives;
 using namespace Sai2Common::ChaiHapticDriverKeys;
 
-const double MAX_HAPTIC_FORCE = 3.0;
-const double THRESHOLD = 1.0;
-const double KS = 0.001;
 bool runloop = false;
 void sighandler(int){runloop = false;}
 
-// States 
-enum State {
-	POSTURE = 0, 
-	MOTION
-};
-
-Eigen::VectorXd generateRandomVector(double lowerBound, double upperBound, int size) {
-    // Initialize a random number generator
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<double> dis(lowerBound, upperBound);
-
-    // Generate random vector
-    Eigen::VectorXd randomVec(size);
-    for (int i = 0; i < size; ++i) {
-        randomVec(i) = dis(gen);
-    }
-
-    return randomVec;
-}
-
-// Function to calculate the angle between two 2D vectors using atan2
-double calculate_angle_atan2(const Eigen::Vector2d& v1, const Eigen::Vector2d& v2) {
-    double angle1 = atan2(v1.y(), v1.x());
-    double angle2 = atan2(v2.y(), v2.x());
-    double angle = angle1 - angle2;
-
-    // Normalize the angle to the range [-pi, pi]
-    if (angle > M_PI) {
-        angle -= 2 * M_PI;
-    } else if (angle < -M_PI) {
-        angle += 2 * M_PI;
-    }
-
-    return angle;
-}
-
-// Function to calculate the rotations about x, y, and z axes
-Eigen::Vector3d calculate_rotations(const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
-    // Projections onto the yz-plane (perpendicular to the x-axis)
-    Eigen::Vector2d a_yz(a.y(), a.z());
-    Eigen::Vector2d b_yz(b.y(), b.z());
-    double angle_x = calculate_angle_atan2(a_yz, b_yz);
-
-    // Projections onto the xz-plane (perpendicular to the y-axis)
-    Eigen::Vector2d a_xz(a.x(), a.z());
-    Eigen::Vector2d b_xz(b.x(), b.z());
-    double angle_y = calculate_angle_atan2(a_xz, b_xz);
-
-    // Projections onto the xy-plane (perpendicular to the z-axis)
-    Eigen::Vector2d a_xy(a.x(), a.y());
-    Eigen::Vector2d b_xy(b.x(), b.y());
-    double angle_z = calculate_angle_atan2(a_xy, b_xy);
-
-    // Return the angles as a Vector3d (in radians)
-    return Eigen::Vector3d(angle_x, angle_y, angle_z);
-}
-
-int main() {
+int main(int argc, char** argv) {
 	// Location of URDF files specifying world and robot information
 	static const string robot_file = string(CS225A_URDF_FOLDER) + "/ocean1/ocean1.urdf";
-	vector<string> link_names = {"endEffector_left", "endEffector_right"};
 
-	// initial state 
-	int state = POSTURE;
-	string controller_status = "1";
-	
 	// start redis client
 	auto redis_client = Sai2Common::RedisClient();
 	redis_client.connect();
@@ -109,419 +46,247 @@ int main() {
 	signal(SIGTERM, &sighandler);
 	signal(SIGINT, &sighandler);
 
-	// load robots, read current state and update the model
+	// load robots, wait for the first state of the simulator and update the
+	// model. The shared memory segment only exists once simviz_ocean1 runs,
+	// and only a state notified after the transport is created counts, so
+	// that the keys an earlier run left in redis are not taken for it.
+	runloop = true;
 	auto robot = std::make_shared<Sai2Model::Sai2Model>(robot_file, false);
-	robot->setQ(redis_client.getEigen(JOINT_ANGLES_KEY));
-	robot->setDq(redis_client.getEigen(JOINT_VELOCITIES_KEY));
+	std::unique_ptr<Ocean1::SimTransport> transport;
+	Ocean1::SimState sim_state;
+	string wait_reason;
+	while (runloop) {
+		string reason = "waiting for the first state of simviz_ocean1";
+		try {
+			if (!transport) {
+				transport = Ocean1::createSimTransport(
+					Ocean1::transportTypeFromArgs(argc, argv), robot->dof(), false);
+			}
+			if (transport->waitForNewState(0.1) && transport->readState(sim_state)) {
+				break;
+			}
+		} catch (const std::runtime_error& e) {
+			reason = e.what();
+			this_thread::sleep_for(chrono::milliseconds(100));
+		}
+		if (reason != wait_reason) {
+			cout << reason << endl;
+			wait_reason = reason;
+		}
+	}
+	if (!runloop) {
+		return 0;
+	}
+	robot->setQ(sim_state.q);
+	robot->setDq(sim_state.dq);
 	robot->updateModel();
 
-	// prepare controller
+	// prepare controller, with the limits of the haptic devices
 	int dof = robot->dof();
-	VectorXd command_torques = VectorXd::Zero(dof); 
-	MatrixXd N_prec = MatrixXd::Identity(dof, dof);
-
-    // create haptic controllers
-	Affine3d device_home_pose = Affine3d(Translation3d(0, 0, 0));
-	Vector3i directions_of_proxy_feedback = Vector3i::Zero();
-	bool haptic_button_was_pressed = false;
-	int haptic_button_is_pressed = 0;
+	VectorXd command_torques = VectorXd::Zero(dof);
+	vector<Ocean1::HapticDeviceLimits> device_limits(Ocean1::Ocean1Controller::NUM_HAPTIC_DEVICES);
+	for (int i = 0; i < device_limits.size(); ++i) {
+		device_limits[i].max_stiffness = redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_STIFFNESS_KEY_SUFFIX, i));
+		device_limits[i].max_damping = redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_DAMPING_KEY_SUFFIX, i));
+		device_limits[i].max_force = redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_FORCE_KEY_SUFFIX, i));
+	}
+	Ocean1::Ocean1Controller controller(device_limits);
+	controller.init(robot);
+#ifdef OCEAN1_FIXED_DOF
+	if (!controller.robotSupported()) {
+		cout << "controller_ocean1_fixed is built for " << OCEAN1_FIXED_DOF
+			 << " joints, use controller_ocean1 for this robot" << endl;
+		return -1;
+	}
+#endif
 
-	Sai2Primitives::HapticDeviceController::DeviceLimits device_limits_left(
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_STIFFNESS_KEY_SUFFIX, 0)),
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_DAMPING_KEY_SUFFIX, 0)),
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_FORCE_KEY_SUFFIX, 0)));
-	Matrix3d left_device_base_rotation_in_world = AngleAxisd(M_PI, Vector3d::UnitZ()).toRotationMatrix();
-    auto haptic_controller_left =
-		make_shared<Sai2Primitives::HapticDeviceController>(
-			device_limits_left, robot->transformInWorld(link_names[0]), device_home_pose, left_device_base_rotation_in_world);
-	haptic_controller_left->setScalingFactors(3.5);
-	haptic_controller_left->setReductionFactorForce(0.1);
-	haptic_controller_left->setHapticControlType(Sai2Primitives::HapticControlType::HOMING);
-	haptic_controller_left->disableOrientationTeleop();
-	haptic_controller_left->setVariableDampingGainsPos(vector<double>{0.05, 0.15}, vector<double>{10, 40});
-	Sai2Primitives::HapticControllerInput haptic_input_left;
-	Sai2Primitives::HapticControllerOtuput haptic_output_left;
-	auto haptic_init_position_left = haptic_input_left.robot_position;
-	
-	Sai2Primitives::HapticDeviceController::DeviceLimits device_limits_right(
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_STIFFNESS_KEY_SUFFIX, 1)),
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_DAMPING_KEY_SUFFIX, 1)),
-		redis_client.getEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(MAX_FORCE_KEY_SUFFIX, 1)));
-	Matrix3d right_device_base_rotation_in_world = AngleAxisd(M_PI, Vector3d::UnitZ()).toRotationMatrix();
-    auto haptic_controller_right =
-		make_shared<Sai2Primitives::HapticDeviceController>(
-			device_limits_right, robot->transformInWorld(link_names[1]), device_home_pose, right_device_base_rotation_in_world);
-	haptic_controller_right->setScalingFactors(3.5);
-	haptic_controller_right->setReductionFactorForce(0.1);
-	haptic_controller_right->setHapticControlType(Sai2Primitives::HapticControlType::HOMING);
-	haptic_controller_right->disableOrientationTeleop();
-	haptic_controller_right->setVariableDampingGainsPos(vector<double>{0.05, 0.15}, vector<double>{10, 40});
-	Sai2Primitives::HapticControllerInput haptic_input_right;
-	Sai2Primitives::HapticControllerOtuput haptic_output_right;
-	auto haptic_init_position_right = haptic_input_right.robot_position;
-    
+	auto& haptic_input_left = controller.hapticInput(0);
+	auto& haptic_output_left = controller.hapticOutput(0);
+	auto& haptic_input_right = controller.hapticInput(1);
+	auto& haptic_output_right = controller.hapticOutput(1);
+	int& haptic_button_is_pressed = controller.hapticButtonPressed();
 	for (int i=0; i<2; i++) {
 		redis_client.setInt(Sai2Common::ChaiHapticDriverKeys::createRedisKey(SWITCH_PRESSED_KEY_SUFFIX, i),
 						haptic_button_is_pressed);
 		redis_client.setInt(Sai2Common::ChaiHapticDriverKeys::createRedisKey(USE_GRIPPER_AS_SWITCH_KEY_SUFFIX, i), 1);
 	}
-	
-    // setup redis communication
-	redis_client.addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 0),
-								haptic_output_left.device_command_force);
-	redis_client.addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_TORQUE_KEY_SUFFIX, 0),
-								haptic_output_left.device_command_moment);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(POSITION_KEY_SUFFIX, 0),
-								   haptic_input_left.device_position);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ROTATION_KEY_SUFFIX, 0),
-								   haptic_input_left.device_orientation);
-	redis_client.addToReceiveGroup(
-		Sai2Common::ChaiHapticDriverKeys::createRedisKey(LINEAR_VELOCITY_KEY_SUFFIX, 0),
-		haptic_input_left.device_linear_velocity);
-	redis_client.addToReceiveGroup(
-		Sai2Common::ChaiHapticDriverKeys::createRedisKey(ANGULAR_VELOCITY_KEY_SUFFIX, 0),
-		haptic_input_left.device_angular_velocity);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(SWITCH_PRESSED_KEY_SUFFIX, 0),
-								   haptic_button_is_pressed);
-
-	redis_client.addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 1),
-								haptic_output_right.device_command_force);
-	redis_client.addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_TORQUE_KEY_SUFFIX, 1),
-								haptic_output_right.device_command_moment);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(POSITION_KEY_SUFFIX, 1),
-								   haptic_input_right.device_position);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ROTATION_KEY_SUFFIX, 1),
-								   haptic_input_right.device_orientation);
-	redis_client.addToReceiveGroup(
-		Sai2Common::ChaiHapticDriverKeys::createRedisKey(LINEAR_VELOCITY_KEY_SUFFIX, 1),
-		haptic_input_right.device_linear_velocity);
-	redis_client.addToReceiveGroup(
-		Sai2Common::ChaiHapticDriverKeys::createRedisKey(ANGULAR_VELOCITY_KEY_SUFFIX, 1),
-		haptic_input_right.device_angular_velocity);
-	redis_client.addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(SWITCH_PRESSED_KEY_SUFFIX, 1),
-								   haptic_button_is_pressed);
-
-	// create map for arm pose tasks
-    std::map<std::string, std::shared_ptr<Sai2Primitives::MotionForceTask>> pose_tasks;
-
-    const std::vector<std::string> control_links = {"endEffector_left", "endEffector_right"};
-    const std::vector<Vector3d> control_points = {Vector3d(0, 0, 0), Vector3d(0, 0, 0)};
-
-	Vector3d handReference;
-	Vector3d leftHandPos;
-	Vector3d rightHandPos;
-	Vector3d leftHandRef = robot->position("endEffector_left", Vector3d(0, 0, 0));
-	Vector3d rightHandRef = robot->position("endEffector_right", Vector3d(0, 0, 0));
-	handReference = leftHandRef - rightHandRef; //Initialize hand reference vector
-	
-	Vector3d handDifference;
-	handDifference = leftHandRef - rightHandRef; //Initialize hand difference vector
-
-	int k = 0;
-
-	Vector3d goalBodyOrientation;
-
-	Vector3d endEffectorPosSum;
-	endEffectorPosSum = Vector3d(0, 0, 0);
-
-    for (auto name : control_links) {
-        endEffectorPosSum += robot->position(control_links[k], control_points[k]);
-        ++k;
-    }
-
-	Vector3d endEffectorPosAverage;
-	endEffectorPosAverage = endEffectorPosSum/2;
 
-	const std::string body_control_link = "Body";
-    const std::vector<Vector3d> body_control_point = {Vector3d(0, 0, 0)};
-
-	Vector3d initialBodyPosition;
-	initialBodyPosition = Vector3d(robot->position(body_control_link, body_control_point[0]));
-
-	Vector3d endEffectorToBodyDistance;
-	endEffectorToBodyDistance = endEffectorPosAverage - initialBodyPosition; //Distance between end effectors and body position
-
-	Vector3d goalBodyPosition;
-	goalBodyPosition = endEffectorPosAverage - endEffectorToBodyDistance; //Initialize goal body position
-
-    for (int i = 0; i < control_links.size(); ++i) {        
-        Affine3d compliant_frame = Affine3d::Identity();
-        compliant_frame.translation() = control_points[i];
-        pose_tasks[control_links[i]] = std::make_shared<Sai2Primitives::MotionForceTask>(robot, control_links[i], compliant_frame);
-        pose_tasks[control_links[i]]->disableInternalOtg();
-        pose_tasks[control_links[i]]->setDynamicDecouplingType(Sai2Primitives::FULL_DYNAMIC_DECOUPLING);
-        pose_tasks[control_links[i]]->setPosControlGains(400, 40, 0);
-        pose_tasks[control_links[i]]->setOriControlGains(400, 40, 0);
-    }
-
-    // base partial joint task 
-    int num_base_joints = 6;
-	MatrixXd base_selection_matrix = MatrixXd::Zero(num_base_joints, robot->dof());
-	base_selection_matrix.block(0, 0, num_base_joints, num_base_joints).setIdentity();
-    cout << base_selection_matrix << endl;
-	auto base_task = std::make_shared<Sai2Primitives::JointTask>(robot, base_selection_matrix);
-	base_task->setGains(400, 40, 0);
-
-	VectorXd q_desired = robot->q();
-
-	// dual arm partial joint task 
-    int num_arm_joints = 14;
-	MatrixXd arms_selection_matrix = MatrixXd::Zero(num_arm_joints, robot->dof());
-	arms_selection_matrix.block(0, 6, num_arm_joints, num_arm_joints).setIdentity();
-    cout << arms_selection_matrix << endl;
-	auto arms_posture_task = std::make_shared<Sai2Primitives::JointTask>(robot, arms_selection_matrix);
-	arms_posture_task->setGains(400, 40, 0); 
-
-	// get starting poses
-    std::vector<Affine3d> starting_pose;
-    for (int i = 0; i < control_links.size(); ++i) {
-        Affine3d current_pose;
-        current_pose.translation() = robot->position(control_links[i], control_points[i]);
-        current_pose.linear() = robot->rotation(control_links[i]);
-        starting_pose.push_back(current_pose);
-    }
-    
-	ofstream file_test;
-    file_test.open("test.txt");
+    // setup redis communication. the haptic keys join the pipelined batches
+	// of the redis transports, or get their own batches with the shared
+	// memory transport
+	Ocean1::RedisBinaryClient* haptic_io = transport->redisClient();
+	std::unique_ptr<Ocean1::RedisBinaryClient> haptic_io_client;
+	if (!haptic_io) {
+		haptic_io_client = std::make_unique<Ocean1::RedisBinaryClient>();
+		haptic_io_client->connect();
+		haptic_io = haptic_io_client.get();
+	}
+	haptic_io->addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 0),
+							haptic_output_left.device_command_force, Ocean1::WireCodec::TEXT, Ocean1::SIM_COMMAND_GROUP);
+	haptic_io->addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_TORQUE_KEY_SUFFIX, 0),
+							haptic_output_left.device_command_moment, Ocean1::WireCodec::TEXT, Ocean1::SIM_COMMAND_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(POSITION_KEY_SUFFIX, 0),
+							   haptic_input_left.device_position, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ROTATION_KEY_SUFFIX, 0),
+							   haptic_input_left.device_orientation, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(LINEAR_VELOCITY_KEY_SUFFIX, 0),
+							   haptic_input_left.device_linear_velocity, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ANGULAR_VELOCITY_KEY_SUFFIX, 0),
+							   haptic_input_left.device_angular_velocity, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(SWITCH_PRESSED_KEY_SUFFIX, 0),
+							   haptic_button_is_pressed, Ocean1::SIM_STATE_GROUP);
+
+	haptic_io->addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 1),
+							haptic_output_right.device_command_force, Ocean1::WireCodec::TEXT, Ocean1::SIM_COMMAND_GROUP);
+	haptic_io->addToSendGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_TORQUE_KEY_SUFFIX, 1),
+							haptic_output_right.device_command_moment, Ocean1::WireCodec::TEXT, Ocean1::SIM_COMMAND_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(POSITION_KEY_SUFFIX, 1),
+							   haptic_input_right.device_position, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ROTATION_KEY_SUFFIX, 1),
+							   haptic_input_right.device_orientation, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(LINEAR_VELOCITY_KEY_SUFFIX, 1),
+							   haptic_input_right.device_linear_velocity, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(ANGULAR_VELOCITY_KEY_SUFFIX, 1),
+							   haptic_input_right.device_angular_velocity, Ocean1::WireCodec::TEXT, Ocean1::SIM_STATE_GROUP);
+	haptic_io->addToReceiveGroup(Sai2Common::ChaiHapticDriverKeys::createRedisKey(SWITCH_PRESSED_KEY_SUFFIX, 1),
+							   haptic_button_is_pressed, Ocean1::SIM_STATE_GROUP);
+
+	// binary telemetry, written to disk by a background thread so that the
+	// loop never blocks on file I/O
+	Ocean1::TelemetryLogger telemetry("telemetry_controller.bin");
+	const int goal_body_stream = telemetry.addStream("goal_body", {"x", "y", "z", "rx", "ry", "rz"});
+	vector<string> torque_columns = {"state_seq"};
+	for (int i = 0; i < dof; ++i) {
+		torque_columns.push_back("tau" + to_string(i));
+	}
+	const int command_stream = telemetry.addStream("command", torque_columns);
+	telemetry.start();
 
 	// create a loop timer
-	runloop = true;
 	double control_freq = 1000;
 	Sai2Common::LoopTimer timer(control_freq, 1e6);
-	double prev_time = timer.elapsedSimTime();
-	auto prev_left_goal_position = pose_tasks["endEffector_left"]->getCurrentPosition();
-	auto prev_right_goal_position = pose_tasks["endEffector_right"]->getCurrentPosition();
-	auto curr_haptic_position_left = pose_tasks["endEffector_left"]->getCurrentPosition();
-	auto curr_haptic_position_right = pose_tasks["endEffector_right"]->getCurrentPosition();
-	// haptic_controller_left->setScalingFactors(0.5, 1.0);
-	// haptic_controller_right->setScalingFactors(0.5, 1.0);
-	while (runloop) {
-		timer.waitForNextLoop();
-		const double time = timer.elapsedSimTime();
-
-		// update robot 
-		robot->setQ(redis_client.getEigen(JOINT_ANGLES_KEY));
-		robot->setDq(redis_client.getEigen(JOINT_VELOCITIES_KEY));
-		robot->updateModel();
-
-		Matrix3d body_rotation_in_world = robot->rotationInWorld("Body");
-
-		// robot_controller->updateControllerTaskModels();
-
-        // read haptic device state from Redis
-		redis_client.receiveAllFromGroup();
 
-        // compute haptic control
-		haptic_input_left.robot_position = robot->positionInWorld(link_names[0]);
-		haptic_input_left.robot_orientation = robot->rotationInWorld(link_names[0]);
-		haptic_input_left.robot_linear_velocity =
-			robot->linearVelocityInWorld(link_names[0]);
-		haptic_input_left.robot_angular_velocity =
-			robot->angularVelocityInWorld(link_names[0]);
-		haptic_input_left.robot_sensed_force = redis_client.getEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT);
-		haptic_output_left = haptic_controller_left->computeHapticControl(haptic_input_left);
-
-		haptic_input_right.robot_position = robot->positionInWorld(link_names[1]);
-		haptic_input_right.robot_orientation = robot->rotationInWorld(link_names[1]);
-		haptic_input_right.robot_linear_velocity =
-			robot->linearVelocityInWorld(link_names[1]);
-		haptic_input_right.robot_angular_velocity =
-			robot->angularVelocityInWorld(link_names[1]);
-		haptic_input_right.robot_sensed_force = redis_client.getEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT);
-		haptic_output_right = haptic_controller_right->computeHapticControl(haptic_input_right);
-
-		redis_client.sendAllFromGroup();
-	
-		if (state == POSTURE) {
-			// update task model 
-			N_prec.setIdentity();
-			arms_posture_task->updateTaskModel(N_prec);
-
-			command_torques = arms_posture_task->computeTorques();
-
-			if ((robot->q() - q_desired).norm() < 1e-2) {
-				cout << "Posture To Motion" << endl;
-				for (auto name : control_links) {
-					pose_tasks[name]->reInitializeTask();
-				}
-				arms_posture_task->reInitializeTask();
-
-				state = MOTION;
+	// in event driven mode, the loop wakes up on each new sim state instead of
+	// on its own timer
+	const bool event_driven = Ocean1::hasFlag(argc, argv, "--event-driven");
+	const double state_wait_timeout = 0.1;
+
+	// in lockstep mode (simviz_ocean1 --lockstep), the loop is event driven,
+	// computes exactly one tick per sim state and runs on simulated time:
+	// tick n is at n / control_freq, so runs are reproducible
+	const bool lockstep = Ocean1::hasFlag(argc, argv, "--lockstep");
+	uint64_t lockstep_ticks = 0;
+	uint64_t lockstep_state_seq = 0;
+	const auto start_time = chrono::steady_clock::now();
+	unsigned long event_wakeups = 0;
+
+	// with --alloc-guard, count (or abort on) the heap allocations of the
+	// control computations. The redis I/O is not guarded, hiredis allocates
+	// its command buffers.
+	Ocean1::AllocGuard alloc_guard(Ocean1::allocGuardModeFromArgs(argc, argv));
+
+	// per phase timing, compiled in with OCEAN1_ENABLE_PROFILING. kill -USR1
+	// prints the histograms. The controller times its own phases.
+	Ocean1::PhaseProfiler& profiler = controller.profiler();
+	const int phase_tick = profiler.addPhase("tick");
+	const int phase_read_state = profiler.addPhase("read_state");
+	const int phase_publish = profiler.addPhase("publish");
+	Ocean1::PhaseProfiler::installSignalHandler();
+	while (runloop) {
+		double time;
+		if (lockstep) {
+			// on timeout, read the state anyway: the sequence number check
+			// below catches a state whose notification was missed, and the
+			// simulator does not publish again until it gets its torques
+			transport->waitForNewState(state_wait_timeout);
+			time = lockstep_ticks / control_freq;
+		} else if (event_driven) {
+			// the timeout lets the loop notice a stop request
+			if (!transport->waitForNewState(state_wait_timeout)) {
+				continue;
 			}
-		} else if (state == MOTION) {
-            // update body task model
-            //NEW CODE
-            int j = 0;
-            endEffectorPosSum = Vector3d(0, 0, 0);
-            for (auto name : control_links) {
-                endEffectorPosSum += (robot->position(control_links[j], control_points[j]));
-                ++j;
-            }
-            endEffectorPosAverage = endEffectorPosSum / 2.;
-            cout << endEffectorPosAverage.transpose() << endl;
-            j = 0;
-            auto ref_vec = Vector3d(0.9, 0.15, 0.6);
-            for (auto ee_pos : endEffectorPosAverage){
-                if (abs(ee_pos) >= ref_vec[j]){
-                    goalBodyPosition[j] += 0.01 * (ee_pos - ((ee_pos / abs(ee_pos)) * ref_vec[j]));
-                }
-                ++j;
-            }
-            // if (((endEffectorPosAverage).cwiseAbs().array() >= 
-            //     Vector3d(0.2, 0.2, 0.2).array()).any()){
-            //     cout << "here" << endl;
-            // }
-            //Calculate the body position as the end effector location minus some offset
-            leftHandPos = robot->position("endEffector_left", Vector3d(0, 0, 0));
-            rightHandPos = robot->position("endEffector_right", Vector3d(0, 0, 0));
-            handDifference = leftHandPos - rightHandPos; //Get vector between end effectors
-            goalBodyOrientation = calculate_rotations(handDifference, handReference); //Calculate the angle between the reference vector between end effectors and the current one
-            //END NEW CODE
-
-            N_prec.setIdentity();
-			
-            base_task->updateTaskModel(N_prec); //base task is set to identity meaning its highest priority
-            N_prec = base_task->getTaskAndPreviousNullspace(); //Everything that uses N_prec is lower priority
-
-			base_task->setGoalPosition(Vector6d(goalBodyPosition[0], goalBodyPosition[1], goalBodyPosition[2], goalBodyOrientation[2], 0, goalBodyOrientation[0])); 
-
-			file_test << goalBodyPosition[0] << "\t" << goalBodyPosition[1] << "\t" << goalBodyPosition[2] << "\t" << goalBodyOrientation[0] << "\t" << goalBodyOrientation[1] << "\t" << goalBodyOrientation[2] << "\t" << "\n";
-
-            // update pose task models
-            for (auto it = pose_tasks.begin(); it != pose_tasks.end(); ++it) {
-                it->second->updateTaskModel(N_prec); //updates task to be in nullspace of previous tasks??
-                // N_prec = it->second->getTaskAndPreviousNullspace(); //should this be activated?
-            }
-
-            // get pose task Jacobian stack 
-            MatrixXd J_pose_tasks(6 * control_links.size(), robot->dof());
-            for (int i = 0; i < control_links.size(); ++i) {
-                J_pose_tasks.block(6 * i, 0, 6, robot->dof()) = robot->J(control_links[i], control_points[i]);
-            }        
-            N_prec = robot->nullspaceMatrix(J_pose_tasks); 
-                
-            // redundancy completion
-            arms_posture_task->updateTaskModel(N_prec); //updates task to be in null space of previous task
-
-            // -------- set task goals and compute control torques
-            command_torques.setZero(); //set the command torques equal to 0
-
-            // base task
-            command_torques += base_task->computeTorques(); //set the command torques of the base task
-
-
-            // pose tasks
-            int i = 0;
-            for (auto name : control_links) {
-				//Y-Z sinusoidal position
-				//pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0, (-0.2 * cos(M_PI * time)), (0.2 * sin(M_PI * time))));
-
-				//X-Z sinusoidal position
-				//pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d((-0.2 * cos(M_PI * time)), 0, (0.2 * sin(M_PI * time))));
-
-				//X-Y sinusoidal position
-				//pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d((-0.2 * cos(M_PI * time)), (0.2 * sin(M_PI * time)), 0));
-
-				//Yaw rotation
-				// if (name == "endEffector_left") {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0.1, 0, 0));
-				// } else {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(-0.1, 0, 0));
-				// }
-
-				//Roll rotation
-				// if (name == "endEffector_left") {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0, 0, -0.1));
-				// } else {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0, 0, 0.1));
-				// }
-
-				//Yaw sinusoidal rotation
-				// if (name == "endEffector_left") {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d((0.1 * sin(M_PI * time)), 0, 0));
-				// } else {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(-(0.1 * sin(M_PI * time)), 0, 0));
-				// }
-
-				//Roll sinusoidal rotation
-				// if (name == "endEffector_left") {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0, 0, -(0.1 * sin(M_PI * time))));
-				// } else {
-				// 	pose_tasks[name]->setGoalPosition(starting_pose[i].translation() + Vector3d(0, 0, (0.1 * sin(M_PI * time))));
-				// }
-
-			// pose tasks
-			auto diff = haptic_output_left.robot_goal_position - pose_tasks["endEffector_left"]->getCurrentPosition();
-
-			pose_tasks["endEffector_left"]->setGoalPosition(
-				base_task->getCurrentPosition()
-				+ robot->position(control_links[0], control_points[0])
-				// + pose_tasks["endEffector_left"]->getCurrentPosition()
-				+ left_device_base_rotation_in_world * haptic_input_left.device_position * (time - prev_time) * KS
-				// haptic_output_left.robot_current_position - prev_left_goal_position + haptic_output_left.robot_goal_position * (time - prev_time) * KS
-				// curr_haptic_position_left + (haptic_output_left.robot_goal_position - haptic_init_position_left)
-			);
-			command_torques += pose_tasks["endEffector_left"]->computeTorques();
-
-			auto diff_right = haptic_output_right.robot_goal_position - pose_tasks["endEffector_right"]->getCurrentPosition();
-			pose_tasks["endEffector_right"]->setGoalPosition(
-				base_task->getCurrentPosition()
-				+ robot->position(control_links[1], control_points[1])
-				// + haptic_output_right.robot_goal_position
-				// + pose_tasks["endEffector_right"]->getCurrentPosition()
-				+ right_device_base_rotation_in_world * haptic_input_right.device_position * (time - prev_time) * KS
-				// + haptic_input_left.R_world_to_haptic_frame * haptic_input_right.device_position * (time - prev_time) * KS;
-				// pose_tasks["endEffector_right"]->getCurrentPosition() - prev_right_goal_position + haptic_output_right.robot_goal_position * (time - prev_time) * KS
-				// curr_haptic_position_right + (haptic_output_right.robot_goal_position - haptic_init_position_right)
-			);
-			auto curr_haptic_position_left = pose_tasks["endEffector_left"]->getCurrentPosition();
-			auto curr_haptic_position_right = pose_tasks["endEffector_right"]->getCurrentPosition();
-			command_torques += pose_tasks["endEffector_right"]->computeTorques();
-
-			// state machine for button presses
-			if (haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::HOMING) {
-				haptic_controller_left->setHapticControlType(Sai2Primitives::HapticControlType::MOTION_MOTION);
-				haptic_controller_left->setDeviceControlGains(350.0, 15.0);
+			++event_wakeups;
+			time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		} else {
+			timer.waitForNextLoop();
+			time = timer.elapsedSimTime();
+		}
+		// the previous tick is over, including the destruction of its timers
+		OCEAN1_PROFILE_END_TICK(profiler);
+		profiler.printInfoIfRequested(cout);
+		OCEAN1_PROFILE_SCOPE(profiler, phase_tick);
+
+		// update robot and read haptic device state in the same batch. A
+		// simulator that died in the middle of a publication leaves no
+		// state to compute a tick from.
+		{
+			OCEAN1_PROFILE_SCOPE(profiler, phase_read_state);
+			if (!transport->readState(sim_state)) {
+				continue;
 			}
-
-			if (haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::HOMING) {
-				haptic_controller_right->setHapticControlType(Sai2Primitives::HapticControlType::MOTION_MOTION);
-				haptic_controller_right->setDeviceControlGains(350.0, 15.0);
+			if (haptic_io_client) {
+				haptic_io_client->receiveAllFromGroup(Ocean1::SIM_STATE_GROUP);
 			}
-			// clutch
-			if (haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::MOTION_MOTION && haptic_button_is_pressed && !haptic_button_was_pressed) {
-				haptic_controller_left->setHapticControlType(
-					Sai2Primitives::HapticControlType::CLUTCH
-				);
-			} else if (haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::CLUTCH && !haptic_button_is_pressed && haptic_button_was_pressed) {
-				haptic_controller_left->setHapticControlType(
-					Sai2Primitives::HapticControlType::MOTION_MOTION
-				);
+		}
+		if (lockstep) {
+			// a wake up can find the state the previous tick already used
+			if (sim_state.stamp.seq == lockstep_state_seq) {
+				continue;
 			}
-			if (haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::MOTION_MOTION && haptic_button_is_pressed && !haptic_button_was_pressed) {
-				haptic_controller_right->setHapticControlType(
-					Sai2Primitives::HapticControlType::CLUTCH
-				);
-			} else if (haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::CLUTCH && !haptic_button_is_pressed && haptic_button_was_pressed) {
-				haptic_controller_right->setHapticControlType(
-					Sai2Primitives::HapticControlType::MOTION_MOTION
-				);
+			lockstep_state_seq = sim_state.stamp.seq;
+			++lockstep_ticks;
+		}
+
+		if (alloc_guard.enabled()) {
+			alloc_guard.start();
+		}
+		command_torques = controller.step(sim_state, time);
+		if (alloc_guard.enabled()) {
+			alloc_guard.stop();
+		}
+
+		// execute redis write callback, haptic commands go in the same batch
+		{
+			OCEAN1_PROFILE_SCOPE(profiler, phase_publish);
+			if (haptic_io_client) {
+				haptic_io_client->sendAllFromGroup(Ocean1::SIM_COMMAND_GROUP);
 			}
-
-			// posture task and coriolis compensation
-			command_torques += arms_posture_task->computeTorques() + robot->coriolisForce();
-        }
-		// execute redis write callback
-		redis_client.setEigen(JOINT_TORQUES_COMMANDED_KEY, command_torques);
-		prev_time = time;
-		prev_left_goal_position = haptic_output_left.robot_goal_position;
-		prev_right_goal_position = haptic_output_right.robot_goal_position;
-	}
+			transport->publishTorques(command_torques, sim_state.stamp);
+			if (controller.inMotion()) {
+				if (auto* record = telemetry.beginRecord(goal_body_stream, time)) {
+					record->append(controller.goalBodyPosition());
+					record->append(controller.goalBodyOrientation());
+					telemetry.commitRecord();
+				}
+			}
+			if (auto* record = telemetry.beginRecord(command_stream, time)) {
+				record->append(sim_state.stamp.seq);
+				record->append(command_torques);
+				telemetry.commitRecord();
+			}
+		}
 	}
 	timer.stop();
-	cout << "\nSimulation loop timer stats:\n";
-	timer.printInfoPostRun();
-	redis_client.setEigen(JOINT_TORQUES_COMMANDED_KEY, 0 * command_torques);  // back to floating
+	if (lockstep) {
+		cout << "\nLockstep ticks: " << lockstep_ticks << "\n";
+	} else if (event_driven) {
+		const double run_time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		cout << "\nEvent driven loop stats:\n";
+		cout << "wake ups: " << event_wakeups << ", average rate: " << event_wakeups / run_time << " Hz\n";
+	} else {
+		cout << "\nSimulation loop timer stats:\n";
+		timer.printInfoPostRun();
+	}
+	OCEAN1_PROFILE_END_TICK(profiler);
+	cout << "\nController phase stats:\n";
+	profiler.printInfo(cout);
+	if (alloc_guard.enabled()) {
+		cout << "\nAllocation guard stats:\n";
+		alloc_guard.printInfoPostRun();
+	}
+	telemetry.stop();
+	telemetry.printInfoPostRun();
+	transport->publishTorques(0 * command_torques, sim_state.stamp);  // back to floating
     redis_client.setEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 0),
 						  Vector3d::Zero());
 	redis_client.setEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_FORCE_KEY_SUFFIX, 1),
@@ -529,6 +294,6 @@ int main() {
     redis_client.setEigen(Sai2Common::ChaiHapticDriverKeys::createRedisKey(COMMANDED_TORQUE_KEY_SUFFIX, 0),
 						  Vector3d::Zero());
 	redis_client.setInt(Sai2Common::ChaiHapticDriverKeys::createRedisKey(USE_GRIPPER_AS_SWITCH_KEY_SUFFIX, 0), 0);
-	
+
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,325 @@
+/**
+ * @file controller_core.h
+ * @brief Operational space controller of ocean1 with compile time sizes.
+ * Implements the task hierarchy of the MOTION state of controller.cpp (base
+ * joint task, end effector pose tasks in its nullspace, arm posture task in
+ * the nullspace of the pose tasks) with fixed size Eigen types, so that Eigen
+ * can unroll and vectorize the products and nothing is allocated.
+ *
+ */
+
+#ifndef OCEAN1_CONTROLLER_CORE_H
+#define OCEAN1_CONTROLLER_CORE_H
+
+#include <Eigen/Dense>
+#include <array>
+
+#include "tree_kernels.h"
+
+namespace Ocean1 {
+
+/**
+ * @brief Pseudo inverse of a symmetric positive semi definite matrix, the
+ * eigenvalues below tolerance times the largest one are dropped
+ *
+ * @param A matrix to invert
+ * @param solver eigen solver, kept by the caller so that its storage is reused
+ * @param out pseudo inverse of A
+ */
+template <int N>
+void pseudoInverseSymmetric(
+	const Eigen::Matrix<double, N, N>& A,
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, N, N>>& solver,
+	Eigen::Matrix<double, N, N>& out, const double tolerance = 1e-6) {
+	solver.compute(A);
+	const auto& eigenvalues = solver.eigenvalues();
+	const double threshold = tolerance * eigenvalues.maxCoeff();
+	Eigen::Matrix<double, N, 1> inverse_eigenvalues;
+	for (int i = 0; i < N; ++i) {
+		inverse_eigenvalues(i) =
+			eigenvalues(i) > threshold ? 1.0 / eigenvalues(i) : 0.0;
+	}
+	out.noalias() = solver.eigenvectors() *
+					inverse_eigenvalues.asDiagonal() *
+					solver.eigenvectors().transpose();
+}
+
+/**
+ * @brief Inverse of a symmetric positive definite matrix with a Cholesky
+ * factorization, falling back to the pseudo inverse if it is singular
+ */
+template <int N>
+void inverseSymmetric(
+	const Eigen::Matrix<double, N, N>& A,
+	Eigen::LLT<Eigen::Matrix<double, N, N>>& llt,
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, N, N>>& solver,
+	Eigen::Matrix<double, N, N>& out) {
+	llt.compute(A);
+	if (llt.info() != Eigen::Success) {
+		pseudoInverseSymmetric(A, solver, out);
+		return;
+	}
+	out.setIdentity();
+	llt.solveInPlace(out);
+}
+
+/**
+ * @brief orientation error of Sai2Model::orientationError, the rotation
+ * vector from the desired to the current orientation for small errors
+ */
+inline Eigen::Vector3d orientationError(const Eigen::Matrix3d& desired,
+										const Eigen::Matrix3d& current) {
+	return -0.5 * (current.col(0).cross(desired.col(0)) +
+				   current.col(1).cross(desired.col(1)) +
+				   current.col(2).cross(desired.col(2)));
+}
+
+/**
+ * @brief Fixed size controller core
+ *
+ * @tparam DOF number of joints of the robot
+ * @tparam BASE_DOF number of base joints, the first joints of the robot. The
+ * remaining joints are the arm joints.
+ * @tparam NUM_EE number of end effectors controlled in position and
+ * orientation
+ */
+template <int DOF, int BASE_DOF, int NUM_EE>
+class ControllerCore {
+public:
+	static constexpr int ARM_DOF = DOF - BASE_DOF;
+	static constexpr int POSE_TASKS_DOF = 6 * NUM_EE;
+	// joints of the arm of each end effector, when the robot is a tree (see
+	// block_sparse)
+	static constexpr int CHAIN_DOF = ARM_DOF / NUM_EE;
+	using Tree = TreeKernels<BASE_DOF, CHAIN_DOF, NUM_EE>;
+
+	using VectorDof = Eigen::Matrix<double, DOF, 1>;
+	using MatrixDof = Eigen::Matrix<double, DOF, DOF>;
+	using VectorBase = Eigen::Matrix<double, BASE_DOF, 1>;
+	using VectorArm = Eigen::Matrix<double, ARM_DOF, 1>;
+	using Vector6d = Eigen::Matrix<double, 6, 1>;
+	using Jacobian = Eigen::Matrix<double, 6, DOF>;
+
+	struct Gains {
+		double kp = 400.0;
+		double kv = 40.0;
+	};
+
+	/**
+	 * @brief Model inputs and goal of an end effector task. The Jacobian
+	 * stacks the linear and angular parts, in the robot base frame like the
+	 * position and rotation.
+	 */
+	struct EndEffector {
+		Jacobian J = Jacobian::Zero();
+		Eigen::Vector3d position = Eigen::Vector3d::Zero();
+		Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+		Eigen::Vector3d goal_position = Eigen::Vector3d::Zero();
+		Eigen::Matrix3d goal_rotation = Eigen::Matrix3d::Identity();
+	};
+
+	ControllerCore() {
+		q.setZero();
+		dq.setZero();
+		M_inv.setIdentity();
+		coriolis.setZero();
+		base_goal.setZero();
+		arm_goal.setZero();
+		_torques.setZero();
+	}
+
+	// model inputs, to be updated before computeTorques
+	VectorDof q;
+	VectorDof dq;
+	MatrixDof M_inv;
+	VectorDof coriolis;
+	std::array<EndEffector, NUM_EE> end_effectors;
+
+	// goals of the joint tasks
+	VectorBase base_goal;
+	VectorArm arm_goal;
+
+	Gains base_gains;
+	Gains pose_position_gains;
+	Gains pose_orientation_gains;
+	Gains arm_gains;
+
+	/**
+	 * @brief use the block sparse kernels of tree_kernels.h for the pose
+	 * tasks and their nullspace. Only valid if each end effector is at the
+	 * end of its own arm of CHAIN_DOF joints, in end effector order after
+	 * the base joints, which Tree::hasTreeStructure checks on the stacked
+	 * Jacobians.
+	 */
+	bool block_sparse = false;
+
+	/**
+	 * @brief set all the goals to the current configuration, like
+	 * reInitializeTask of the Sai2Primitives tasks
+	 */
+	void reInitialize() {
+		base_goal = q.template head<BASE_DOF>();
+		arm_goal = q.template tail<ARM_DOF>();
+		for (auto& ee : end_effectors) {
+			ee.goal_position = ee.position;
+			ee.goal_rotation = ee.rotation;
+		}
+	}
+
+	VectorBase baseCurrentPosition() const {
+		return q.template head<BASE_DOF>();
+	}
+
+	/**
+	 * @brief compute the joint torques of the task hierarchy, including the
+	 * coriolis compensation
+	 */
+	const VectorDof& computeTorques() {
+		// base task, highest priority. Its Jacobian selects the first joints,
+		// so its inverse inertia is a block of the inverse mass matrix
+		_Lambda_base_inv = M_inv.template topLeftCorner<BASE_DOF, BASE_DOF>();
+		inverseSymmetric(_Lambda_base_inv, _llt_base, _solver_base,
+						 _Lambda_base);
+		_F_base.noalias() =
+			_Lambda_base *
+			(-base_gains.kp * (q.template head<BASE_DOF>() - base_goal) -
+			 base_gains.kv * dq.template head<BASE_DOF>());
+		_torques.setZero();
+		_torques.template head<BASE_DOF>() = _F_base;
+
+		// nullspace of the base task N = I - Jbar J
+		_Jbar_base.noalias() =
+			M_inv.template leftCols<BASE_DOF>() * _Lambda_base;
+		_N_base.setIdentity();
+		_N_base.template leftCols<BASE_DOF>() -= _Jbar_base;
+
+		// pose tasks, in the nullspace of the base task
+		for (int i = 0; i < NUM_EE; ++i) {
+			const auto& ee = end_effectors[i];
+			if (block_sparse) {
+				// J N_base only changes the base columns of J, and keeps its
+				// zero columns
+				const int chain_start = Tree::chainStart(i);
+				_J_projected = ee.J;
+				_J_projected.template leftCols<BASE_DOF>().noalias() -=
+					ee.J.template leftCols<BASE_DOF>() *
+					_Jbar_base.template topRows<BASE_DOF>();
+				_J_projected.template leftCols<BASE_DOF>().noalias() -=
+					ee.J.template middleCols<CHAIN_DOF>(chain_start) *
+					_Jbar_base.template middleRows<CHAIN_DOF>(chain_start);
+				Tree::taskMInvJt(i, _J_projected, M_inv, _M_inv_Jt);
+				Tree::taskLambdaInv(i, _J_projected, _M_inv_Jt,
+									_Lambda_pose_inv);
+			} else {
+				_J_projected.noalias() = ee.J * _N_base;
+				_M_inv_Jt.noalias() = M_inv * _J_projected.transpose();
+				_Lambda_pose_inv.noalias() = _J_projected * _M_inv_Jt;
+			}
+			inverseSymmetric(_Lambda_pose_inv, _llt_pose, _solver_pose,
+							 _Lambda_pose);
+			_velocity.noalias() = ee.J * dq;
+			_unit_mass_force.template head<3>() =
+				-pose_position_gains.kp * (ee.position - ee.goal_position) -
+				pose_position_gains.kv * _velocity.template head<3>();
+			_unit_mass_force.template tail<3>() =
+				-pose_orientation_gains.kp *
+					orientationError(ee.goal_rotation, ee.rotation) -
+				pose_orientation_gains.kv * _velocity.template tail<3>();
+			_F_pose.noalias() = _Lambda_pose * _unit_mass_force;
+			_torques.noalias() += _J_projected.transpose() * _F_pose;
+
+			_J_pose_tasks.template middleRows<6>(6 * i) = ee.J;
+		}
+
+		// dynamically consistent nullspace of the stacked pose tasks
+		if (block_sparse) {
+			Tree::MInvJt(_J_pose_tasks, M_inv, _M_inv_Jt_stack);
+			Tree::lambdaInv(_J_pose_tasks, _M_inv_Jt_stack, _Lambda_stack_inv);
+			bool inverted = false;
+			if constexpr (NUM_EE == 2) {
+				inverted = Tree::lambda(_Lambda_stack_inv, _lambda_workspace,
+										_Lambda_stack);
+			}
+			if (!inverted) {
+				inverseSymmetric(_Lambda_stack_inv, _llt_stack, _solver_stack,
+								 _Lambda_stack);
+			}
+			_Jbar_stack.noalias() = _M_inv_Jt_stack * _Lambda_stack;
+			Tree::nullspace(_J_pose_tasks, _Jbar_stack, _N_pose);
+		} else {
+			_M_inv_Jt_stack.noalias() = M_inv * _J_pose_tasks.transpose();
+			_Lambda_stack_inv.noalias() = _J_pose_tasks * _M_inv_Jt_stack;
+			inverseSymmetric(_Lambda_stack_inv, _llt_stack, _solver_stack,
+							 _Lambda_stack);
+			_N_pose.setIdentity();
+			_N_pose.noalias() -=
+				_M_inv_Jt_stack * (_Lambda_stack * _J_pose_tasks);
+		}
+
+		// arm posture task, in the nullspace of the pose tasks. It has more
+		// joints than the nullspace has directions, so its inertia is
+		// singular
+		_J_arm_projected = _N_pose.template bottomRows<ARM_DOF>();
+		_M_inv_Jt_arm.noalias() = M_inv * _J_arm_projected.transpose();
+		_Lambda_arm_inv.noalias() = _J_arm_projected * _M_inv_Jt_arm;
+		pseudoInverseSymmetric(_Lambda_arm_inv, _solver_arm, _Lambda_arm);
+		_F_arm.noalias() =
+			_Lambda_arm *
+			(-arm_gains.kp * (q.template tail<ARM_DOF>() - arm_goal) -
+			 arm_gains.kv * dq.template tail<ARM_DOF>());
+		_torques.noalias() += _J_arm_projected.transpose() * _F_arm;
+
+		_torques += coriolis;
+		return _torques;
+	}
+
+private:
+	VectorDof _torques;
+	Vector6d _velocity;
+	Vector6d _unit_mass_force;
+
+	// base task
+	Eigen::Matrix<double, BASE_DOF, BASE_DOF> _Lambda_base_inv;
+	Eigen::Matrix<double, BASE_DOF, BASE_DOF> _Lambda_base;
+	Eigen::LLT<Eigen::Matrix<double, BASE_DOF, BASE_DOF>> _llt_base;
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, BASE_DOF, BASE_DOF>>
+		_solver_base;
+	Eigen::Matrix<double, DOF, BASE_DOF> _Jbar_base;
+	VectorBase _F_base;
+	MatrixDof _N_base;
+
+	// pose tasks
+	Jacobian _J_projected;
+	Eigen::Matrix<double, DOF, 6> _M_inv_Jt;
+	Eigen::Matrix<double, 6, 6> _Lambda_pose_inv;
+	Eigen::Matrix<double, 6, 6> _Lambda_pose;
+	Eigen::LLT<Eigen::Matrix<double, 6, 6>> _llt_pose;
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> _solver_pose;
+	Vector6d _F_pose;
+
+	// stacked pose tasks
+	Eigen::Matrix<double, POSE_TASKS_DOF, DOF> _J_pose_tasks;
+	Eigen::Matrix<double, DOF, POSE_TASKS_DOF> _M_inv_Jt_stack;
+	Eigen::Matrix<double, POSE_TASKS_DOF, POSE_TASKS_DOF> _Lambda_stack_inv;
+	Eigen::Matrix<double, POSE_TASKS_DOF, POSE_TASKS_DOF> _Lambda_stack;
+	Eigen::LLT<Eigen::Matrix<double, POSE_TASKS_DOF, POSE_TASKS_DOF>> _llt_stack;
+	Eigen::SelfAdjointEigenSolver<
+		Eigen::Matrix<double, POSE_TASKS_DOF, POSE_TASKS_DOF>>
+		_solver_stack;
+	typename Tree::LambdaWorkspace _lambda_workspace;
+	Eigen::Matrix<double, DOF, POSE_TASKS_DOF> _Jbar_stack;
+	MatrixDof _N_pose;
+
+	// arm posture task
+	Eigen::Matrix<double, ARM_DOF, DOF> _J_arm_projected;
+	Eigen::Matrix<double, DOF, ARM_DOF> _M_inv_Jt_arm;
+	Eigen::Matrix<double, ARM_DOF, ARM_DOF> _Lambda_arm_inv;
+	Eigen::Matrix<double, ARM_DOF, ARM_DOF> _Lambda_arm;
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, ARM_DOF, ARM_DOF>>
+		_solver_arm;
+	VectorArm _F_arm;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_CONTROLLER_CORE_H
@@ -0,0 +1,40 @@
+/**
+ * @file controller_plugin.cpp
+ * @brief Loading of the controller plugin libraries
+ *
+ */
+
+#include "controller_plugin.h"
+
+#include <dlfcn.h>
+
+#include <stdexcept>
+
+namespace Ocean1 {
+
+ControllerPluginLibrary::ControllerPluginLibrary(const std::string& path)
+	: _handle(nullptr), _create(nullptr) {
+	// RTLD_LOCAL keeps the symbols of the plugin, and of the static libraries
+	// it embeds, from clashing with the ones of the host
+	_handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!_handle) {
+		throw std::runtime_error("could not load controller plugin " + path +
+								 ": " + dlerror());
+	}
+	_create = reinterpret_cast<CreateControllerPluginFunction>(
+		dlsym(_handle, CREATE_CONTROLLER_PLUGIN_SYMBOL.c_str()));
+	if (!_create) {
+		dlclose(_handle);
+		throw std::runtime_error("controller plugin " + path +
+								 " does not export " +
+								 CREATE_CONTROLLER_PLUGIN_SYMBOL);
+	}
+}
+
+ControllerPluginLibrary::~ControllerPluginLibrary() { dlclose(_handle); }
+
+std::unique_ptr<ControllerPlugin> ControllerPluginLibrary::create() {
+	return std::unique_ptr<ControllerPlugin>(_create());
+}
+
+}  // namespace Ocean1
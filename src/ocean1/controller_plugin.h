@@ -0,0 +1,84 @@
+/**
+ * @file controller_plugin.h
+ * @brief Interface of a controller built as a shared library, so that
+ * simviz_ocean1 can load it and run it in its simulation thread without any
+ * inter process communication
+ *
+ */
+
+#ifndef OCEAN1_CONTROLLER_PLUGIN_H
+#define OCEAN1_CONTROLLER_PLUGIN_H
+
+#include <Eigen/Dense>
+#include <memory>
+#include <string>
+
+#include "sim_transport.h"
+
+namespace Sai2Model {
+class Sai2Model;
+}
+
+namespace Ocean1 {
+
+class ControllerPlugin {
+public:
+	virtual ~ControllerPlugin() = default;
+
+	/**
+	 * @brief set up the tasks
+	 *
+	 * @param robot model of the controlled robot, with the initial state set
+	 * and updated. The controller keeps it and updates it at each step.
+	 */
+	virtual void init(std::shared_ptr<Sai2Model::Sai2Model> robot) = 0;
+
+	/**
+	 * @brief compute one control tick
+	 *
+	 * @param state sim state of the tick
+	 * @param time time of the tick in seconds
+	 * @return joint torques to apply, valid until the next call
+	 */
+	virtual const Eigen::VectorXd& step(const SimState& state,
+										double time) = 0;
+};
+
+// name of the function the plugin libraries export, with the signature of
+// CreateControllerPluginFunction. It returns a new plugin, to be deleted
+// before the library is unloaded.
+const std::string CREATE_CONTROLLER_PLUGIN_SYMBOL =
+	"ocean1CreateControllerPlugin";
+extern "C" {
+typedef ControllerPlugin* (*CreateControllerPluginFunction)();
+}
+
+/**
+ * @brief RAII handle on a plugin library loaded with dlopen
+ *
+ */
+class ControllerPluginLibrary {
+public:
+	/**
+	 * @brief load the library, throws if it cannot be loaded or does not
+	 * export CREATE_CONTROLLER_PLUGIN_SYMBOL
+	 */
+	explicit ControllerPluginLibrary(const std::string& path);
+	~ControllerPluginLibrary();
+
+	ControllerPluginLibrary(const ControllerPluginLibrary&) = delete;
+	ControllerPluginLibrary& operator=(const ControllerPluginLibrary&) = delete;
+
+	/**
+	 * @brief create a controller. It must be destroyed before the library.
+	 */
+	std::unique_ptr<ControllerPlugin> create();
+
+private:
+	void* _handle;
+	CreateControllerPluginFunction _create;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_CONTROLLER_PLUGIN_H
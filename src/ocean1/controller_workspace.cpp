@@ -0,0 +1,65 @@
+/**
+ * @file controller_workspace.cpp
+ * @brief Preallocated buffers of the controller tick
+ *
+ */
+
+#include "controller_workspace.h"
+
+namespace Ocean1 {
+
+namespace {
+
+// eigenvalues of a singular Lambda^-1 below this fraction of the largest one
+// are dropped
+const double PSEUDO_INVERSE_TOLERANCE = 1e-6;
+
+}  // namespace
+
+void NullspaceWorkspace::resize(int task_dof, int dof) {
+	_M_inv_Jt.setZero(dof, task_dof);
+	_Lambda_inv.setZero(task_dof, task_dof);
+	_Jbar_t.setZero(task_dof, dof);
+	// the factorization keeps its storage when recomputed with the same size
+	_llt.compute(Eigen::MatrixXd::Identity(task_dof, task_dof));
+	_solver = Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>(task_dof);
+	_inverse_eigenvalues.setZero(task_dof);
+	_projected.setZero(task_dof, dof);
+}
+
+void NullspaceWorkspace::compute(const Eigen::MatrixXd& J,
+								 const Eigen::MatrixXd& M_inv,
+								 Eigen::MatrixXd& N) {
+	_M_inv_Jt.noalias() = M_inv * J.transpose();
+	_Lambda_inv.noalias() = J * _M_inv_Jt;
+	_llt.compute(_Lambda_inv);
+	if (_llt.info() == Eigen::Success) {
+		// Jbar^T = Lambda * J * M^-1, solved in place
+		_Jbar_t = _M_inv_Jt.transpose();
+		_llt.solveInPlace(_Jbar_t);
+	} else {
+		// singular task, Lambda is the pseudo inverse of Lambda^-1 as in
+		// pseudoInverseSymmetric
+		_solver.compute(_Lambda_inv);
+		const auto& eigenvalues = _solver.eigenvalues();
+		const double threshold =
+			PSEUDO_INVERSE_TOLERANCE * eigenvalues.maxCoeff();
+		for (int i = 0; i < eigenvalues.size(); ++i) {
+			_inverse_eigenvalues(i) =
+				eigenvalues(i) > threshold ? 1.0 / eigenvalues(i) : 0.0;
+		}
+		_projected.noalias() =
+			_solver.eigenvectors().transpose() * _M_inv_Jt.transpose();
+		_projected = _inverse_eigenvalues.asDiagonal() * _projected;
+		_Jbar_t.noalias() = _solver.eigenvectors() * _projected;
+	}
+	N.setIdentity();
+	N.noalias() -= _Jbar_t.transpose() * J;
+}
+
+ControllerWorkspace::ControllerWorkspace(int num_pose_tasks, int dof)
+	: J_pose_tasks(Eigen::MatrixXd::Zero(6 * num_pose_tasks, dof)) {
+	nullspace.resize(6 * num_pose_tasks, dof);
+}
+
+}  // namespace Ocean1
@@ -0,0 +1,123 @@
+/**
+ * @file controller_workspace.h
+ * @brief Buffers of the controller tick, sized once at startup so that the
+ * tick itself does not allocate
+ *
+ */
+
+#ifndef OCEAN1_CONTROLLER_WORKSPACE_H
+#define OCEAN1_CONTROLLER_WORKSPACE_H
+
+#include <Eigen/Dense>
+
+#include "tree_kernels.h"
+
+namespace Ocean1 {
+
+/**
+ * @brief Dynamically consistent nullspace of a task Jacobian, computed into
+ * preallocated matrices. Gives the same result as
+ * Sai2Model::nullspaceMatrix, which returns a new matrix at each call. A
+ * singular J M^-1 J^T (arm singularity, degenerate task) is inverted with a
+ * pseudo inverse.
+ *
+ */
+class NullspaceWorkspace {
+public:
+	NullspaceWorkspace() = default;
+
+	/**
+	 * @brief size the buffers
+	 *
+	 * @param task_dof number of rows of the task Jacobian
+	 * @param dof number of joints of the robot
+	 */
+	void resize(int task_dof, int dof);
+
+	/**
+	 * @brief N = I - Jbar * J with Jbar = M^-1 J^T (J M^-1 J^T)^-1
+	 *
+	 * @param J task Jacobian, task_dof x dof
+	 * @param M_inv inverse of the joint space mass matrix
+	 * @param N output, dof x dof
+	 */
+	void compute(const Eigen::MatrixXd& J, const Eigen::MatrixXd& M_inv,
+				 Eigen::MatrixXd& N);
+
+private:
+	Eigen::MatrixXd _M_inv_Jt;
+	Eigen::MatrixXd _Lambda_inv;
+	Eigen::MatrixXd _Jbar_t;
+	Eigen::LLT<Eigen::MatrixXd> _llt;
+	// fallback for a singular task
+	Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> _solver;
+	Eigen::VectorXd _inverse_eigenvalues;
+	Eigen::MatrixXd _projected;
+};
+
+/**
+ * @brief Same nullspace for the stacked end effector Jacobian of a kinematic
+ * tree (see tree_kernels.h), with its block sparse kernels. The inputs are
+ * copied to fixed size matrices, on which the kernels are unrolled.
+ *
+ */
+template <int BASE_DOF, int CHAIN_DOF, int NUM_CHAINS>
+class TreeNullspaceWorkspace {
+public:
+	using Tree = TreeKernels<BASE_DOF, CHAIN_DOF, NUM_CHAINS>;
+
+	/**
+	 * @brief N = I - Jbar * J, as NullspaceWorkspace::compute
+	 *
+	 * @param J stacked Jacobian, with Tree::hasTreeStructure
+	 * @return false, with N unchanged, if J M^-1 J^T is singular
+	 */
+	bool compute(const Eigen::MatrixXd& J, const Eigen::MatrixXd& M_inv,
+				 Eigen::MatrixXd& N) {
+		_J = J;
+		_M_inv = M_inv;
+		Tree::MInvJt(_J, _M_inv, _M_inv_Jt);
+		Tree::lambdaInv(_J, _M_inv_Jt, _Lambda_inv);
+		if (!Tree::lambda(_Lambda_inv, _lambda_workspace, _Lambda)) {
+			return false;
+		}
+		_Jbar.noalias() = _M_inv_Jt * _Lambda;
+		Tree::nullspace(_J, _Jbar, _N);
+		N = _N;
+		return true;
+	}
+
+private:
+	Eigen::Matrix<double, Tree::TASK_DOF, Tree::DOF> _J;
+	Eigen::Matrix<double, Tree::DOF, Tree::DOF> _M_inv;
+	Eigen::Matrix<double, Tree::DOF, Tree::TASK_DOF> _M_inv_Jt;
+	Eigen::Matrix<double, Tree::TASK_DOF, Tree::TASK_DOF> _Lambda_inv;
+	Eigen::Matrix<double, Tree::TASK_DOF, Tree::TASK_DOF> _Lambda;
+	typename Tree::LambdaWorkspace _lambda_workspace;
+	Eigen::Matrix<double, Tree::DOF, Tree::TASK_DOF> _Jbar;
+	Eigen::Matrix<double, Tree::DOF, Tree::DOF> _N;
+};
+
+/**
+ * @brief Per tick buffers of controller_ocean1
+ *
+ */
+struct ControllerWorkspace {
+	/**
+	 * @param num_pose_tasks number of 6 dof end effector tasks
+	 * @param dof number of joints of the robot
+	 */
+	ControllerWorkspace(int num_pose_tasks, int dof);
+
+	// stacked Jacobian of the pose tasks
+	Eigen::MatrixXd J_pose_tasks;
+	NullspaceWorkspace nullspace;
+	// ocean1: 6 base joints and two 7 joint arms, used when J_pose_tasks has
+	// that structure
+	TreeNullspaceWorkspace<6, 7, 2> tree_nullspace;
+	bool tree_structure = false;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_CONTROLLER_WORKSPACE_H
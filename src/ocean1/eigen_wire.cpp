@@ -0,0 +1,179 @@
+/**
+ * @file eigen_wire.cpp
+ * @brief Binary encoding of Eigen matrices
+ *
+ */
+
+#include "eigen_wire.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace Ocean1 {
+
+namespace {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool HOST_IS_LITTLE_ENDIAN = false;
+#else
+constexpr bool HOST_IS_LITTLE_ENDIAN = true;
+#endif
+
+template <typename T>
+void storeLE(char* dst, T value) {
+	std::memcpy(dst, &value, sizeof(T));
+	if (!HOST_IS_LITTLE_ENDIAN) {
+		for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+			std::swap(dst[i], dst[sizeof(T) - 1 - i]);
+		}
+	}
+}
+
+template <typename T>
+T loadLE(const char* src) {
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, src, sizeof(T));
+	if (!HOST_IS_LITTLE_ENDIAN) {
+		for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+			std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+		}
+	}
+	T value;
+	std::memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+}  // namespace
+
+bool isEigenWire(const char* data, size_t len) {
+	return len >= EIGEN_WIRE_HEADER_SIZE &&
+		   loadLE<uint32_t>(data) == EIGEN_WIRE_MAGIC;
+}
+
+void encodeEigenWire(const Eigen::Ref<const Eigen::MatrixXd>& matrix,
+					 uint64_t seq, std::string& buffer) {
+	const int rows = matrix.rows();
+	const int cols = matrix.cols();
+	buffer.resize(eigenWireSize(rows, cols));
+	char* dst = &buffer[0];
+
+	storeLE<uint32_t>(dst, EIGEN_WIRE_MAGIC);
+	storeLE<uint8_t>(dst + 4, EIGEN_WIRE_VERSION);
+	storeLE<uint8_t>(dst + 5, EIGEN_WIRE_DTYPE_FLOAT64);
+	storeLE<uint16_t>(dst + 6, 0);
+	storeLE<uint32_t>(dst + 8, rows);
+	storeLE<uint32_t>(dst + 12, cols);
+	storeLE<uint64_t>(dst + 16, seq);
+
+	dst += EIGEN_WIRE_HEADER_SIZE;
+	if (HOST_IS_LITTLE_ENDIAN && matrix.outerStride() == rows) {
+		std::memcpy(dst, matrix.data(), sizeof(double) * rows * cols);
+		return;
+	}
+	for (int j = 0; j < cols; ++j) {
+		for (int i = 0; i < rows; ++i) {
+			storeLE<double>(dst, matrix(i, j));
+			dst += sizeof(double);
+		}
+	}
+}
+
+bool decodeEigenWireHeader(const char* data, size_t len,
+						   EigenWireHeader& header) {
+	if (!isEigenWire(data, len)) {
+		return false;
+	}
+	header.version = loadLE<uint8_t>(data + 4);
+	header.dtype = loadLE<uint8_t>(data + 5);
+	header.rows = loadLE<uint32_t>(data + 8);
+	header.cols = loadLE<uint32_t>(data + 12);
+	header.seq = loadLE<uint64_t>(data + 16);
+	return header.version == EIGEN_WIRE_VERSION &&
+		   header.dtype == EIGEN_WIRE_DTYPE_FLOAT64 &&
+		   len == eigenWireSize(header.rows, header.cols);
+}
+
+bool decodeEigenWire(const char* data, size_t len,
+					 Eigen::Ref<Eigen::MatrixXd> out, uint64_t* seq) {
+	EigenWireHeader header;
+	if (!decodeEigenWireHeader(data, len, header) ||
+		header.rows != (uint32_t)out.rows() ||
+		header.cols != (uint32_t)out.cols()) {
+		return false;
+	}
+	if (seq) {
+		*seq = header.seq;
+	}
+
+	const char* src = data + EIGEN_WIRE_HEADER_SIZE;
+	if (HOST_IS_LITTLE_ENDIAN && out.outerStride() == out.rows()) {
+		std::memcpy(out.data(), src, sizeof(double) * header.rows * header.cols);
+		return true;
+	}
+	for (int j = 0; j < out.cols(); ++j) {
+		for (int i = 0; i < out.rows(); ++i) {
+			out(i, j) = loadLE<double>(src);
+			src += sizeof(double);
+		}
+	}
+	return true;
+}
+
+void encodeEigenText(const Eigen::Ref<const Eigen::MatrixXd>& matrix,
+					 std::string& buffer) {
+	// worst case of a %.17g double is 24 characters, plus separators
+	const bool is_vector = matrix.cols() == 1;
+	buffer.resize(4 + matrix.size() * 26 + matrix.rows() * 3);
+	char* dst = &buffer[0];
+	char* const begin = dst;
+	*dst++ = '[';
+	for (int i = 0; i < matrix.rows(); ++i) {
+		if (i > 0) {
+			*dst++ = ',';
+		}
+		if (!is_vector) {
+			*dst++ = '[';
+		}
+		for (int j = 0; j < matrix.cols(); ++j) {
+			if (j > 0) {
+				*dst++ = ',';
+			}
+			dst += std::snprintf(dst, 25, "%.17g", matrix(i, j));
+		}
+		if (!is_vector) {
+			*dst++ = ']';
+		}
+	}
+	*dst++ = ']';
+	buffer.resize(dst - begin);
+}
+
+bool decodeEigenText(const char* data, size_t len,
+					 Eigen::Ref<Eigen::MatrixXd> out) {
+	// values are stored row by row, brackets, commas and whitespace are
+	// separators. The reply buffer of hiredis is null terminated, which
+	// strtod relies on.
+	const char* p = data;
+	const char* const end = data + len;
+	int n = 0;
+	while (p < end) {
+		if (*p == '[' || *p == ']' || *p == ',' || *p == ' ' || *p == '\t' ||
+			*p == '\n' || *p == ';') {
+			++p;
+			continue;
+		}
+		char* next;
+		const double value = std::strtod(p, &next);
+		if (next == p || n >= out.size()) {
+			return false;
+		}
+		out(n / out.cols(), n % out.cols()) = value;
+		++n;
+		p = next;
+	}
+	return n == out.size();
+}
+
+}  // namespace Ocean1
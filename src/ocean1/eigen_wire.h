@@ -0,0 +1,99 @@
+/**
+ * @file eigen_wire.h
+ * @brief Compact binary encoding of Eigen matrices for the hot redis keys,
+ * and allocation free helpers for the RedisClient text format.
+ *
+ * Layout (all fields little endian):
+ *   uint32 magic | uint8 version | uint8 dtype | uint16 reserved |
+ *   uint32 rows | uint32 cols | uint64 seq | rows * cols float64 (col major)
+ *
+ */
+
+#ifndef OCEAN1_EIGEN_WIRE_H
+#define OCEAN1_EIGEN_WIRE_H
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Ocean1 {
+
+constexpr uint32_t EIGEN_WIRE_MAGIC = 0x57454F31;  // "1OEW"
+constexpr uint8_t EIGEN_WIRE_VERSION = 1;
+constexpr uint8_t EIGEN_WIRE_DTYPE_FLOAT64 = 1;
+constexpr size_t EIGEN_WIRE_HEADER_SIZE = 24;
+
+struct EigenWireHeader {
+	uint8_t version;
+	uint8_t dtype;
+	uint32_t rows;
+	uint32_t cols;
+	uint64_t seq;
+};
+
+/**
+ * @brief number of bytes of the encoding of a rows x cols matrix
+ */
+inline size_t eigenWireSize(int rows, int cols) {
+	return EIGEN_WIRE_HEADER_SIZE + sizeof(double) * rows * cols;
+}
+
+/**
+ * @brief returns true if the buffer starts with the binary magic. Used to
+ * tell binary values apart from the text format of the RedisClient
+ */
+bool isEigenWire(const char* data, size_t len);
+
+/**
+ * @brief Encode a matrix into buffer. The buffer is resized to the encoded
+ * size, so reusing the same buffer for the same key does not allocate.
+ *
+ * @param matrix matrix to encode
+ * @param seq sequence number stored in the header
+ * @param buffer output buffer
+ */
+void encodeEigenWire(const Eigen::Ref<const Eigen::MatrixXd>& matrix,
+					 uint64_t seq, std::string& buffer);
+
+/**
+ * @brief read the header of a binary encoded value
+ *
+ * @return false if the buffer is not a valid binary encoding
+ */
+bool decodeEigenWireHeader(const char* data, size_t len,
+						   EigenWireHeader& header);
+
+/**
+ * @brief Decode a binary value straight into a preallocated matrix. The
+ * output is never resized.
+ *
+ * @param data encoded bytes
+ * @param len number of encoded bytes
+ * @param out preallocated destination, must have the encoded size
+ * @param seq if not null, receives the sequence number of the value
+ * @return false if the value is not a valid encoding or if its size does not
+ * match the size of out
+ */
+bool decodeEigenWire(const char* data, size_t len,
+					 Eigen::Ref<Eigen::MatrixXd> out, uint64_t* seq = nullptr);
+
+/**
+ * @brief Encode a matrix with the text format of the Sai2Common RedisClient
+ * ("[a,b,c]" for vectors, "[[a,b],[c,d]]" for matrices, row by row).
+ * Reusing the same buffer for the same key does not allocate in steady state.
+ */
+void encodeEigenText(const Eigen::Ref<const Eigen::MatrixXd>& matrix,
+					 std::string& buffer);
+
+/**
+ * @brief Decode a text formatted value straight into a preallocated matrix
+ *
+ * @return false if the number of values does not match the size of out
+ */
+bool decodeEigenText(const char* data, size_t len,
+					 Eigen::Ref<Eigen::MatrixXd> out);
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_EIGEN_WIRE_H
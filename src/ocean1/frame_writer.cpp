@@ -0,0 +1,121 @@
+/**
+ * @file frame_writer.cpp
+ * @brief Asynchronous writer of captured video frames
+ *
+ */
+
+#include "frame_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace Ocean1 {
+
+namespace {
+
+// RGBA bytes of a frame, validated before any buffer is sized from it
+size_t validFrameBytes(int width, int height) {
+	if (width <= 0 || height <= 0) {
+		throw std::invalid_argument("FrameWriter: invalid frame size");
+	}
+	return size_t(width) * height * 4;
+}
+
+}  // namespace
+
+FrameWriter::FrameWriter(const std::string& path, int width, int height,
+						 size_t ring_capacity)
+	: _path(path),
+	  _width(width),
+	  _height(height),
+	  _frame_bytes(validFrameBytes(width, height)),
+	  _ring(ring_capacity),
+	  _written(0),
+	  _dropped(0),
+	  _fd(-1),
+	  _flipped(_frame_bytes),
+	  _running(false) {
+	_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (_fd < 0) {
+		throw std::runtime_error("FrameWriter: cannot open " + path + ": " +
+								 strerror(errno));
+	}
+	_running = true;
+	_writer = std::thread(&FrameWriter::writerLoop, this);
+}
+
+FrameWriter::~FrameWriter() {
+	stop();
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+uint8_t* FrameWriter::beginFrame() {
+	std::vector<uint8_t>* frame = _ring.reserve();
+	if (!frame) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	// the slots are allocated the first time they are used only
+	frame->resize(_frame_bytes);
+	return frame->data();
+}
+
+void FrameWriter::stop() {
+	if (!_running) {
+		return;
+	}
+	_running = false;
+	_writer.join();
+	std::cout << "FrameWriter (" << _path << "): " << writtenFrames()
+			  << " frames of " << _width << "x" << _height << " written, "
+			  << droppedFrames() << " dropped" << std::endl;
+}
+
+void FrameWriter::writerLoop() {
+	// drain the ring, then sleep for a fraction of a frame
+	while (true) {
+		const bool running = _running.load();
+		while (const std::vector<uint8_t>* frame = _ring.front()) {
+			writeFrame(*frame);
+			_ring.pop();
+		}
+		if (!running) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+void FrameWriter::writeFrame(const std::vector<uint8_t>& frame) {
+	const size_t row_bytes = size_t(_width) * 4;
+	for (int row = 0; row < _height; ++row) {
+		memcpy(&_flipped[row * row_bytes],
+			   &frame[(_height - 1 - row) * row_bytes], row_bytes);
+	}
+	const uint8_t* data = _flipped.data();
+	size_t remaining = _flipped.size();
+	while (remaining > 0) {
+		const ssize_t n = write(_fd, data, remaining);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cerr << "FrameWriter: cannot write " << _path << ": "
+					  << strerror(errno) << std::endl;
+			return;
+		}
+		data += n;
+		remaining -= n;
+	}
+	_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace Ocean1
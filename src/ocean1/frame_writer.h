@@ -0,0 +1,87 @@
+/**
+ * @file frame_writer.h
+ * @brief Asynchronous writer of captured video frames. The render thread
+ * copies each frame into a slot of a lock free ring, and a background thread
+ * writes them to a file of raw RGBA frames, top row first, which ffmpeg reads
+ * directly:
+ *
+ *   ffmpeg -f rawvideo -pixel_format rgba -video_size <width>x<height>
+ *     -framerate <fps> -i <file> <output>.mp4
+ *
+ */
+
+#ifndef OCEAN1_FRAME_WRITER_H
+#define OCEAN1_FRAME_WRITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+namespace Ocean1 {
+
+class FrameWriter {
+public:
+	/**
+	 * @param path output file, truncated
+	 * @param width frame width in pixels
+	 * @param height frame height in pixels
+	 * @param ring_capacity number of frames the ring holds (power of two)
+	 */
+	FrameWriter(const std::string& path, int width, int height,
+				size_t ring_capacity = 8);
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	/**
+	 * @brief render thread side: buffer of the next frame, width * height
+	 * RGBA pixels with the bottom row first (as read from OpenGL), to be
+	 * committed with commitFrame(). Returns nullptr, and counts a dropped
+	 * frame, if the writer thread is behind.
+	 */
+	uint8_t* beginFrame();
+	void commitFrame() { _ring.publish(); }
+
+	size_t frameBytes() const { return _frame_bytes; }
+
+	/**
+	 * @brief write the remaining frames and stop the writer thread. Called by
+	 * the destructor.
+	 */
+	void stop();
+
+	uint64_t writtenFrames() const {
+		return _written.load(std::memory_order_relaxed);
+	}
+	uint64_t droppedFrames() const {
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	void writerLoop();
+	void writeFrame(const std::vector<uint8_t>& frame);
+
+	std::string _path;
+	int _width;
+	int _height;
+	size_t _frame_bytes;
+	SpscRing<std::vector<uint8_t>> _ring;
+	std::atomic<uint64_t> _written;
+	std::atomic<uint64_t> _dropped;
+
+	// writer thread state
+	int _fd;
+	// frame flipped to the top row first
+	std::vector<uint8_t> _flipped;
+	std::atomic<bool> _running;
+	std::thread _writer;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_FRAME_WRITER_H
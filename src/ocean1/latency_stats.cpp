@@ -0,0 +1,93 @@
+/**
+ * @file latency_stats.cpp
+ * @brief Simulator side statistics of the age of the commanded torques
+ *
+ */
+
+#include "latency_stats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Ocean1 {
+
+LatencyStats::LatencyStats(double bin_width_seconds, int num_bins)
+	: _bin_width(bin_width_seconds),
+	  _bins(num_bins + 1, 0),
+	  _last_seq(0),
+	  _applied(0),
+	  _unstamped(0),
+	  _fresh(0),
+	  _duplicated(0),
+	  _missed_states(0),
+	  _out_of_order(0),
+	  _age_sum(0.0),
+	  _age_max(0.0) {}
+
+void LatencyStats::recordCommand(const SimStamp& state_stamp, double now) {
+	if (state_stamp.seq == 0) {
+		++_unstamped;
+		return;
+	}
+	++_applied;
+	if (state_stamp.seq == _last_seq) {
+		++_duplicated;
+	} else if (state_stamp.seq < _last_seq) {
+		++_out_of_order;
+	} else {
+		++_fresh;
+		if (_last_seq != 0) {
+			_missed_states += state_stamp.seq - _last_seq - 1;
+		}
+		_last_seq = state_stamp.seq;
+	}
+
+	const double age = std::max(0.0, now - state_stamp.timestamp);
+	_age_sum += age;
+	_age_max = std::max(_age_max, age);
+	const size_t bin = std::min(_bins.size() - 1, (size_t)(age / _bin_width));
+	++_bins[bin];
+}
+
+double LatencyStats::percentile(double fraction) const {
+	// upper edge of the bin holding the percentile
+	const uint64_t target = (uint64_t)(fraction * _applied);
+	uint64_t count = 0;
+	for (size_t i = 0; i < _bins.size(); ++i) {
+		count += _bins[i];
+		if (count > target) {
+			return std::min(_age_max, (i + 1) * _bin_width);
+		}
+	}
+	return _age_max;
+}
+
+void LatencyStats::printInfo(std::ostream& os) const {
+	os << "commands applied: " << _applied << " (" << _fresh << " new, "
+	   << _duplicated << " reused from the previous tick, " << _out_of_order
+	   << " out of order)\n";
+	os << "ticks before the first command: " << _unstamped << "\n";
+	os << "states the controller skipped: " << _missed_states << "\n";
+	if (_applied == 0) {
+		return;
+	}
+	os << "command age (ms): mean " << 1e3 * _age_sum / _applied << ", p50 <= "
+	   << 1e3 * percentile(0.5) << ", p99 <= " << 1e3 * percentile(0.99)
+	   << ", p99.9 <= " << 1e3 * percentile(0.999) << ", max "
+	   << 1e3 * _age_max << "\n";
+	os << "command age histogram (ms):\n";
+	for (size_t i = 0; i < _bins.size(); ++i) {
+		if (_bins[i] == 0) {
+			continue;
+		}
+		if (i + 1 == _bins.size()) {
+			os << "  >= " << std::setw(7) << 1e3 * i * _bin_width;
+		} else {
+			os << "  " << std::setw(7) << 1e3 * i * _bin_width << " - "
+			   << std::setw(7) << 1e3 * (i + 1) * _bin_width;
+		}
+		os << " : " << _bins[i] << "\n";
+	}
+}
+
+}  // namespace Ocean1
@@ -0,0 +1,68 @@
+/**
+ * @file latency_stats.h
+ * @brief Simulator side statistics of the age of the commanded torques, built
+ * from the state stamps the controller echoes with its torques
+ *
+ */
+
+#ifndef OCEAN1_LATENCY_STATS_H
+#define OCEAN1_LATENCY_STATS_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "sim_transport.h"
+
+namespace Ocean1 {
+
+/**
+ * @brief Histogram of the command age (time between the publication of a
+ * state and the application of the torques computed from it) with counters of
+ * the reused and skipped states. Everything is preallocated, recording a
+ * command does not allocate.
+ *
+ */
+class LatencyStats {
+public:
+	/**
+	 * @brief
+	 *
+	 * @param bin_width_seconds width of a histogram bin
+	 * @param num_bins number of bins, older commands go in an overflow bin
+	 */
+	LatencyStats(double bin_width_seconds = 50e-6, int num_bins = 100);
+
+	/**
+	 * @brief record the command applied at one simulator tick
+	 *
+	 * @param state_stamp stamp of the state the command was computed from
+	 * @param now current time on the monotonic clock
+	 */
+	void recordCommand(const SimStamp& state_stamp, double now);
+
+	/**
+	 * @brief print the counters, percentiles and non empty bins
+	 */
+	void printInfo(std::ostream& os) const;
+
+private:
+	double percentile(double fraction) const;
+
+	double _bin_width;
+	std::vector<uint64_t> _bins;  // last bin is the overflow bin
+	uint64_t _last_seq;
+
+	uint64_t _applied;			  // ticks with a stamped command
+	uint64_t _unstamped;		  // ticks before the first stamped command
+	uint64_t _fresh;			  // ticks applying a new command
+	uint64_t _duplicated;		  // ticks reapplying the previous command
+	uint64_t _missed_states;	  // states no command was computed from
+	uint64_t _out_of_order;		  // commands older than the previous one
+	double _age_sum;
+	double _age_max;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_LATENCY_STATS_H
@@ -0,0 +1,683 @@
+/**
+ * @file mesh_cache.cpp
+ * @brief Conversion of the OBJ meshes to the binary mesh cache, and memory
+ * mapped loading of the cache files
+ *
+ */
+
+#include "mesh_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace Ocean1 {
+
+namespace {
+
+constexpr size_t MESH_CACHE_ALIGNMENT = 16;
+
+size_t alignUp(size_t offset) {
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT *
+		   MESH_CACHE_ALIGNMENT;
+}
+
+// copy a string into a fixed size, zero terminated field
+void copyField(char* field, size_t size, const std::string& value) {
+	memset(field, 0, size);
+	strncpy(field, value.c_str(), size - 1);
+}
+
+std::string readFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("cannot read " + path);
+	}
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// rest of the line after the keyword, without surrounding blanks
+std::string lineArgument(const char* p, const char* line_end) {
+	while (p < line_end && isBlank(*p)) {
+		++p;
+	}
+	const char* end = line_end;
+	while (end > p && isBlank(end[-1])) {
+		--end;
+	}
+	return std::string(p, end);
+}
+
+// true if the line starts with the keyword followed by a blank
+bool hasKeyword(const char* p, const char* line_end, const char* keyword) {
+	const size_t n = strlen(keyword);
+	return line_end - p > (long)n && strncmp(p, keyword, n) == 0 &&
+		   isBlank(p[n]);
+}
+
+void parseFloats(const char* p, float* values, int n) {
+	for (int i = 0; i < n; ++i) {
+		char* end;
+		values[i] = strtof(p, &end);
+		p = end;
+	}
+}
+
+MeshMaterial defaultMaterial(const std::string& name) {
+	MeshMaterial material;
+	memset(&material, 0, sizeof(material));
+	copyField(material.name, sizeof(material.name), name);
+	for (int i = 0; i < 3; ++i) {
+		material.ambient[i] = 0.2f;
+		material.diffuse[i] = 0.8f;
+		material.specular[i] = 0.0f;
+	}
+	material.opacity = 1.0f;
+	return material;
+}
+
+void parseMtl(const std::string& mtl_path, std::vector<MeshMaterial>& materials,
+			  std::unordered_map<std::string, int>& material_indices) {
+	const std::string contents = readFile(mtl_path);
+	const char* p = contents.data();
+	const char* end = p + contents.size();
+	MeshMaterial* material = nullptr;
+	while (p < end) {
+		const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!line_end) {
+			line_end = end;
+		}
+		while (p < line_end && isBlank(*p)) {
+			++p;
+		}
+		if (hasKeyword(p, line_end, "newmtl")) {
+			const std::string name = lineArgument(p + 6, line_end);
+			material_indices[name] = materials.size();
+			materials.push_back(defaultMaterial(name));
+			material = &materials.back();
+		} else if (material) {
+			if (hasKeyword(p, line_end, "Ka")) {
+				parseFloats(p + 2, material->ambient, 3);
+			} else if (hasKeyword(p, line_end, "Kd")) {
+				parseFloats(p + 2, material->diffuse, 3);
+			} else if (hasKeyword(p, line_end, "Ks")) {
+				parseFloats(p + 2, material->specular, 3);
+			} else if (hasKeyword(p, line_end, "Ns")) {
+				parseFloats(p + 2, &material->shininess, 1);
+			} else if (hasKeyword(p, line_end, "d")) {
+				parseFloats(p + 1, &material->opacity, 1);
+			} else if (hasKeyword(p, line_end, "Tr")) {
+				float transparency;
+				parseFloats(p + 2, &transparency, 1);
+				material->opacity = 1.0f - transparency;
+			} else if (hasKeyword(p, line_end, "map_Kd")) {
+				// the file name is the last argument, after the options
+				std::string argument = lineArgument(p + 6, line_end);
+				const size_t space = argument.find_last_of(" \t");
+				if (space != std::string::npos) {
+					argument = argument.substr(space + 1);
+				}
+				copyField(material->texture, sizeof(material->texture),
+						  argument);
+			}
+		}
+		p = line_end + 1;
+	}
+}
+
+struct VertexKey {
+	int position;
+	int uv;
+	int normal;
+	bool operator==(const VertexKey& other) const {
+		return position == other.position && uv == other.uv &&
+			   normal == other.normal;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey& key) const {
+		size_t h = std::hash<int>()(key.position);
+		h = h * 31 + std::hash<int>()(key.uv);
+		return h * 31 + std::hash<int>()(key.normal);
+	}
+};
+
+// OBJ indices are 1 based, or relative to the end if negative. Returns -1
+// for a missing index.
+int resolveIndex(long index, size_t count) {
+	if (index > 0) {
+		return index - 1;
+	}
+	if (index < 0) {
+		return count + index;
+	}
+	return -1;
+}
+
+}  // namespace
+
+MeshData parseObjMesh(const std::string& obj_path) {
+	const std::string contents = readFile(obj_path);
+	const fs::path directory = fs::path(obj_path).parent_path();
+
+	MeshData mesh;
+	std::vector<float> positions, uvs, normals;
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertex_indices;
+	std::unordered_map<std::string, int> material_indices;
+	// vertices without a normal in the file
+	std::vector<bool> computed_normals;
+	std::vector<uint32_t> face;
+
+	MeshSubmesh submesh = {0, 0, -1, 0};
+	auto closeSubmesh = [&]() {
+		submesh.index_count = mesh.indices.size() - submesh.index_offset;
+		if (submesh.index_count > 0) {
+			mesh.submeshes.push_back(submesh);
+		}
+		submesh.index_offset = mesh.indices.size();
+	};
+
+	const char* p = contents.data();
+	const char* end = p + contents.size();
+	while (p < end) {
+		const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!line_end) {
+			line_end = end;
+		}
+		while (p < line_end && isBlank(*p)) {
+			++p;
+		}
+		if (hasKeyword(p, line_end, "v")) {
+			float v[3];
+			parseFloats(p + 1, v, 3);
+			positions.insert(positions.end(), v, v + 3);
+		} else if (hasKeyword(p, line_end, "vt")) {
+			float vt[2];
+			parseFloats(p + 2, vt, 2);
+			uvs.insert(uvs.end(), vt, vt + 2);
+		} else if (hasKeyword(p, line_end, "vn")) {
+			float vn[3];
+			parseFloats(p + 2, vn, 3);
+			normals.insert(normals.end(), vn, vn + 3);
+		} else if (hasKeyword(p, line_end, "f")) {
+			face.clear();
+			const char* q = p + 1;
+			while (q < line_end) {
+				while (q < line_end && isBlank(*q)) {
+					++q;
+				}
+				if (q >= line_end) {
+					break;
+				}
+				// v, v/vt, v//vn or v/vt/vn
+				char* next;
+				VertexKey key = {-1, -1, -1};
+				key.position = resolveIndex(strtol(q, &next, 10),
+											positions.size() / 3);
+				q = next;
+				if (q < line_end && *q == '/') {
+					++q;
+					if (*q != '/') {
+						key.uv = resolveIndex(strtol(q, &next, 10),
+											  uvs.size() / 2);
+						q = next;
+					}
+					if (q < line_end && *q == '/') {
+						++q;
+						key.normal = resolveIndex(strtol(q, &next, 10),
+												  normals.size() / 3);
+						q = next;
+					}
+				}
+				if (key.position < 0 ||
+					key.position >= (int)positions.size() / 3 ||
+					key.uv >= (int)uvs.size() / 2 ||
+					key.normal >= (int)normals.size() / 3) {
+					throw std::runtime_error("invalid face in " + obj_path);
+				}
+				auto it = vertex_indices.find(key);
+				if (it == vertex_indices.end()) {
+					MeshVertex vertex;
+					memset(&vertex, 0, sizeof(vertex));
+					memcpy(vertex.position, &positions[3 * key.position],
+						   sizeof(vertex.position));
+					if (key.uv >= 0) {
+						memcpy(vertex.uv, &uvs[2 * key.uv], sizeof(vertex.uv));
+					}
+					if (key.normal >= 0) {
+						memcpy(vertex.normal, &normals[3 * key.normal],
+							   sizeof(vertex.normal));
+					}
+					it = vertex_indices.emplace(key, mesh.vertices.size()).first;
+					mesh.vertices.push_back(vertex);
+					computed_normals.push_back(key.normal < 0);
+				}
+				face.push_back(it->second);
+				// skip anything unexpected up to the next blank
+				while (q < line_end && !isBlank(*q)) {
+					++q;
+				}
+			}
+			// triangle fan
+			for (size_t i = 2; i < face.size(); ++i) {
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[i - 1]);
+				mesh.indices.push_back(face[i]);
+			}
+		} else if (hasKeyword(p, line_end, "usemtl")) {
+			closeSubmesh();
+			auto it = material_indices.find(lineArgument(p + 6, line_end));
+			submesh.material = it == material_indices.end() ? -1 : it->second;
+		} else if (hasKeyword(p, line_end, "mtllib")) {
+			const std::string library = lineArgument(p + 6, line_end);
+			if (mesh.material_library.empty()) {
+				mesh.material_library = library;
+			}
+			// a missing library leaves the default material
+			try {
+				parseMtl((directory / library).string(), mesh.materials,
+						 material_indices);
+			} catch (const std::runtime_error&) {
+			}
+		}
+		p = line_end + 1;
+	}
+	closeSubmesh();
+
+	// area weighted face normals for the vertices that have none
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const uint32_t* triangle = &mesh.indices[i];
+		if (!computed_normals[triangle[0]] && !computed_normals[triangle[1]] &&
+			!computed_normals[triangle[2]]) {
+			continue;
+		}
+		const float* a = mesh.vertices[triangle[0]].position;
+		const float* b = mesh.vertices[triangle[1]].position;
+		const float* c = mesh.vertices[triangle[2]].position;
+		const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		const float n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+							u[0] * v[1] - u[1] * v[0]};
+		for (int j = 0; j < 3; ++j) {
+			if (computed_normals[triangle[j]]) {
+				float* normal = mesh.vertices[triangle[j]].normal;
+				normal[0] += n[0];
+				normal[1] += n[1];
+				normal[2] += n[2];
+			}
+		}
+	}
+	for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+		if (computed_normals[i]) {
+			float* normal = mesh.vertices[i].normal;
+			const float norm = std::sqrt(normal[0] * normal[0] +
+										 normal[1] * normal[1] +
+										 normal[2] * normal[2]);
+			if (norm > 0) {
+				normal[0] /= norm;
+				normal[1] /= norm;
+				normal[2] /= norm;
+			}
+		}
+	}
+	return mesh;
+}
+
+MeshData decimateMesh(const MeshData& mesh, double triangle_ratio) {
+	if (mesh.vertices.empty()) {
+		return mesh;
+	}
+	float lower[3], upper[3];
+	for (int k = 0; k < 3; ++k) {
+		lower[k] = upper[k] = mesh.vertices[0].position[k];
+	}
+	for (const auto& vertex : mesh.vertices) {
+		for (int k = 0; k < 3; ++k) {
+			lower[k] = std::min(lower[k], vertex.position[k]);
+			upper[k] = std::max(upper[k], vertex.position[k]);
+		}
+	}
+	const float extent = std::max(
+		{upper[0] - lower[0], upper[1] - lower[1], upper[2] - lower[2]});
+	if (extent <= 0) {
+		return mesh;
+	}
+
+	// cluster of every vertex on a grid of the given resolution (cells along
+	// the largest dimension)
+	std::vector<uint32_t> vertex_clusters(mesh.vertices.size());
+	auto cluster = [&](int resolution) {
+		const float cell_size = extent / resolution;
+		std::unordered_map<uint64_t, uint32_t> cells;
+		for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+			uint64_t key = 0;
+			for (int k = 0; k < 3; ++k) {
+				const uint64_t cell =
+					std::min<uint64_t>((mesh.vertices[i].position[k] - lower[k]) /
+										   cell_size,
+									   resolution - 1);
+				key = (key << 21) | cell;
+			}
+			vertex_clusters[i] =
+				cells.emplace(key, cells.size()).first->second;
+		}
+		return cells.size();
+	};
+	// triangles of the clustered mesh, per submesh
+	struct TriangleHash {
+		size_t operator()(const std::array<uint32_t, 3>& t) const {
+			return (size_t(t[0]) * 73856093) ^ (size_t(t[1]) * 19349663) ^
+				   (size_t(t[2]) * 83492791);
+		}
+	};
+	auto clusteredIndices = [&](const MeshSubmesh& submesh,
+								std::vector<uint32_t>& indices) {
+		std::unordered_set<std::array<uint32_t, 3>, TriangleHash> triangles;
+		const uint32_t* source = &mesh.indices[submesh.index_offset];
+		for (uint32_t i = 0; i + 2 < submesh.index_count; i += 3) {
+			std::array<uint32_t, 3> t = {vertex_clusters[source[i]],
+										 vertex_clusters[source[i + 1]],
+										 vertex_clusters[source[i + 2]]};
+			if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) {
+				continue;
+			}
+			// same triangle whatever the first vertex, and either orientation
+			std::array<uint32_t, 3> sorted = t;
+			std::sort(sorted.begin(), sorted.end());
+			if (triangles.insert(sorted).second) {
+				indices.insert(indices.end(), t.begin(), t.end());
+			}
+		}
+	};
+	auto countTriangles = [&](int resolution) {
+		cluster(resolution);
+		std::vector<uint32_t> indices;
+		for (const auto& submesh : mesh.submeshes) {
+			clusteredIndices(submesh, indices);
+		}
+		return indices.size() / 3;
+	};
+
+	// finest grid within the triangle budget, the triangle count grows with
+	// the resolution
+	const size_t budget = triangle_ratio * (mesh.indices.size() / 3);
+	int resolution = 2;
+	for (int low = 2, high = 4096; low <= high;) {
+		const int middle = low + (high - low) / 2;
+		if (countTriangles(middle) <= budget) {
+			resolution = middle;
+			low = middle + 1;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	MeshData decimated;
+	decimated.materials = mesh.materials;
+	decimated.material_library = mesh.material_library;
+	const size_t num_clusters = cluster(resolution);
+	std::vector<MeshVertex> sums(num_clusters);
+	std::vector<uint32_t> counts(num_clusters, 0);
+	memset(sums.data(), 0, sums.size() * sizeof(MeshVertex));
+	for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+		MeshVertex& sum = sums[vertex_clusters[i]];
+		const MeshVertex& vertex = mesh.vertices[i];
+		for (int k = 0; k < 3; ++k) {
+			sum.position[k] += vertex.position[k];
+			sum.normal[k] += vertex.normal[k];
+		}
+		sum.uv[0] += vertex.uv[0];
+		sum.uv[1] += vertex.uv[1];
+		++counts[vertex_clusters[i]];
+	}
+
+	// only keep the clusters used by a triangle
+	std::vector<int64_t> used(num_clusters, -1);
+	for (const auto& submesh : mesh.submeshes) {
+		std::vector<uint32_t> indices;
+		clusteredIndices(submesh, indices);
+		if (indices.empty()) {
+			continue;
+		}
+		MeshSubmesh decimated_submesh = submesh;
+		decimated_submesh.index_offset = decimated.indices.size();
+		decimated_submesh.index_count = indices.size();
+		for (uint32_t index : indices) {
+			if (used[index] < 0) {
+				used[index] = decimated.vertices.size();
+				MeshVertex vertex = sums[index];
+				const float norm = std::sqrt(vertex.normal[0] * vertex.normal[0] +
+											 vertex.normal[1] * vertex.normal[1] +
+											 vertex.normal[2] * vertex.normal[2]);
+				for (int k = 0; k < 3; ++k) {
+					vertex.position[k] /= counts[index];
+					vertex.normal[k] = norm > 0 ? vertex.normal[k] / norm : 0;
+				}
+				vertex.uv[0] /= counts[index];
+				vertex.uv[1] /= counts[index];
+				decimated.vertices.push_back(vertex);
+			}
+			decimated.indices.push_back(used[index]);
+		}
+		decimated.submeshes.push_back(decimated_submesh);
+	}
+	return decimated;
+}
+
+void writeMeshCache(const MeshData& mesh, const std::string& cache_path) {
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_count = mesh.vertices.size();
+	header.index_count = mesh.indices.size();
+	header.submesh_count = mesh.submeshes.size();
+	header.material_count = mesh.materials.size();
+	header.vertices_offset = alignUp(sizeof(MeshCacheHeader));
+	header.indices_offset = alignUp(header.vertices_offset +
+									mesh.vertices.size() * sizeof(MeshVertex));
+	header.submeshes_offset = alignUp(header.indices_offset +
+									  mesh.indices.size() * sizeof(uint32_t));
+	header.materials_offset = alignUp(
+		header.submeshes_offset + mesh.submeshes.size() * sizeof(MeshSubmesh));
+	for (int k = 0; k < 3; ++k) {
+		header.lower[k] =
+			mesh.vertices.empty() ? 0.0f : mesh.vertices[0].position[k];
+		header.upper[k] = header.lower[k];
+	}
+	for (const auto& vertex : mesh.vertices) {
+		for (int k = 0; k < 3; ++k) {
+			header.lower[k] = std::min(header.lower[k], vertex.position[k]);
+			header.upper[k] = std::max(header.upper[k], vertex.position[k]);
+		}
+	}
+	copyField(header.material_library, sizeof(header.material_library),
+			  mesh.material_library);
+
+	fs::create_directories(fs::path(cache_path).parent_path());
+	const std::string tmp_path =
+		cache_path + ".tmp." + std::to_string(getpid());
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			throw std::runtime_error("cannot write " + tmp_path);
+		}
+		auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+			// zero padding up to the aligned offset
+			static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+			file.write(zeros, offset - file.tellp());
+			file.write(static_cast<const char*>(data), size);
+		};
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.vertices_offset, mesh.vertices.data(),
+				mesh.vertices.size() * sizeof(MeshVertex));
+		writeAt(header.indices_offset, mesh.indices.data(),
+				mesh.indices.size() * sizeof(uint32_t));
+		writeAt(header.submeshes_offset, mesh.submeshes.data(),
+				mesh.submeshes.size() * sizeof(MeshSubmesh));
+		writeAt(header.materials_offset, mesh.materials.data(),
+				mesh.materials.size() * sizeof(MeshMaterial));
+		if (!file) {
+			throw std::runtime_error("cannot write " + tmp_path);
+		}
+	}
+	fs::rename(tmp_path, cache_path);
+}
+
+std::string meshCachePath(const std::string& cache_dir,
+						  const std::string& source_path, int lod) {
+	const fs::path source = fs::absolute(source_path).lexically_normal();
+	fs::path cache_path = fs::path(cache_dir) / source.relative_path();
+	if (lod > 0) {
+		cache_path += ".lod" + std::to_string(lod);
+	}
+	cache_path += MESH_CACHE_EXTENSION;
+	return cache_path.string();
+}
+
+bool isMeshCacheFresh(const std::string& cache_path,
+					  const std::string& source_path) {
+	std::error_code error;
+	const auto cache_time = fs::last_write_time(cache_path, error);
+	if (error) {
+		return false;
+	}
+	const auto source_time = fs::last_write_time(source_path, error);
+	if (error || cache_time < source_time) {
+		return false;
+	}
+
+	MeshCacheHeader header;
+	std::ifstream file(cache_path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != MESH_CACHE_VERSION) {
+		return false;
+	}
+	header.material_library[sizeof(header.material_library) - 1] = '\0';
+	if (header.material_library[0] != '\0') {
+		const fs::path library =
+			fs::path(source_path).parent_path() / header.material_library;
+		const auto library_time = fs::last_write_time(library, error);
+		if (!error && cache_time < library_time) {
+			return false;
+		}
+	}
+	return true;
+}
+
+MappedMesh::MappedMesh(const std::string& cache_path)
+	: _data(nullptr), _size(0) {
+	const int fd = open(cache_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("MappedMesh: cannot open " + cache_path +
+								 ": " + strerror(errno));
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 ||
+		file_stat.st_size < (off_t)sizeof(MeshCacheHeader)) {
+		close(fd);
+		throw std::runtime_error("MappedMesh: " + cache_path +
+								 " is not a mesh cache file");
+	}
+	_size = file_stat.st_size;
+	_data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (_data == MAP_FAILED) {
+		_data = nullptr;
+		throw std::runtime_error("MappedMesh: cannot map " + cache_path +
+								 ": " + strerror(errno));
+	}
+
+	const char* base = static_cast<const char*>(_data);
+	_header = reinterpret_cast<const MeshCacheHeader*>(base);
+	auto fits = [&](uint64_t offset, uint64_t count, size_t element_size) {
+		return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= _size &&
+			   count <= (_size - offset) / element_size;
+	};
+	if (memcmp(_header->magic, MESH_CACHE_MAGIC, sizeof(_header->magic)) !=
+			0 ||
+		_header->version != MESH_CACHE_VERSION ||
+		!fits(_header->vertices_offset, _header->vertex_count,
+			  sizeof(MeshVertex)) ||
+		!fits(_header->indices_offset, _header->index_count,
+			  sizeof(uint32_t)) ||
+		!fits(_header->submeshes_offset, _header->submesh_count,
+			  sizeof(MeshSubmesh)) ||
+		!fits(_header->materials_offset, _header->material_count,
+			  sizeof(MeshMaterial))) {
+		munmap(_data, _size);
+		_data = nullptr;
+		throw std::runtime_error("MappedMesh: " + cache_path +
+								 " is not a valid mesh cache file of version " +
+								 std::to_string(MESH_CACHE_VERSION));
+	}
+	_vertices =
+		reinterpret_cast<const MeshVertex*>(base + _header->vertices_offset);
+	_indices = reinterpret_cast<const uint32_t*>(base + _header->indices_offset);
+	_submeshes =
+		reinterpret_cast<const MeshSubmesh*>(base + _header->submeshes_offset);
+	_materials =
+		reinterpret_cast<const MeshMaterial*>(base + _header->materials_offset);
+
+	// the contents are used as indices and C strings by the loaders, so a
+	// stale or corrupted file must not get past here
+	const char* invalid = nullptr;
+	for (uint32_t i = 0; i < _header->index_count && !invalid; ++i) {
+		if (_indices[i] >= _header->vertex_count) {
+			invalid = "vertex index";
+		}
+	}
+	for (uint32_t i = 0; i < _header->submesh_count && !invalid; ++i) {
+		const MeshSubmesh& submesh = _submeshes[i];
+		if (submesh.index_offset > _header->index_count ||
+			submesh.index_count > _header->index_count - submesh.index_offset) {
+			invalid = "submesh index range";
+		} else if (submesh.material < -1 ||
+				   submesh.material >= (int64_t)_header->material_count) {
+			invalid = "submesh material";
+		}
+	}
+	for (uint32_t i = 0; i < _header->material_count && !invalid; ++i) {
+		const MeshMaterial& material = _materials[i];
+		if (!memchr(material.name, '\0', sizeof(material.name)) ||
+			!memchr(material.texture, '\0', sizeof(material.texture))) {
+			invalid = "material string";
+		}
+	}
+	if (invalid) {
+		munmap(_data, _size);
+		_data = nullptr;
+		throw std::runtime_error("MappedMesh: " + cache_path +
+								 " has an invalid " + invalid);
+	}
+}
+
+MappedMesh::~MappedMesh() {
+	if (_data) {
+		munmap(_data, _size);
+	}
+}
+
+}  // namespace Ocean1
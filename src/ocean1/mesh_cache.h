@@ -0,0 +1,181 @@
+/**
+ * @file mesh_cache.h
+ * @brief Preprocessed binary cache of the OBJ visual meshes. The meshes are
+ * converted offline (ocean1_mesh_cache target), then memory mapped at load
+ * time instead of being parsed from text.
+ *
+ * File format (native endianness, all sections 16 bytes aligned):
+ * - a MeshCacheHeader, with the magic "OC1MESH" and MESH_CACHE_VERSION
+ * - vertex_count interleaved MeshVertex (position, normal, uv)
+ * - index_count uint32_t vertex indices, three per triangle
+ * - submesh_count MeshSubmesh: ranges of indices sharing a material
+ * - material_count MeshMaterial, from the MTL library of the OBJ file
+ *
+ * A cache file is used only if it is at least as recent as the OBJ file and
+ * its MTL library.
+ *
+ * Meshes with enough triangles also get decimated levels of detail, in cache
+ * files of the same format (see meshCachePath).
+ *
+ */
+
+#ifndef OCEAN1_MESH_CACHE_H
+#define OCEAN1_MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Ocean1 {
+
+const char MESH_CACHE_MAGIC[8] = "OC1MESH";
+constexpr uint32_t MESH_CACHE_VERSION = 2;
+const std::string MESH_CACHE_EXTENSION = ".oc1mesh";
+
+// levels of detail besides the full mesh (level 0), and the fraction of the
+// triangles of the full mesh each of them keeps
+constexpr int MESH_CACHE_LOD_LEVELS = 2;
+const double MESH_CACHE_LOD_RATIOS[MESH_CACHE_LOD_LEVELS] = {0.25, 0.06};
+// meshes with fewer triangles are not decimated
+constexpr size_t MESH_CACHE_LOD_MIN_TRIANGLES = 2000;
+
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t submesh_count;
+	uint32_t material_count;
+	uint32_t reserved;
+	// byte offsets of the sections from the start of the file
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+	uint64_t submeshes_offset;
+	uint64_t materials_offset;
+	// bounding box of the vertex positions
+	float lower[3];
+	float upper[3];
+	// MTL library of the source, relative to its directory (empty if none)
+	char material_library[256];
+};
+
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+struct MeshSubmesh {
+	uint32_t index_offset;
+	uint32_t index_count;
+	// index in the materials, -1 for the default material
+	int32_t material;
+	uint32_t reserved;
+};
+
+struct MeshMaterial {
+	char name[64];
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	// Ns of the MTL file
+	float shininess;
+	// d of the MTL file
+	float opacity;
+	uint32_t reserved;
+	// diffuse texture (map_Kd), relative to the directory of the source
+	char texture[256];
+};
+
+/**
+ * @brief mesh in the layout of the cache, built by parseObjMesh
+ */
+struct MeshData {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<MeshMaterial> materials;
+	std::string material_library;
+};
+
+/**
+ * @brief parse an OBJ file and its MTL library. Polygons are triangulated,
+ * vertices are deduplicated, and missing normals are computed from the faces.
+ * Throws std::runtime_error if the file cannot be read.
+ */
+MeshData parseObjMesh(const std::string& obj_path);
+
+/**
+ * @brief decimate a mesh by vertex clustering on a regular grid, with the
+ * finest grid that keeps at most triangle_ratio of its triangles. The
+ * vertices of a cell are merged (averaged position, normal and uv), and
+ * collapsed or duplicate triangles are removed. Submeshes and materials are
+ * kept.
+ */
+MeshData decimateMesh(const MeshData& mesh, double triangle_ratio);
+
+/**
+ * @brief write a mesh to a cache file, creating its directory. The file is
+ * written next to its final path and renamed, so readers never see a
+ * partial file. Throws std::runtime_error on failure.
+ */
+void writeMeshCache(const MeshData& mesh, const std::string& cache_path);
+
+/**
+ * @brief path of the cache file of a source mesh: the absolute source path
+ * mirrored under cache_dir, with MESH_CACHE_EXTENSION appended. Levels of
+ * detail above 0 get ".lod<level>" before the extension.
+ */
+std::string meshCachePath(const std::string& cache_dir,
+						  const std::string& source_path, int lod = 0);
+
+/**
+ * @brief true if the cache file exists, has the current version and is at
+ * least as recent as the source and its MTL library
+ */
+bool isMeshCacheFresh(const std::string& cache_path,
+					  const std::string& source_path);
+
+/**
+ * @brief read only memory mapping of a cache file. The arrays point into the
+ * mapping and are valid for the lifetime of the object.
+ */
+class MappedMesh {
+public:
+	/**
+	 * @brief map and validate a cache file, throws std::runtime_error if it
+	 * cannot be read or is not a valid cache file of the current version.
+	 * The indices, submesh ranges and material indices are checked, so the
+	 * arrays can be used without bounds checks.
+	 */
+	explicit MappedMesh(const std::string& cache_path);
+	~MappedMesh();
+
+	MappedMesh(const MappedMesh&) = delete;
+	MappedMesh& operator=(const MappedMesh&) = delete;
+
+	const MeshCacheHeader& header() const { return *_header; }
+
+	const MeshVertex* vertices() const { return _vertices; }
+	size_t numVertices() const { return _header->vertex_count; }
+	const uint32_t* indices() const { return _indices; }
+	size_t numIndices() const { return _header->index_count; }
+	const MeshSubmesh* submeshes() const { return _submeshes; }
+	size_t numSubmeshes() const { return _header->submesh_count; }
+	const MeshMaterial* materials() const { return _materials; }
+	size_t numMaterials() const { return _header->material_count; }
+
+private:
+	void* _data;
+	size_t _size;
+	const MeshCacheHeader* _header;
+	const MeshVertex* _vertices;
+	const uint32_t* _indices;
+	const MeshSubmesh* _submeshes;
+	const MeshMaterial* _materials;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_MESH_CACHE_H
@@ -0,0 +1,161 @@
+/**
+ * @file mesh_cache_tool.cpp
+ * @brief Offline conversion of the OBJ meshes referenced by urdf files to the
+ * binary mesh cache (see mesh_cache.h). Built and run by the
+ * ocean1_mesh_cache target.
+ *
+ * usage: ocean1_mesh_cache <cache_dir> <urdf files...>
+ *
+ * The robot urdf files of <model> elements are followed. Meshes with fresh
+ * cache files are skipped. Meshes with at least MESH_CACHE_LOD_MIN_TRIANGLES
+ * triangles also get their decimated levels of detail.
+ *
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh_cache.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace {
+
+string readFile(const string& path) {
+	ifstream file(path);
+	stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+string substituteUrdfFolder(string value) {
+	const string variable = "${CS225A_URDF_FOLDER}";
+	size_t position;
+	while ((position = value.find(variable)) != string::npos) {
+		value.replace(position, variable.size(), CS225A_URDF_FOLDER);
+	}
+	return value;
+}
+
+// collect the obj meshes of a urdf file and of the robot files it references
+void collectMeshes(const fs::path& urdf_path, set<string>& urdf_files,
+				   set<string>& meshes) {
+	const string canonical = fs::weakly_canonical(urdf_path).string();
+	if (!urdf_files.insert(canonical).second) {
+		return;
+	}
+	if (!fs::exists(urdf_path)) {
+		cerr << "warning: " << urdf_path.string() << " not found" << endl;
+		return;
+	}
+	const string contents = regex_replace(readFile(urdf_path.string()),
+										  regex("<!--[\\s\\S]*?-->"), "");
+	const fs::path directory = urdf_path.parent_path();
+
+	const regex mesh_regex("<mesh[^>]*filename\\s*=\\s*\"([^\"]+)\"");
+	for (sregex_iterator it(contents.begin(), contents.end(), mesh_regex), end;
+		 it != end; ++it) {
+		fs::path mesh = substituteUrdfFolder((*it)[1]);
+		if (mesh.is_relative()) {
+			mesh = directory / mesh;
+		}
+		string extension = mesh.extension().string();
+		for (auto& c : extension) {
+			c = tolower(c);
+		}
+		if (extension == ".obj") {
+			meshes.insert(mesh.lexically_normal().string());
+		}
+	}
+
+	const regex model_regex(
+		"<model[^>]*dir\\s*=\\s*\"([^\"]+)\"[^>]*path\\s*=\\s*\"([^\"]+)\"");
+	for (sregex_iterator it(contents.begin(), contents.end(), model_regex), end;
+		 it != end; ++it) {
+		collectMeshes(fs::path(substituteUrdfFolder((*it)[1])) / (*it)[2].str(),
+					  urdf_files, meshes);
+	}
+}
+
+// true if the cache file of the mesh, and those of its levels of detail if
+// it has some, are fresh
+bool isUpToDate(const string& cache_dir, const string& mesh) {
+	const string cache_path = Ocean1::meshCachePath(cache_dir, mesh);
+	if (!Ocean1::isMeshCacheFresh(cache_path, mesh)) {
+		return false;
+	}
+	if (Ocean1::MappedMesh(cache_path).numIndices() / 3 <
+		Ocean1::MESH_CACHE_LOD_MIN_TRIANGLES) {
+		return true;
+	}
+	for (int lod = 1; lod <= Ocean1::MESH_CACHE_LOD_LEVELS; ++lod) {
+		if (!Ocean1::isMeshCacheFresh(
+				Ocean1::meshCachePath(cache_dir, mesh, lod), mesh)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		cerr << "usage: " << argv[0] << " <cache_dir> <urdf files...>" << endl;
+		return 1;
+	}
+	const string cache_dir = argv[1];
+
+	set<string> urdf_files, meshes;
+	for (int i = 2; i < argc; ++i) {
+		collectMeshes(argv[i], urdf_files, meshes);
+	}
+
+	int converted = 0, fresh = 0, failed = 0;
+	for (const auto& mesh : meshes) {
+		if (!fs::exists(mesh)) {
+			cerr << "warning: " << mesh << " not found, skipped" << endl;
+			++failed;
+			continue;
+		}
+		try {
+			if (isUpToDate(cache_dir, mesh)) {
+				++fresh;
+				continue;
+			}
+			auto start = chrono::steady_clock::now();
+			const Ocean1::MeshData data = Ocean1::parseObjMesh(mesh);
+			Ocean1::writeMeshCache(data,
+								   Ocean1::meshCachePath(cache_dir, mesh));
+			cout << mesh << ": " << data.indices.size() / 3 << " triangles";
+			if (data.indices.size() / 3 >= Ocean1::MESH_CACHE_LOD_MIN_TRIANGLES) {
+				for (int lod = 1; lod <= Ocean1::MESH_CACHE_LOD_LEVELS; ++lod) {
+					const Ocean1::MeshData decimated = Ocean1::decimateMesh(
+						data, Ocean1::MESH_CACHE_LOD_RATIOS[lod - 1]);
+					Ocean1::writeMeshCache(
+						decimated, Ocean1::meshCachePath(cache_dir, mesh, lod));
+					cout << ", lod " << lod << ": "
+						 << decimated.indices.size() / 3;
+				}
+			}
+			auto elapsed = chrono::duration<double, milli>(
+				chrono::steady_clock::now() - start);
+			cout << " (" << elapsed.count() << " ms)" << endl;
+			++converted;
+		} catch (const exception& e) {
+			cerr << "warning: " << mesh << ": " << e.what() << endl;
+			++failed;
+		}
+	}
+	cout << converted << " meshes converted, " << fresh << " up to date, "
+		 << failed << " skipped, in " << cache_dir << endl;
+	return 0;
+}
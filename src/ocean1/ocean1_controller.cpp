@@ -0,0 +1,505 @@
+/**
+ * @file ocean1_controller.cpp
+ * @brief Controller of ocean1
+ *
+ */
+
+#include "ocean1_controller.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace Eigen;
+using namespace Sai2Primitives;
+
+namespace Ocean1 {
+
+namespace {
+
+const double MAX_HAPTIC_FORCE = 3.0;
+const double THRESHOLD = 1.0;
+const double KS = 0.001;
+
+// Function to calculate the angle between two 2D vectors using atan2
+double calculate_angle_atan2(const Eigen::Vector2d& v1, const Eigen::Vector2d& v2) {
+    double angle1 = atan2(v1.y(), v1.x());
+    double angle2 = atan2(v2.y(), v2.x());
+    double angle = angle1 - angle2;
+
+    // Normalize the angle to the range [-pi, pi]
+    if (angle > M_PI) {
+        angle -= 2 * M_PI;
+    } else if (angle < -M_PI) {
+        angle += 2 * M_PI;
+    }
+
+    return angle;
+}
+
+// Function to calculate the rotations about x, y, and z axes
+Eigen::Vector3d calculate_rotations(const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
+    // Projections onto the yz-plane (perpendicular to the x-axis)
+    Eigen::Vector2d a_yz(a.y(), a.z());
+    Eigen::Vector2d b_yz(b.y(), b.z());
+    double angle_x = calculate_angle_atan2(a_yz, b_yz);
+
+    // Projections onto the xz-plane (perpendicular to the y-axis)
+    Eigen::Vector2d a_xz(a.x(), a.z());
+    Eigen::Vector2d b_xz(b.x(), b.z());
+    double angle_y = calculate_angle_atan2(a_xz, b_xz);
+
+    // Projections onto the xy-plane (perpendicular to the z-axis)
+    Eigen::Vector2d a_xy(a.x(), a.y());
+    Eigen::Vector2d b_xy(b.x(), b.y());
+    double angle_z = calculate_angle_atan2(a_xy, b_xy);
+
+    // Return the angles as a Vector3d (in radians)
+    return Eigen::Vector3d(angle_x, angle_y, angle_z);
+}
+
+#ifdef OCEAN1_FIXED_DOF
+// copy the model quantities of the tick into the fixed size core
+void updateCoreModel(Ocean1Controller::FixedCore& core, Sai2Model::Sai2Model& robot,
+					 const std::vector<std::string>& links,
+					 const std::vector<Vector3d>& points) {
+	core.q = robot.q();
+	core.dq = robot.dq();
+	core.M_inv = robot.MInv();
+	core.coriolis = robot.coriolisForce();
+	for (int i = 0; i < core.end_effectors.size(); ++i) {
+		core.end_effectors[i].J = robot.J(links[i], points[i]);
+		core.end_effectors[i].position = robot.position(links[i], points[i]);
+		core.end_effectors[i].rotation = robot.rotation(links[i]);
+	}
+}
+#endif
+
+}  // namespace
+
+Ocean1Controller::Ocean1Controller(
+	const std::vector<HapticDeviceLimits>& device_limits)
+	: _device_limits(device_limits),
+	  _robot_supported(true),
+	  _state(POSTURE),
+	  _haptic_button_was_pressed(false),
+	  _haptic_button_is_pressed(0),
+	  _prev_time(0.0),
+	  _console_rate(0.5) {
+	_device_limits.resize(NUM_HAPTIC_DEVICES);
+	// per phase timing, compiled in with OCEAN1_ENABLE_PROFILING
+	_phase_update_model = _profiler.addPhase("update_model");
+	_phase_haptic_control = _profiler.addPhase("haptic_control");
+	_phase_update_task_model = _profiler.addPhase("update_task_model");
+	_phase_nullspace = _profiler.addPhase("nullspace");
+	_phase_compute_torques = _profiler.addPhase("compute_torques");
+}
+
+void Ocean1Controller::init(std::shared_ptr<Sai2Model::Sai2Model> robot) {
+	_robot = robot;
+
+	// prepare controller
+	int dof = _robot->dof();
+	_command_torques = VectorXd::Zero(dof); 
+	_N_prec = MatrixXd::Identity(dof, dof);
+
+    // create haptic controllers
+	Affine3d device_home_pose = Affine3d(Translation3d(0, 0, 0));
+
+	Sai2Primitives::HapticDeviceController::DeviceLimits device_limits_left(
+		_device_limits[0].max_stiffness, _device_limits[0].max_damping, _device_limits[0].max_force);
+	_left_device_base_rotation_in_world = AngleAxisd(M_PI, Vector3d::UnitZ()).toRotationMatrix();
+    _haptic_controller_left =
+		make_shared<Sai2Primitives::HapticDeviceController>(
+			device_limits_left, _robot->transformInWorld(_link_names[0]), device_home_pose, _left_device_base_rotation_in_world);
+	_haptic_controller_left->setScalingFactors(3.5);
+	_haptic_controller_left->setReductionFactorForce(0.1);
+	_haptic_controller_left->setHapticControlType(Sai2Primitives::HapticControlType::HOMING);
+	_haptic_controller_left->disableOrientationTeleop();
+	_haptic_controller_left->setVariableDampingGainsPos(vector<double>{0.05, 0.15}, vector<double>{10, 40});
+	
+	Sai2Primitives::HapticDeviceController::DeviceLimits device_limits_right(
+		_device_limits[1].max_stiffness, _device_limits[1].max_damping, _device_limits[1].max_force);
+	_right_device_base_rotation_in_world = AngleAxisd(M_PI, Vector3d::UnitZ()).toRotationMatrix();
+    _haptic_controller_right =
+		make_shared<Sai2Primitives::HapticDeviceController>(
+			device_limits_right, _robot->transformInWorld(_link_names[1]), device_home_pose, _right_device_base_rotation_in_world);
+	_haptic_controller_right->setScalingFactors(3.5);
+	_haptic_controller_right->setReductionFactorForce(0.1);
+	_haptic_controller_right->setHapticControlType(Sai2Primitives::HapticControlType::HOMING);
+	_haptic_controller_right->disableOrientationTeleop();
+	_haptic_controller_right->setVariableDampingGainsPos(vector<double>{0.05, 0.15}, vector<double>{10, 40});
+
+	Vector3d leftHandRef = _robot->position("endEffector_left", Vector3d(0, 0, 0));
+	Vector3d rightHandRef = _robot->position("endEffector_right", Vector3d(0, 0, 0));
+	_handReference = leftHandRef - rightHandRef; //Initialize hand reference vector
+	
+	_handDifference = leftHandRef - rightHandRef; //Initialize hand difference vector
+
+	int k = 0;
+
+	_endEffectorPosSum = Vector3d(0, 0, 0);
+
+    for (auto name : _control_links) {
+        _endEffectorPosSum += _robot->position(_control_links[k], _control_points[k]);
+        ++k;
+    }
+
+	_endEffectorPosAverage = _endEffectorPosSum/2;
+
+    const std::vector<Vector3d> body_control_point = {Vector3d(0, 0, 0)};
+
+	Vector3d initialBodyPosition;
+	initialBodyPosition = Vector3d(_robot->position(_body_control_link, body_control_point[0]));
+
+	Vector3d endEffectorToBodyDistance;
+	endEffectorToBodyDistance = _endEffectorPosAverage - initialBodyPosition; //Distance between end effectors and body position
+
+	_goalBodyPosition = _endEffectorPosAverage - endEffectorToBodyDistance; //Initialize goal body position
+	_goalBodyOrientation.setZero();
+
+    for (int i = 0; i < _control_links.size(); ++i) {        
+        Affine3d compliant_frame = Affine3d::Identity();
+        compliant_frame.translation() = _control_points[i];
+        _pose_tasks[_control_links[i]] = std::make_shared<Sai2Primitives::MotionForceTask>(_robot, _control_links[i], compliant_frame);
+        _pose_tasks[_control_links[i]]->disableInternalOtg();
+        _pose_tasks[_control_links[i]]->setDynamicDecouplingType(Sai2Primitives::FULL_DYNAMIC_DECOUPLING);
+        _pose_tasks[_control_links[i]]->setPosControlGains(400, 40, 0);
+        _pose_tasks[_control_links[i]]->setOriControlGains(400, 40, 0);
+    }
+
+    // base partial joint task 
+    int num_base_joints = 6;
+	MatrixXd base_selection_matrix = MatrixXd::Zero(num_base_joints, _robot->dof());
+	base_selection_matrix.block(0, 0, num_base_joints, num_base_joints).setIdentity();
+    cout << base_selection_matrix << endl;
+	_base_task = std::make_shared<Sai2Primitives::JointTask>(_robot, base_selection_matrix);
+	// same base task as the fixed size core
+	_base_task->disableInternalOtg();
+	_base_task->setDynamicDecouplingType(Sai2Primitives::FULL_DYNAMIC_DECOUPLING);
+	_base_task->setGains(400, 40, 0);
+
+	_q_desired = _robot->q();
+
+	// dual arm partial joint task 
+    int num_arm_joints = 14;
+	MatrixXd arms_selection_matrix = MatrixXd::Zero(num_arm_joints, _robot->dof());
+	arms_selection_matrix.block(0, 6, num_arm_joints, num_arm_joints).setIdentity();
+    cout << arms_selection_matrix << endl;
+	_arms_posture_task = std::make_shared<Sai2Primitives::JointTask>(_robot, arms_selection_matrix);
+	_arms_posture_task->setGains(400, 40, 0); 
+
+#ifdef OCEAN1_FIXED_DOF
+	_robot_supported = dof == OCEAN1_FIXED_DOF && num_base_joints + num_arm_joints == dof;
+#endif
+
+	// per tick buffers, and handles on the tasks so that the tick does not
+	// build strings for the map lookups
+	_workspace = std::make_unique<ControllerWorkspace>(_control_links.size(), dof);
+	_left_pose_task = _pose_tasks[_control_links[0]];
+	_right_pose_task = _pose_tasks[_control_links[1]];
+
+	// the end effector Jacobians only depend on the base and on their own
+	// arm, so the pose task nullspace can skip the other arm's columns
+	for (int i = 0; i < _control_links.size(); ++i) {
+		_workspace->J_pose_tasks.block(6 * i, 0, 6, dof) = _robot->J(_control_links[i], _control_points[i]);
+	}
+	_workspace->tree_structure = TreeNullspaceWorkspace<6, 7, 2>::Tree::hasTreeStructure(_workspace->J_pose_tasks);
+	cout << "pose task nullspace: " << (_workspace->tree_structure ? "block sparse" : "dense") << endl;
+#ifdef OCEAN1_FIXED_DOF
+	_core.block_sparse = _robot_supported && FixedCore::Tree::hasTreeStructure(_workspace->J_pose_tasks);
+#endif
+
+	// get starting poses
+    _starting_pose.clear();
+    for (int i = 0; i < _control_links.size(); ++i) {
+        Affine3d current_pose;
+        current_pose.translation() = _robot->position(_control_links[i], _control_points[i]);
+        current_pose.linear() = _robot->rotation(_control_links[i]);
+        _starting_pose.push_back(current_pose);
+    }
+
+	_state = POSTURE;
+	_prev_time = 0.0;
+}
+
+const VectorXd& Ocean1Controller::step(const SimState& sim_state, double time) {
+	_robot->setQ(sim_state.q);
+	_robot->setDq(sim_state.dq);
+	{
+		OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_model);
+		_robot->updateModel();
+	}
+
+	Matrix3d body_rotation_in_world = _robot->rotationInWorld(_body_control_link);
+
+	// robot_controller->updateControllerTaskModels();
+
+    // compute haptic control
+	_haptic_input_left.robot_position = _robot->positionInWorld(_link_names[0]);
+	_haptic_input_left.robot_orientation = _robot->rotationInWorld(_link_names[0]);
+	_haptic_input_left.robot_linear_velocity =
+		_robot->linearVelocityInWorld(_link_names[0]);
+	_haptic_input_left.robot_angular_velocity =
+		_robot->angularVelocityInWorld(_link_names[0]);
+	_haptic_input_left.robot_sensed_force = sim_state.force_left;
+	{
+		OCEAN1_PROFILE_SCOPE(_profiler, _phase_haptic_control);
+		_haptic_output_left = _haptic_controller_left->computeHapticControl(_haptic_input_left);
+	}
+
+	_haptic_input_right.robot_position = _robot->positionInWorld(_link_names[1]);
+	_haptic_input_right.robot_orientation = _robot->rotationInWorld(_link_names[1]);
+	_haptic_input_right.robot_linear_velocity =
+		_robot->linearVelocityInWorld(_link_names[1]);
+	_haptic_input_right.robot_angular_velocity =
+		_robot->angularVelocityInWorld(_link_names[1]);
+	_haptic_input_right.robot_sensed_force = sim_state.force_right;
+	{
+		OCEAN1_PROFILE_SCOPE(_profiler, _phase_haptic_control);
+		_haptic_output_right = _haptic_controller_right->computeHapticControl(_haptic_input_right);
+	}
+
+	if (_state == POSTURE) {
+		// update task model 
+		_N_prec.setIdentity();
+		_arms_posture_task->updateTaskModel(_N_prec);
+
+		_command_torques = _arms_posture_task->computeTorques();
+
+		if ((_robot->q() - _q_desired).norm() < 1e-2) {
+			cout << "Posture To Motion" << endl;
+			for (const auto& name : _control_links) {
+				_pose_tasks[name]->reInitializeTask();
+			}
+			_arms_posture_task->reInitializeTask();
+#ifdef OCEAN1_FIXED_DOF
+			{
+				OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_task_model);
+				updateCoreModel(_core, *_robot, _control_links, _control_points);
+			}
+			_core.reInitialize();
+#endif
+
+			_state = MOTION;
+		}
+	} else if (_state == MOTION) {
+        // update body task model
+        //NEW CODE
+        int j = 0;
+        _endEffectorPosSum = Vector3d(0, 0, 0);
+        for (const auto& name : _control_links) {
+            _endEffectorPosSum += (_robot->position(_control_links[j], _control_points[j]));
+            ++j;
+        }
+        _endEffectorPosAverage = _endEffectorPosSum / 2.;
+        if (_console_rate.ready(time)) {
+            cout << _endEffectorPosAverage.transpose() << endl;
+        }
+        j = 0;
+        auto ref_vec = Vector3d(0.9, 0.15, 0.6);
+        for (auto ee_pos : _endEffectorPosAverage){
+            if (abs(ee_pos) >= ref_vec[j]){
+                _goalBodyPosition[j] += 0.01 * (ee_pos - ((ee_pos / abs(ee_pos)) * ref_vec[j]));
+            }
+            ++j;
+        }
+        // if (((_endEffectorPosAverage).cwiseAbs().array() >= 
+        //     Vector3d(0.2, 0.2, 0.2).array()).any()){
+        //     cout << "here" << endl;
+        // }
+        //Calculate the body position as the end effector location minus some offset
+        _leftHandPos = _robot->position(_control_links[0], _control_points[0]);
+        _rightHandPos = _robot->position(_control_links[1], _control_points[1]);
+        _handDifference = _leftHandPos - _rightHandPos; //Get vector between end effectors
+        _goalBodyOrientation = calculate_rotations(_handDifference, _handReference); //Calculate the angle between the reference vector between end effectors and the current one
+        //END NEW CODE
+
+#ifdef OCEAN1_FIXED_DOF
+		// the whole task hierarchy (base, pose and arm posture tasks and
+		// coriolis compensation) in the fixed size core
+		{
+			OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_task_model);
+			updateCoreModel(_core, *_robot, _control_links, _control_points);
+		}
+		_core.base_goal << _goalBodyPosition[0], _goalBodyPosition[1], _goalBodyPosition[2], _goalBodyOrientation[2], 0, _goalBodyOrientation[0];
+		_core.end_effectors[0].goal_position = _core.baseCurrentPosition().head<3>()
+			+ _core.end_effectors[0].position
+			+ _left_device_base_rotation_in_world * _haptic_input_left.device_position * (time - _prev_time) * KS;
+		_core.end_effectors[1].goal_position = _core.baseCurrentPosition().head<3>()
+			+ _core.end_effectors[1].position
+			+ _right_device_base_rotation_in_world * _haptic_input_right.device_position * (time - _prev_time) * KS;
+		{
+			OCEAN1_PROFILE_SCOPE(_profiler, _phase_compute_torques);
+			_command_torques = _core.computeTorques();
+		}
+#else
+        _N_prec.setIdentity();
+		
+        {
+            OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_task_model);
+            _base_task->updateTaskModel(_N_prec); //base task is set to identity meaning its highest priority
+        }
+        _N_prec = _base_task->getTaskAndPreviousNullspace(); //Everything that uses N_prec is lower priority
+
+		_base_task->setGoalPosition(Vector6d(_goalBodyPosition[0], _goalBodyPosition[1], _goalBodyPosition[2], _goalBodyOrientation[2], 0, _goalBodyOrientation[0])); 
+
+        // update pose task models
+        for (auto it = _pose_tasks.begin(); it != _pose_tasks.end(); ++it) {
+            {
+                OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_task_model);
+                it->second->updateTaskModel(_N_prec); //updates task to be in nullspace of previous tasks??
+            }
+            // _N_prec = it->second->getTaskAndPreviousNullspace(); //should this be activated?
+        }
+
+        // get pose task Jacobian stack 
+        {
+            OCEAN1_PROFILE_SCOPE(_profiler, _phase_nullspace);
+            for (int i = 0; i < _control_links.size(); ++i) {
+                _workspace->J_pose_tasks.block(6 * i, 0, 6, _robot->dof()) = _robot->J(_control_links[i], _control_points[i]);
+            }        
+            if (!_workspace->tree_structure ||
+                !_workspace->tree_nullspace.compute(_workspace->J_pose_tasks, _robot->MInv(), _N_prec)) {
+                _workspace->nullspace.compute(_workspace->J_pose_tasks, _robot->MInv(), _N_prec);
+            }
+        }
+            
+        // redundancy completion
+        {
+            OCEAN1_PROFILE_SCOPE(_profiler, _phase_update_task_model);
+            _arms_posture_task->updateTaskModel(_N_prec); //updates task to be in null space of previous task
+        }
+
+        // -------- set task goals and compute control torques
+        _command_torques.setZero(); //set the command torques equal to 0
+
+        // base task
+        {
+            OCEAN1_PROFILE_SCOPE(_profiler, _phase_compute_torques);
+            _command_torques += _base_task->computeTorques(); //set the command torques of the base task
+        }
+
+
+        // pose tasks. Alternative goals, for the pose task of the control
+        // link name of index i:
+		//Y-Z sinusoidal position
+		//_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0, (-0.2 * cos(M_PI * time)), (0.2 * sin(M_PI * time))));
+
+		//X-Z sinusoidal position
+		//_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d((-0.2 * cos(M_PI * time)), 0, (0.2 * sin(M_PI * time))));
+
+		//X-Y sinusoidal position
+		//_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d((-0.2 * cos(M_PI * time)), (0.2 * sin(M_PI * time)), 0));
+
+		//Yaw rotation
+		// if (name == "endEffector_left") {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0.1, 0, 0));
+		// } else {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(-0.1, 0, 0));
+		// }
+
+		//Roll rotation
+		// if (name == "endEffector_left") {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0, 0, -0.1));
+		// } else {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0, 0, 0.1));
+		// }
+
+		//Yaw sinusoidal rotation
+		// if (name == "endEffector_left") {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d((0.1 * sin(M_PI * time)), 0, 0));
+		// } else {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(-(0.1 * sin(M_PI * time)), 0, 0));
+		// }
+
+		//Roll sinusoidal rotation
+		// if (name == "endEffector_left") {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0, 0, -(0.1 * sin(M_PI * time))));
+		// } else {
+		// 	_pose_tasks[name]->setGoalPosition(_starting_pose[i].translation() + Vector3d(0, 0, (0.1 * sin(M_PI * time))));
+		// }
+
+		// pose tasks
+		auto diff = _haptic_output_left.robot_goal_position - _left_pose_task->getCurrentPosition();
+
+		_left_pose_task->setGoalPosition(
+			_base_task->getCurrentPosition()
+			+ _robot->position(_control_links[0], _control_points[0])
+			// + _left_pose_task->getCurrentPosition()
+			+ _left_device_base_rotation_in_world * _haptic_input_left.device_position * (time - _prev_time) * KS
+			// _haptic_output_left.robot_current_position - prev_left_goal_position + _haptic_output_left.robot_goal_position * (time - _prev_time) * KS
+			// curr_haptic_position_left + (_haptic_output_left.robot_goal_position - haptic_init_position_left)
+		);
+		{
+			OCEAN1_PROFILE_SCOPE(_profiler, _phase_compute_torques);
+			_command_torques += _left_pose_task->computeTorques();
+		}
+
+		auto diff_right = _haptic_output_right.robot_goal_position - _right_pose_task->getCurrentPosition();
+		_right_pose_task->setGoalPosition(
+			_base_task->getCurrentPosition()
+			+ _robot->position(_control_links[1], _control_points[1])
+			// + _haptic_output_right.robot_goal_position
+			// + _right_pose_task->getCurrentPosition()
+			+ _right_device_base_rotation_in_world * _haptic_input_right.device_position * (time - _prev_time) * KS
+			// + _haptic_input_left.R_world_to_haptic_frame * _haptic_input_right.device_position * (time - _prev_time) * KS;
+			// _right_pose_task->getCurrentPosition() - prev_right_goal_position + _haptic_output_right.robot_goal_position * (time - _prev_time) * KS
+			// curr_haptic_position_right + (_haptic_output_right.robot_goal_position - haptic_init_position_right)
+		);
+		auto curr_haptic_position_left = _left_pose_task->getCurrentPosition();
+		auto curr_haptic_position_right = _right_pose_task->getCurrentPosition();
+		{
+			OCEAN1_PROFILE_SCOPE(_profiler, _phase_compute_torques);
+			_command_torques += _right_pose_task->computeTorques();
+		}
+#endif
+
+		// _state machine for button presses
+		if (_haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::HOMING) {
+			_haptic_controller_left->setHapticControlType(Sai2Primitives::HapticControlType::MOTION_MOTION);
+			_haptic_controller_left->setDeviceControlGains(350.0, 15.0);
+		}
+
+		if (_haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::HOMING) {
+			_haptic_controller_right->setHapticControlType(Sai2Primitives::HapticControlType::MOTION_MOTION);
+			_haptic_controller_right->setDeviceControlGains(350.0, 15.0);
+		}
+		// clutch
+		if (_haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::MOTION_MOTION && _haptic_button_is_pressed && !_haptic_button_was_pressed) {
+			_haptic_controller_left->setHapticControlType(
+				Sai2Primitives::HapticControlType::CLUTCH
+			);
+		} else if (_haptic_controller_left->getHapticControlType() == Sai2Primitives::HapticControlType::CLUTCH && !_haptic_button_is_pressed && _haptic_button_was_pressed) {
+			_haptic_controller_left->setHapticControlType(
+				Sai2Primitives::HapticControlType::MOTION_MOTION
+			);
+		}
+		if (_haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::MOTION_MOTION && _haptic_button_is_pressed && !_haptic_button_was_pressed) {
+			_haptic_controller_right->setHapticControlType(
+				Sai2Primitives::HapticControlType::CLUTCH
+			);
+		} else if (_haptic_controller_right->getHapticControlType() == Sai2Primitives::HapticControlType::CLUTCH && !_haptic_button_is_pressed && _haptic_button_was_pressed) {
+			_haptic_controller_right->setHapticControlType(
+				Sai2Primitives::HapticControlType::MOTION_MOTION
+			);
+		}
+
+#ifndef OCEAN1_FIXED_DOF
+		// posture task and coriolis compensation
+		{
+			OCEAN1_PROFILE_SCOPE(_profiler, _phase_compute_torques);
+			_command_torques += _arms_posture_task->computeTorques() + _robot->coriolisForce();
+		}
+#endif
+	}
+
+	_prev_time = time;
+	return _command_torques;
+}
+
+}  // namespace Ocean1
+
+// entry point of the plugin library, see controller_plugin.h
+extern "C" Ocean1::ControllerPlugin* ocean1CreateControllerPlugin() {
+	return new Ocean1::Ocean1Controller();
+}
@@ -0,0 +1,173 @@
+/**
+ * @file ocean1_controller.h
+ * @brief Controller of ocean1: base joint task, haptic teleoperated end
+ * effector pose tasks and arm posture task. Built as the ocean1_controller
+ * shared library, hosted either by controller_ocean1 (over redis or shared
+ * memory) or directly by simviz_ocean1 (see controller_plugin.h).
+ *
+ * The controller_ocean1_fixed build defines OCEAN1_FIXED_DOF for the library
+ * and its host, and computes the MOTION state with the fixed size core of
+ * controller_core.h.
+ *
+ */
+
+#ifndef OCEAN1_OCEAN1_CONTROLLER_H
+#define OCEAN1_OCEAN1_CONTROLLER_H
+
+#include <Sai2Model.h>
+
+#include <Eigen/Dense>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Sai2Primitives.h"
+#include "controller_plugin.h"
+#include "controller_workspace.h"
+#include "phase_profiler.h"
+#include "telemetry_logger.h"
+#ifdef OCEAN1_FIXED_DOF
+#include "controller_core.h"
+#endif
+
+namespace Ocean1 {
+
+/**
+ * @brief limits of a haptic device, as published by the chai haptic devices
+ * driver. Each vector holds the linear and angular values.
+ */
+struct HapticDeviceLimits {
+	Eigen::Vector2d max_stiffness = Eigen::Vector2d(1000.0, 10.0);
+	Eigen::Vector2d max_damping = Eigen::Vector2d(10.0, 0.1);
+	Eigen::Vector2d max_force = Eigen::Vector2d(8.0, 0.5);
+};
+
+class Ocean1Controller : public ControllerPlugin {
+public:
+	static constexpr int NUM_HAPTIC_DEVICES = 2;
+
+#ifdef OCEAN1_FIXED_DOF
+	// 6 base joints and two end effectors
+	using FixedCore = ControllerCore<OCEAN1_FIXED_DOF, 6, 2>;
+#endif
+
+	/**
+	 * @param device_limits limits of the left and right haptic devices. The
+	 * defaults are used when no device driver runs.
+	 */
+	explicit Ocean1Controller(
+		const std::vector<HapticDeviceLimits>& device_limits =
+			std::vector<HapticDeviceLimits>(NUM_HAPTIC_DEVICES));
+
+	void init(std::shared_ptr<Sai2Model::Sai2Model> robot) override;
+	const Eigen::VectorXd& step(const SimState& sim_state,
+								double time) override;
+
+	/**
+	 * @brief device side buffers of the haptic controllers, for the host to
+	 * exchange with the device drivers. The device inputs are read by step,
+	 * the outputs are written by step.
+	 */
+	Sai2Primitives::HapticControllerInput& hapticInput(int device) {
+		return device == 0 ? _haptic_input_left : _haptic_input_right;
+	}
+	Sai2Primitives::HapticControllerOtuput& hapticOutput(int device) {
+		return device == 0 ? _haptic_output_left : _haptic_output_right;
+	}
+	// state of the device switches (both devices write the same value)
+	int& hapticButtonPressed() { return _haptic_button_is_pressed; }
+
+	bool inMotion() const { return _state == MOTION; }
+	const Eigen::Vector3d& goalBodyPosition() const {
+		return _goalBodyPosition;
+	}
+	const Eigen::Vector3d& goalBodyOrientation() const {
+		return _goalBodyOrientation;
+	}
+
+	/**
+	 * @brief profiler of the tick phases. The host can add its own phases
+	 * (reading the state, publication) before the first step.
+	 */
+	PhaseProfiler& profiler() { return _profiler; }
+
+	/**
+	 * @brief false if the robot does not match the compile time sizes of the
+	 * fixed size build, always true otherwise. To be checked after init.
+	 */
+	bool robotSupported() const { return _robot_supported; }
+
+private:
+	enum State { POSTURE = 0, MOTION };
+
+	std::vector<HapticDeviceLimits> _device_limits;
+	std::shared_ptr<Sai2Model::Sai2Model> _robot;
+	bool _robot_supported;
+	State _state;
+
+	const std::vector<std::string> _link_names = {"endEffector_left",
+												  "endEffector_right"};
+	const std::vector<std::string> _control_links = {"endEffector_left",
+													 "endEffector_right"};
+	const std::vector<Eigen::Vector3d> _control_points = {
+		Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(0, 0, 0)};
+	const std::string _body_control_link = "Body";
+
+	Eigen::VectorXd _command_torques;
+	Eigen::MatrixXd _N_prec;
+
+	// haptic controllers
+	bool _haptic_button_was_pressed;
+	int _haptic_button_is_pressed;
+	Eigen::Matrix3d _left_device_base_rotation_in_world;
+	Eigen::Matrix3d _right_device_base_rotation_in_world;
+	std::shared_ptr<Sai2Primitives::HapticDeviceController>
+		_haptic_controller_left;
+	std::shared_ptr<Sai2Primitives::HapticDeviceController>
+		_haptic_controller_right;
+	Sai2Primitives::HapticControllerInput _haptic_input_left;
+	Sai2Primitives::HapticControllerOtuput _haptic_output_left;
+	Sai2Primitives::HapticControllerInput _haptic_input_right;
+	Sai2Primitives::HapticControllerOtuput _haptic_output_right;
+
+	// tasks
+	std::map<std::string, std::shared_ptr<Sai2Primitives::MotionForceTask>>
+		_pose_tasks;
+	std::shared_ptr<Sai2Primitives::MotionForceTask> _left_pose_task;
+	std::shared_ptr<Sai2Primitives::MotionForceTask> _right_pose_task;
+	std::shared_ptr<Sai2Primitives::JointTask> _base_task;
+	std::shared_ptr<Sai2Primitives::JointTask> _arms_posture_task;
+	Eigen::VectorXd _q_desired;
+	std::vector<Eigen::Affine3d> _starting_pose;
+
+	// body goal from the end effector positions
+	Eigen::Vector3d _handReference;
+	Eigen::Vector3d _leftHandPos;
+	Eigen::Vector3d _rightHandPos;
+	Eigen::Vector3d _handDifference;
+	Eigen::Vector3d _goalBodyOrientation;
+	Eigen::Vector3d _goalBodyPosition;
+	Eigen::Vector3d _endEffectorPosSum;
+	Eigen::Vector3d _endEffectorPosAverage;
+
+	double _prev_time;
+	std::unique_ptr<ControllerWorkspace> _workspace;
+#ifdef OCEAN1_FIXED_DOF
+	FixedCore _core;
+#endif
+
+	// console output is limited to a few lines per second
+	RateLimiter _console_rate;
+
+	PhaseProfiler _profiler;
+	int _phase_update_model;
+	int _phase_haptic_control;
+	int _phase_update_task_model;
+	int _phase_nullspace;
+	int _phase_compute_torques;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_OCEAN1_CONTROLLER_H
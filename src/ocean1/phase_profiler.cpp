@@ -0,0 +1,135 @@
+/**
+ * @file phase_profiler.cpp
+ * @brief Per phase HDR histograms of the control loop
+ *
+ */
+
+#include "phase_profiler.h"
+
+#include <signal.h>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Ocean1 {
+
+namespace {
+
+volatile sig_atomic_t print_requested = 0;
+
+void requestPrint(int) { print_requested = 1; }
+
+int highestBit(uint64_t value) { return 63 - __builtin_clzll(value); }
+
+}  // namespace
+
+HdrHistogram::HdrHistogram()
+	: _buckets(2 * SUB_BUCKETS + MAX_SHIFT * SUB_BUCKETS, 0) {
+	reset();
+}
+
+int HdrHistogram::bucketIndex(uint64_t value) {
+	// values below 2 * SUB_BUCKETS have their own bucket, above that each
+	// power of two is split in SUB_BUCKETS buckets
+	if (value < 2 * SUB_BUCKETS) {
+		return (int)value;
+	}
+	const int shift = std::min(highestBit(value) - SUB_BUCKET_BITS, MAX_SHIFT);
+	const uint64_t mantissa =
+		std::min<uint64_t>(value >> shift, 2 * SUB_BUCKETS - 1);
+	return 2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS +
+		   (int)(mantissa - SUB_BUCKETS);
+}
+
+uint64_t HdrHistogram::bucketUpperBound(int index) {
+	if (index < 2 * SUB_BUCKETS) {
+		return index;
+	}
+	const int shift = (index - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+	const uint64_t mantissa = (index - 2 * SUB_BUCKETS) % SUB_BUCKETS +
+							  SUB_BUCKETS;
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void HdrHistogram::record(uint64_t value_ns) {
+	++_buckets[bucketIndex(value_ns)];
+	++_count;
+	_sum += value_ns;
+	_min = std::min(_min, value_ns);
+	_max = std::max(_max, value_ns);
+}
+
+uint64_t HdrHistogram::percentile(double fraction) const {
+	const uint64_t target = (uint64_t)(fraction * _count);
+	uint64_t count = 0;
+	for (size_t i = 0; i < _buckets.size(); ++i) {
+		count += _buckets[i];
+		if (count > target) {
+			return std::min(bucketUpperBound(i), _max);
+		}
+	}
+	return _max;
+}
+
+void HdrHistogram::reset() {
+	std::fill(_buckets.begin(), _buckets.end(), 0);
+	_count = 0;
+	_sum = 0;
+	_min = UINT64_MAX;
+	_max = 0;
+}
+
+int PhaseProfiler::addPhase(const std::string& name) {
+	_names.push_back(name);
+	_histograms.emplace_back();
+	_tick_ns.push_back(0);
+	_touched.push_back(false);
+	return _names.size() - 1;
+}
+
+void PhaseProfiler::endTick() {
+	for (size_t i = 0; i < _names.size(); ++i) {
+		if (_touched[i]) {
+			_histograms[i].record(_tick_ns[i]);
+			_tick_ns[i] = 0;
+			_touched[i] = false;
+		}
+	}
+}
+
+void PhaseProfiler::printInfo(std::ostream& os) const {
+#ifndef OCEAN1_ENABLE_PROFILING
+	os << "phase profiling is disabled, build with "
+		  "-DOCEAN1_ENABLE_PROFILING=ON\n";
+	return;
+#endif
+	const auto flags = os.flags();
+	os << std::fixed << std::setprecision(1);
+	os << std::setw(20) << std::left << "phase (us)" << std::right
+	   << std::setw(10) << "count" << std::setw(9) << "mean" << std::setw(9)
+	   << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99"
+	   << std::setw(9) << "p99.9" << std::setw(9) << "max" << "\n";
+	for (size_t i = 0; i < _names.size(); ++i) {
+		const auto& h = _histograms[i];
+		os << std::setw(20) << std::left << _names[i] << std::right
+		   << std::setw(10) << h.count() << std::setw(9) << 1e-3 * h.mean()
+		   << std::setw(9) << 1e-3 * h.percentile(0.5) << std::setw(9)
+		   << 1e-3 * h.percentile(0.9) << std::setw(9)
+		   << 1e-3 * h.percentile(0.99) << std::setw(9)
+		   << 1e-3 * h.percentile(0.999) << std::setw(9) << 1e-3 * h.max()
+		   << "\n";
+	}
+	os.flags(flags);
+}
+
+void PhaseProfiler::printInfoIfRequested(std::ostream& os) {
+	if (!print_requested) {
+		return;
+	}
+	print_requested = 0;
+	printInfo(os);
+}
+
+void PhaseProfiler::installSignalHandler() { signal(SIGUSR1, &requestPrint); }
+
+}  // namespace Ocean1
@@ -0,0 +1,161 @@
+/**
+ * @file phase_profiler.h
+ * @brief Per phase timing of the control loop. Each tick, the time spent in
+ * each phase is accumulated by scoped timers, then recorded in a per phase
+ * HDR (high dynamic range) histogram. The histograms can be printed on
+ * SIGUSR1 and at shutdown.
+ *
+ * The timers are only compiled in when OCEAN1_ENABLE_PROFILING is defined
+ * (cmake -DOCEAN1_ENABLE_PROFILING=ON). Otherwise OCEAN1_PROFILE_SCOPE expands
+ * to nothing and the profiler stays empty.
+ *
+ */
+
+#ifndef OCEAN1_PHASE_PROFILER_H
+#define OCEAN1_PHASE_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Ocean1 {
+
+/**
+ * @brief Histogram of nanosecond durations with log linear buckets: exact
+ * below 64 ns, then 32 buckets per power of two (about 3% relative error).
+ * The memory is allocated once in the constructor.
+ *
+ */
+class HdrHistogram {
+public:
+	HdrHistogram();
+
+	void record(uint64_t value_ns);
+
+	uint64_t count() const { return _count; }
+	uint64_t min() const { return _count ? _min : 0; }
+	uint64_t max() const { return _max; }
+	double mean() const { return _count ? (double)_sum / _count : 0.0; }
+
+	/**
+	 * @brief upper bound of the value below which fraction of the recorded
+	 * values fall
+	 */
+	uint64_t percentile(double fraction) const;
+
+	void reset();
+
+private:
+	static constexpr int SUB_BUCKET_BITS = 5;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_SHIFT = 42;  // up to about a day
+
+	static int bucketIndex(uint64_t value);
+	static uint64_t bucketUpperBound(int index);
+
+	std::vector<uint64_t> _buckets;
+	uint64_t _count;
+	uint64_t _sum;
+	uint64_t _min;
+	uint64_t _max;
+};
+
+/**
+ * @brief Set of named phases with one histogram each
+ *
+ */
+class PhaseProfiler {
+public:
+	PhaseProfiler() = default;
+
+	/**
+	 * @brief register a phase, to be done before the loop
+	 *
+	 * @return id of the phase for the scoped timers
+	 */
+	int addPhase(const std::string& name);
+
+	/**
+	 * @brief add a duration to the current tick of a phase. A phase can be
+	 * timed several times in a tick, the durations add up.
+	 */
+	void accumulate(int phase, uint64_t duration_ns) {
+		_tick_ns[phase] += duration_ns;
+		_touched[phase] = true;
+	}
+
+	/**
+	 * @brief record the phases timed during the tick in their histograms
+	 */
+	void endTick();
+
+	/**
+	 * @brief print count, mean, percentiles and max of each phase in
+	 * microseconds
+	 */
+	void printInfo(std::ostream& os) const;
+
+	/**
+	 * @brief print the histograms if SIGUSR1 was received since the last
+	 * call. To be called from the loop, outside of the timed phases.
+	 */
+	void printInfoIfRequested(std::ostream& os);
+
+	/**
+	 * @brief install the SIGUSR1 handler requesting a print
+	 */
+	static void installSignalHandler();
+
+private:
+	std::vector<std::string> _names;
+	std::vector<HdrHistogram> _histograms;
+	std::vector<uint64_t> _tick_ns;
+	std::vector<bool> _touched;
+};
+
+/**
+ * @brief adds the time between its construction and destruction to a phase
+ *
+ */
+class ScopedPhaseTimer {
+public:
+	ScopedPhaseTimer(PhaseProfiler& profiler, int phase)
+		: _profiler(profiler),
+		  _phase(phase),
+		  _start(std::chrono::steady_clock::now()) {}
+
+	~ScopedPhaseTimer() {
+		_profiler.accumulate(
+			_phase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now() - _start)
+						.count());
+	}
+
+	ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+	ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+	PhaseProfiler& _profiler;
+	int _phase;
+	std::chrono::steady_clock::time_point _start;
+};
+
+}  // namespace Ocean1
+
+#define OCEAN1_PROFILE_CONCAT_INNER(a, b) a##b
+#define OCEAN1_PROFILE_CONCAT(a, b) OCEAN1_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef OCEAN1_ENABLE_PROFILING
+// time the rest of the enclosing scope as the given phase
+#define OCEAN1_PROFILE_SCOPE(profiler, phase)                      \
+	Ocean1::ScopedPhaseTimer OCEAN1_PROFILE_CONCAT(phase_timer_, \
+												   __LINE__)(profiler, phase)
+#define OCEAN1_PROFILE_END_TICK(profiler) (profiler).endTick()
+#else
+#define OCEAN1_PROFILE_SCOPE(profiler, phase)
+#define OCEAN1_PROFILE_END_TICK(profiler)
+#endif
+
+#endif	// OCEAN1_PHASE_PROFILER_H
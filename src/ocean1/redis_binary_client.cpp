@@ -0,0 +1,344 @@
+/**
+ * @file redis_binary_client.cpp
+ * @brief Small hiredis client for binary safe values and pipelined groups
+ *
+ */
+
+#include "redis_binary_client.h"
+
+#include <poll.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "eigen_wire.h"
+
+namespace Ocean1 {
+
+void RedisBinaryClient::connect(const std::string& hostname, const int port) {
+	_context.reset(redisConnect(hostname.c_str(), port));
+	if (!_context || _context->err) {
+		const std::string error =
+			_context ? _context->errstr : "could not allocate redis context";
+		_context.reset();
+		throw std::runtime_error("RedisBinaryClient: " + error);
+	}
+	_pending_replies = 0;
+}
+
+RedisBinaryClient::ReplyPtr RedisBinaryClient::command(const char* format,
+														...) {
+	if (!_context) {
+		throw std::runtime_error("RedisBinaryClient: not connected");
+	}
+	// keep the replies in order
+	flushPendingReplies();
+	va_list args;
+	va_start(args, format);
+	ReplyPtr reply(
+		static_cast<redisReply*>(redisvCommand(_context.get(), format, args)));
+	va_end(args);
+	if (!reply) {
+		throw std::runtime_error(std::string("RedisBinaryClient: ") +
+								 _context->errstr);
+	}
+	if (reply->type == REDIS_REPLY_ERROR) {
+		throw std::runtime_error(std::string("RedisBinaryClient: ") +
+								 reply->str);
+	}
+	return reply;
+}
+
+void RedisBinaryClient::setBinary(const std::string& key,
+								  const std::string& value) {
+	command("SET %b %b", key.data(), key.size(), value.data(), value.size());
+}
+
+void RedisBinaryClient::setEigenBinary(
+	const std::string& key, const Eigen::Ref<const Eigen::MatrixXd>& value,
+	uint64_t seq) {
+	encodeEigenWire(value, seq, _encode_buffer);
+	setBinary(key, _encode_buffer);
+}
+
+bool RedisBinaryClient::getEigenBinary(const std::string& key,
+									   Eigen::Ref<Eigen::MatrixXd> out,
+									   uint64_t* seq) {
+	auto reply = command("GET %b", key.data(), key.size());
+	if (reply->type != REDIS_REPLY_STRING) {
+		return false;
+	}
+	return decodeEigenWire(reply->str, reply->len, out, seq);
+}
+
+void RedisBinaryClient::addMatrixEntry(std::vector<GroupEntry>& entries,
+									   const std::string& key, double* data,
+									   int rows, int cols, WireCodec codec,
+									   uint64_t* seq) {
+	GroupEntry entry;
+	entry.key = key;
+	entry.codec = codec;
+	entry.matrix_data = data;
+	entry.rows = rows;
+	entry.cols = cols;
+	entry.seq = seq;
+	entries.push_back(entry);
+}
+
+void RedisBinaryClient::addToReceiveGroup(const std::string& key, int& object,
+										  const std::string& group_name) {
+	GroupEntry entry;
+	entry.key = key;
+	entry.codec = WireCodec::TEXT;
+	entry.int_data = &object;
+	_groups[group_name].receive_entries.push_back(entry);
+}
+
+void RedisBinaryClient::addToSendGroup(const std::string& key,
+									   const int& object,
+									   const std::string& group_name) {
+	GroupEntry entry;
+	entry.key = key;
+	entry.codec = WireCodec::TEXT;
+	entry.int_data = const_cast<int*>(&object);
+	_groups[group_name].send_entries.push_back(entry);
+}
+
+RedisBinaryClient::Group& RedisBinaryClient::findGroup(
+	const std::string& group_name) {
+	auto it = _groups.find(group_name);
+	if (it == _groups.end()) {
+		throw std::invalid_argument("RedisBinaryClient: group " + group_name +
+									" does not exist");
+	}
+	if (!_context) {
+		throw std::runtime_error("RedisBinaryClient: not connected");
+	}
+	return it->second;
+}
+
+void RedisBinaryClient::appendSend(Group& group, uint64_t seq) {
+	if (group.send_entries.empty()) {
+		return;
+	}
+	// the argument arrays keep their capacity, so this does not allocate
+	// after the first call
+	group.argv.resize(1 + 2 * group.send_entries.size());
+	group.argvlen.resize(group.argv.size());
+	group.argv[0] = "MSET";
+	group.argvlen[0] = 4;
+	int i = 1;
+	for (auto& entry : group.send_entries) {
+		if (entry.int_data) {
+			char digits[16];
+			const int n = std::snprintf(digits, sizeof(digits), "%d",
+										*entry.int_data);
+			entry.buffer.assign(digits, n);
+		} else {
+			Eigen::Map<const Eigen::MatrixXd> value(entry.matrix_data,
+													entry.rows, entry.cols);
+			if (entry.codec == WireCodec::BINARY) {
+				encodeEigenWire(value, seq, entry.buffer);
+			} else {
+				encodeEigenText(value, entry.buffer);
+			}
+		}
+		group.argv[i] = entry.key.data();
+		group.argvlen[i++] = entry.key.size();
+		group.argv[i] = entry.buffer.data();
+		group.argvlen[i++] = entry.buffer.size();
+	}
+	redisAppendCommandArgv(_context.get(), group.argv.size(),
+						   group.argv.data(), group.argvlen.data());
+	++_pending_replies;
+
+	if (!group.notify_channel.empty()) {
+		char seq_digits[24];
+		const int n = std::snprintf(seq_digits, sizeof(seq_digits), "%llu",
+									(unsigned long long)seq);
+		const char* argv[3] = {"PUBLISH", group.notify_channel.data(),
+							   seq_digits};
+		const size_t argvlen[3] = {7, group.notify_channel.size(), (size_t)n};
+		redisAppendCommandArgv(_context.get(), 3, argv, argvlen);
+		++_pending_replies;
+	}
+}
+
+void RedisBinaryClient::appendReceive(Group& group) {
+	group.argv.resize(1 + group.receive_entries.size());
+	group.argvlen.resize(group.argv.size());
+	group.argv[0] = "MGET";
+	group.argvlen[0] = 4;
+	int i = 1;
+	for (const auto& entry : group.receive_entries) {
+		group.argv[i] = entry.key.data();
+		group.argvlen[i++] = entry.key.size();
+	}
+	redisAppendCommandArgv(_context.get(), group.argv.size(),
+						   group.argv.data(), group.argvlen.data());
+}
+
+void RedisBinaryClient::flushOutput() {
+	int done = 0;
+	while (!done) {
+		if (redisBufferWrite(_context.get(), &done) != REDIS_OK) {
+			throw std::runtime_error(std::string("RedisBinaryClient: ") +
+									 _context->errstr);
+		}
+	}
+}
+
+RedisBinaryClient::ReplyPtr RedisBinaryClient::readReply() {
+	void* raw_reply = nullptr;
+	if (redisGetReply(_context.get(), &raw_reply) != REDIS_OK) {
+		throw std::runtime_error(std::string("RedisBinaryClient: ") +
+								 _context->errstr);
+	}
+	ReplyPtr reply(static_cast<redisReply*>(raw_reply));
+	if (reply->type == REDIS_REPLY_ERROR) {
+		throw std::runtime_error(std::string("RedisBinaryClient: ") +
+								 reply->str);
+	}
+	return reply;
+}
+
+void RedisBinaryClient::flushPendingReplies() {
+	if (_pending_replies == 0) {
+		return;
+	}
+	flushOutput();
+	while (_pending_replies > 0) {
+		--_pending_replies;
+		readReply();
+	}
+}
+
+// returns the first key of the group that does not exist, without decoding
+// anything, or nullptr once all the keys are decoded
+const std::string* RedisBinaryClient::decodeReceiveReply(
+	Group& group, const redisReply* reply) {
+	if (reply->type != REDIS_REPLY_ARRAY ||
+		reply->elements != group.receive_entries.size()) {
+		throw std::runtime_error("RedisBinaryClient: unexpected MGET reply");
+	}
+	for (size_t i = 0; i < reply->elements; ++i) {
+		if (reply->element[i]->type != REDIS_REPLY_STRING) {
+			return &group.receive_entries[i].key;
+		}
+	}
+	for (size_t i = 0; i < reply->elements; ++i) {
+		auto& entry = group.receive_entries[i];
+		const redisReply* value = reply->element[i];
+		bool ok;
+		if (entry.int_data) {
+			char* end;
+			*entry.int_data = std::strtol(value->str, &end, 10);
+			ok = end != value->str;
+		} else {
+			Eigen::Map<Eigen::MatrixXd> out(entry.matrix_data, entry.rows,
+											entry.cols);
+			ok = entry.codec == WireCodec::BINARY
+					 ? decodeEigenWire(value->str, value->len, out, entry.seq)
+					 : decodeEigenText(value->str, value->len, out);
+		}
+		if (!ok) {
+			throw std::runtime_error("RedisBinaryClient: could not decode key " +
+									 entry.key);
+		}
+	}
+	return nullptr;
+}
+
+const std::string* RedisBinaryClient::receiveGroup(Group& group) {
+	if (group.receive_entries.empty()) {
+		return nullptr;
+	}
+	appendReceive(group);
+	flushOutput();
+	while (_pending_replies > 0) {
+		--_pending_replies;
+		readReply();
+	}
+	return decodeReceiveReply(group, readReply().get());
+}
+
+void RedisBinaryClient::receiveAllFromGroup(const std::string& group_name) {
+	const std::string* missing_key = receiveGroup(findGroup(group_name));
+	if (missing_key) {
+		throw std::runtime_error("RedisBinaryClient: key " + *missing_key +
+								 " does not exist");
+	}
+}
+
+bool RedisBinaryClient::tryReceiveAllFromGroup(const std::string& group_name) {
+	return !receiveGroup(findGroup(group_name));
+}
+
+void RedisBinaryClient::sendAllFromGroup(const std::string& group_name,
+										 uint64_t seq) {
+	auto& group = findGroup(group_name);
+	appendSend(group, seq);
+	flushOutput();
+}
+
+void RedisBinaryClient::setGroupNotifyChannel(const std::string& group_name,
+											  const std::string& channel) {
+	_groups[group_name].notify_channel = channel;
+}
+
+void RedisSubscriber::subscribe(const std::string& channel,
+								const std::string& hostname, const int port) {
+	_context.reset(redisConnect(hostname.c_str(), port));
+	if (!_context || _context->err) {
+		const std::string error =
+			_context ? _context->errstr : "could not allocate redis context";
+		_context.reset();
+		throw std::runtime_error("RedisSubscriber: " + error);
+	}
+	void* reply = redisCommand(_context.get(), "SUBSCRIBE %b", channel.data(),
+							   channel.size());
+	if (!reply) {
+		throw std::runtime_error(std::string("RedisSubscriber: ") +
+								 _context->errstr);
+	}
+	freeReplyObject(reply);
+}
+
+bool RedisSubscriber::drainMessages() {
+	// pull whatever is already in the socket without blocking, then consume
+	// all the complete messages
+	pollfd pfd = {_context->fd, POLLIN, 0};
+	while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+		if (redisBufferRead(_context.get()) != REDIS_OK) {
+			throw std::runtime_error(std::string("RedisSubscriber: ") +
+									 _context->errstr);
+		}
+	}
+	bool received = false;
+	void* reply = nullptr;
+	while (redisGetReplyFromReader(_context.get(), &reply) == REDIS_OK &&
+		   reply) {
+		freeReplyObject(reply);
+		reply = nullptr;
+		received = true;
+	}
+	return received;
+}
+
+bool RedisSubscriber::waitForMessage(double timeout_seconds) {
+	if (!_context) {
+		throw std::runtime_error("RedisSubscriber: not subscribed");
+	}
+	if (drainMessages()) {
+		return true;
+	}
+	pollfd pfd = {_context->fd, POLLIN, 0};
+	if (poll(&pfd, 1, (int)(timeout_seconds * 1000)) <= 0) {
+		return false;
+	}
+	return drainMessages();
+}
+
+}  // namespace Ocean1
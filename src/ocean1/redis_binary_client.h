@@ -0,0 +1,241 @@
+/**
+ * @file redis_binary_client.h
+ * @brief Small hiredis client for binary safe values. The Sai2Common
+ * RedisClient goes through C strings, which truncates binary payloads.
+ *
+ * Like the RedisClient, keys can be registered in named groups. A group can
+ * hold both keys to receive and keys to send, and each direction is exchanged
+ * with a single pipelined MGET / MSET, so that a control tick costs one
+ * round trip to read and one write to publish.
+ *
+ */
+
+#ifndef OCEAN1_REDIS_BINARY_CLIENT_H
+#define OCEAN1_REDIS_BINARY_CLIENT_H
+
+#include <hiredis/hiredis.h>
+
+#include <Eigen/Dense>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Ocean1 {
+
+/**
+ * @brief encoding of a key registered in a group. TEXT is the format of the
+ * Sai2Common RedisClient, BINARY the format of eigen_wire.h
+ */
+enum class WireCodec { TEXT, BINARY };
+
+class RedisBinaryClient {
+public:
+	RedisBinaryClient() = default;
+	~RedisBinaryClient() = default;
+
+	RedisBinaryClient(const RedisBinaryClient&) = delete;
+	RedisBinaryClient& operator=(const RedisBinaryClient&) = delete;
+
+	/**
+	 * @brief connect to the redis server, throws on failure
+	 */
+	void connect(const std::string& hostname = "127.0.0.1",
+				 const int port = 6379);
+
+	/**
+	 * @brief set a binary value
+	 */
+	void setBinary(const std::string& key, const std::string& value);
+
+	/**
+	 * @brief encode a matrix with the binary wire format and set it. The
+	 * encoding buffer is reused across calls.
+	 */
+	void setEigenBinary(const std::string& key,
+						const Eigen::Ref<const Eigen::MatrixXd>& value,
+						uint64_t seq = 0);
+
+	/**
+	 * @brief get a binary encoded matrix and decode it into a preallocated
+	 * matrix
+	 *
+	 * @return false if the key does not exist or does not hold a binary
+	 * value of the size of out
+	 */
+	bool getEigenBinary(const std::string& key,
+						Eigen::Ref<Eigen::MatrixXd> out,
+						uint64_t* seq = nullptr);
+
+	/**
+	 * @brief Register a matrix to be filled by receiveAllFromGroup. The
+	 * object must keep its address and size while it is registered.
+	 *
+	 * @param key redis key
+	 * @param object destination, decoded in place
+	 * @param codec encoding of the value
+	 * @param group_name name of the group
+	 * @param seq if not null, receives the sequence number of binary values
+	 */
+	template <typename Derived>
+	void addToReceiveGroup(const std::string& key,
+						   Eigen::PlainObjectBase<Derived>& object,
+						   const WireCodec codec,
+						   const std::string& group_name = "default",
+						   uint64_t* seq = nullptr) {
+		addMatrixEntry(_groups[group_name].receive_entries, key,
+					   object.data(), object.rows(), object.cols(), codec,
+					   seq);
+	}
+	void addToReceiveGroup(const std::string& key, int& object,
+						   const std::string& group_name = "default");
+
+	/**
+	 * @brief Register a matrix to be published by sendAllFromGroup. The
+	 * object must keep its address and size while it is registered.
+	 */
+	template <typename Derived>
+	void addToSendGroup(const std::string& key,
+						const Eigen::PlainObjectBase<Derived>& object,
+						const WireCodec codec,
+						const std::string& group_name = "default") {
+		addMatrixEntry(_groups[group_name].send_entries, key,
+					   const_cast<double*>(object.data()), object.rows(),
+					   object.cols(), codec, nullptr);
+	}
+	void addToSendGroup(const std::string& key, const int& object,
+						const std::string& group_name = "default");
+
+	/**
+	 * @brief read all the keys to receive of the group with one MGET. Also
+	 * collects the replies of the previous sendAllFromGroup calls, which are
+	 * not waited for.
+	 */
+	void receiveAllFromGroup(const std::string& group_name = "default");
+
+	/**
+	 * @brief same as receiveAllFromGroup, but a key that does not exist is
+	 * not an error
+	 *
+	 * @return false, leaving all the objects of the group unchanged, if a key
+	 * of the group does not exist
+	 */
+	bool tryReceiveAllFromGroup(const std::string& group_name = "default");
+
+	/**
+	 * @brief write all the keys to send of the group with one MSET, without
+	 * waiting for the reply
+	 *
+	 * @param seq sequence number stored in the binary values
+	 */
+	void sendAllFromGroup(const std::string& group_name = "default",
+						  uint64_t seq = 0);
+
+	/**
+	 * @brief wait for the replies of the pending sends
+	 */
+	void flushPendingReplies();
+
+	/**
+	 * @brief publish the sequence number on a pub/sub channel after each
+	 * sendAllFromGroup of the group, in the same write as the MSET. Used to
+	 * wake up the readers waiting with a RedisSubscriber.
+	 */
+	void setGroupNotifyChannel(const std::string& group_name,
+							   const std::string& channel);
+
+private:
+	struct GroupEntry {
+		std::string key;
+		WireCodec codec;
+		// matrix entries
+		double* matrix_data = nullptr;
+		int rows = 0;
+		int cols = 0;
+		// int entries
+		int* int_data = nullptr;
+		uint64_t* seq = nullptr;
+		std::string buffer;
+	};
+
+	struct Group {
+		std::vector<GroupEntry> receive_entries;
+		std::vector<GroupEntry> send_entries;
+		std::vector<const char*> argv;
+		std::vector<size_t> argvlen;
+		std::string notify_channel;
+	};
+
+	struct ContextDeleter {
+		void operator()(redisContext* c) const { redisFree(c); }
+	};
+	struct ReplyDeleter {
+		void operator()(redisReply* r) const { freeReplyObject(r); }
+	};
+	using ReplyPtr = std::unique_ptr<redisReply, ReplyDeleter>;
+
+	ReplyPtr command(const char* format, ...);
+
+	void addMatrixEntry(std::vector<GroupEntry>& entries,
+						const std::string& key, double* data, int rows,
+						int cols, WireCodec codec, uint64_t* seq);
+
+	Group& findGroup(const std::string& group_name);
+	void appendSend(Group& group, uint64_t seq);
+	void appendReceive(Group& group);
+	void flushOutput();
+	ReplyPtr readReply();
+	const std::string* receiveGroup(Group& group);
+	const std::string* decodeReceiveReply(Group& group,
+										  const redisReply* reply);
+
+	std::unique_ptr<redisContext, ContextDeleter> _context;
+	std::string _encode_buffer;
+	std::map<std::string, Group> _groups;
+	int _pending_replies = 0;
+};
+
+/**
+ * @brief Connection subscribed to a pub/sub channel, used to block until a
+ * new value was published instead of polling
+ *
+ */
+class RedisSubscriber {
+public:
+	RedisSubscriber() = default;
+	~RedisSubscriber() = default;
+
+	RedisSubscriber(const RedisSubscriber&) = delete;
+	RedisSubscriber& operator=(const RedisSubscriber&) = delete;
+
+	/**
+	 * @brief connect to the redis server and subscribe to the channel,
+	 * throws on failure
+	 */
+	void subscribe(const std::string& channel,
+				   const std::string& hostname = "127.0.0.1",
+				   const int port = 6379);
+
+	/**
+	 * @brief Block until a message is published on the channel. Messages that
+	 * queued up while the caller was busy are all consumed, so one call
+	 * accounts for any number of publications.
+	 *
+	 * @param timeout_seconds maximum time to block
+	 * @return false on timeout
+	 */
+	bool waitForMessage(double timeout_seconds);
+
+private:
+	struct ContextDeleter {
+		void operator()(redisContext* c) const { redisFree(c); }
+	};
+
+	bool drainMessages();
+
+	std::unique_ptr<redisContext, ContextDeleter> _context;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_REDIS_BINARY_CLIENT_H
@@ -5,3 +5,15 @@ const std::string JOINT_TORQUES_COMMANDED_KEY = "sai2::sim::ocean1::actuators::f
 const std::string CONTROLLER_RUNNING_KEY = "sai2::sim::ocean1::controller";
 const std::string SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT = "sai2::sim::ocean1::simlated_forces_left";
 const std::string SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT = "sai2::sim::ocean1::simlated_forces_right";
+// [seq, timestamp] of the published sim state, and of the state the commanded
+// torques were computed from
+const std::string SIM_STATE_STAMP_KEY = "sai2::sim::ocean1::state_stamp";
+const std::string COMMAND_STATE_STAMP_KEY = "sai2::sim::ocean1::actuators::state_stamp";
+
+// binary encoded copies of the hot keys above (see eigen_wire.h)
+const std::string BINARY_KEY_SUFFIX = "::bin";
+
+// pub/sub channels on which the simulator announces each new state and the
+// controller each new command
+const std::string SIM_STATE_PUBLISHED_CHANNEL = "sai2::sim::ocean1::state_published";
+const std::string SIM_COMMAND_PUBLISHED_CHANNEL = "sai2::sim::ocean1::actuators::command_published";
@@ -0,0 +1,166 @@
+/**
+ * @file shm_channel.cpp
+ * @brief POSIX shared memory segment for the sim <-> controller hot keys
+ *
+ */
+
+#include "shm_channel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace Ocean1 {
+
+namespace {
+
+#ifdef __linux__
+// the segment is shared between processes, so the non private futex
+// operations are needed
+long futex(std::atomic<uint32_t>* word, int op, uint32_t value,
+		   const struct timespec* timeout) {
+	return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value,
+				   timeout, nullptr, 0);
+}
+#endif
+
+// bump a futex word and wake up the processes blocked on it, if any
+void notifyEpoch(std::atomic<uint32_t>& epoch,
+				 std::atomic<uint32_t>& waiters) {
+	epoch.fetch_add(1, std::memory_order_release);
+	if (waiters.load(std::memory_order_seq_cst) > 0) {
+#ifdef __linux__
+		futex(&epoch, FUTEX_WAKE, INT32_MAX, nullptr);
+#endif
+	}
+}
+
+// block until the futex word differs from epoch, or the timeout
+uint32_t waitForEpoch(std::atomic<uint32_t>& word,
+					  std::atomic<uint32_t>& waiters, uint32_t epoch,
+					  double timeout_seconds) {
+	const auto deadline =
+		std::chrono::steady_clock::now() +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(timeout_seconds));
+	uint32_t current = word.load(std::memory_order_acquire);
+	while (current == epoch) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline) {
+			break;
+		}
+#ifdef __linux__
+		const auto remaining =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(deadline -
+																 now);
+		struct timespec timeout;
+		timeout.tv_sec = remaining.count() / 1000000000;
+		timeout.tv_nsec = remaining.count() % 1000000000;
+		waiters.fetch_add(1, std::memory_order_seq_cst);
+		// returns immediately if the epoch changed in between
+		futex(&word, FUTEX_WAIT, epoch, &timeout);
+		waiters.fetch_sub(1, std::memory_order_seq_cst);
+#else
+		// no futex on this platform, poll at a fraction of the sim period
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+		current = word.load(std::memory_order_acquire);
+	}
+	return current;
+}
+
+}  // namespace
+
+ShmChannel::ShmChannel(const std::string& name, bool create)
+	: _name(name), _owner(create), _layout(nullptr) {
+	int fd;
+	if (create) {
+		// remove a stale segment left by a crashed run
+		shm_unlink(name.c_str());
+		fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+		if (fd < 0 || ftruncate(fd, sizeof(ShmLayout)) != 0) {
+			throw std::runtime_error("could not create shared memory segment " +
+									 name + ": " + std::strerror(errno));
+		}
+	} else {
+		fd = shm_open(name.c_str(), O_RDWR, 0600);
+		if (fd < 0) {
+			throw std::runtime_error(
+				"could not open shared memory segment " + name +
+				" (is simviz_ocean1 running with --shm ?): " +
+				std::strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ShmLayout)) {
+			close(fd);
+			throw std::runtime_error("shared memory segment " + name +
+									 " has an unexpected size");
+		}
+	}
+
+	void* addr = mmap(nullptr, sizeof(ShmLayout), PROT_READ | PROT_WRITE,
+					  MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		throw std::runtime_error("could not map shared memory segment " +
+								 name + ": " + std::strerror(errno));
+	}
+
+	if (create) {
+		std::memset(addr, 0, sizeof(ShmLayout));
+		_layout = new (addr) ShmLayout();
+		_layout->version = SHM_LAYOUT_VERSION;
+		_layout->magic = SHM_LAYOUT_MAGIC;
+	} else {
+		_layout = static_cast<ShmLayout*>(addr);
+		if (_layout->magic != SHM_LAYOUT_MAGIC ||
+			_layout->version != SHM_LAYOUT_VERSION) {
+			munmap(addr, sizeof(ShmLayout));
+			throw std::runtime_error("shared memory segment " + name +
+									 " has an incompatible layout");
+		}
+	}
+}
+
+void ShmChannel::notifyStatePublished() {
+	notifyEpoch(_layout->state_epoch, _layout->state_waiters);
+}
+
+uint32_t ShmChannel::waitForStateEpoch(uint32_t epoch,
+									   double timeout_seconds) {
+	return waitForEpoch(_layout->state_epoch, _layout->state_waiters, epoch,
+						timeout_seconds);
+}
+
+void ShmChannel::notifyCommandPublished() {
+	notifyEpoch(_layout->command_epoch, _layout->command_waiters);
+}
+
+uint32_t ShmChannel::waitForCommandEpoch(uint32_t epoch,
+										 double timeout_seconds) {
+	return waitForEpoch(_layout->command_epoch, _layout->command_waiters,
+						epoch, timeout_seconds);
+}
+
+ShmChannel::~ShmChannel() {
+	munmap(_layout, sizeof(ShmLayout));
+	if (_owner) {
+		shm_unlink(_name.c_str());
+	}
+}
+
+}  // namespace Ocean1
@@ -0,0 +1,189 @@
+/**
+ * @file shm_channel.h
+ * @brief POSIX shared memory segment holding the seqlock protected state and
+ * command blocks exchanged between simviz_ocean1 and controller_ocean1
+ *
+ */
+
+#ifndef OCEAN1_SHM_CHANNEL_H
+#define OCEAN1_SHM_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace Ocean1 {
+
+// maximum number of joints the fixed layout can hold
+constexpr int SHM_MAX_DOF = 32;
+
+// default name of the shared memory segment
+const std::string SHM_CHANNEL_NAME = "/ocean1_sim_io";
+
+// a write takes well below a microsecond, a reader that still cannot get a
+// snapshot after that many tries is facing a dead writer
+constexpr int SEQLOCK_MAX_READ_ATTEMPTS = 1 << 20;
+
+/**
+ * @brief Single writer, multiple reader seqlock around a trivially copyable
+ * payload. The writer never blocks, readers retry if they raced a write.
+ * The sequence counter is odd while a write is in progress, so seq / 2 is the
+ * number of completed writes.
+ */
+template <typename T>
+struct Seqlock {
+	static_assert(std::is_trivially_copyable<T>::value,
+				  "Seqlock payload must be trivially copyable");
+
+	std::atomic<uint64_t> seq;
+	T data;
+
+	/**
+	 * @brief start a write. The payload can be modified in place through
+	 * data until endWrite() is called.
+	 */
+	void beginWrite() {
+		const uint64_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void endWrite() {
+		const uint64_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_release);
+	}
+
+	/**
+	 * @brief copy a consistent snapshot of the payload. Gives up after
+	 * max_attempts loads of the sequence counter, so that a writer that died
+	 * in the middle of a write does not hang the reader.
+	 *
+	 * @param out destination, unspecified on failure
+	 * @return false if no consistent snapshot could be taken
+	 */
+	bool read(T& out, int max_attempts = SEQLOCK_MAX_READ_ATTEMPTS) const {
+		uint64_t s0, s1;
+		do {
+			s0 = seq.load(std::memory_order_acquire);
+			while (s0 & 1) {
+				if (--max_attempts <= 0) {
+					return false;
+				}
+				s0 = seq.load(std::memory_order_acquire);
+			}
+			out = data;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s1 = seq.load(std::memory_order_relaxed);
+		} while (s0 != s1 && --max_attempts > 0);
+		return s0 == s1;
+	}
+
+	uint64_t writeCount() const {
+		return seq.load(std::memory_order_acquire) / 2;
+	}
+};
+
+struct ShmStatePayload {
+	int32_t dof;
+	uint64_t seq;
+	double timestamp;
+	double q[SHM_MAX_DOF];
+	double dq[SHM_MAX_DOF];
+	double force_left[3];
+	double force_right[3];
+};
+
+struct ShmCommandPayload {
+	int32_t dof;
+	// stamp of the state the torques were computed from
+	uint64_t state_seq;
+	double state_timestamp;
+	double torques[SHM_MAX_DOF];
+};
+
+/**
+ * @brief fixed layout of the shared memory segment. The state and command
+ * blocks live on separate cache lines so that the sim and controller writes
+ * do not false share.
+ * state_epoch is bumped after every state publication and is used as a futex
+ * word to wake up event driven readers. state_waiters counts the blocked
+ * readers so that the simulator only pays for the wake up syscall when
+ * somebody waits. command_epoch and command_waiters do the same for the
+ * command publications, the simulator waits on them in lockstep mode.
+ */
+struct ShmLayout {
+	uint32_t magic;
+	uint32_t version;
+	alignas(64) Seqlock<ShmStatePayload> state;
+	alignas(64) Seqlock<ShmCommandPayload> command;
+	alignas(64) std::atomic<uint32_t> state_epoch;
+	std::atomic<uint32_t> state_waiters;
+	alignas(64) std::atomic<uint32_t> command_epoch;
+	std::atomic<uint32_t> command_waiters;
+};
+
+constexpr uint32_t SHM_LAYOUT_MAGIC = 0x0CEA0001;
+constexpr uint32_t SHM_LAYOUT_VERSION = 4;
+
+/**
+ * @brief RAII owner of the mapping of the shared memory segment
+ *
+ */
+class ShmChannel {
+public:
+	/**
+	 * @brief Map the shared memory segment
+	 *
+	 * @param name name of the POSIX shm object
+	 * @param create if true, (re)create and initialize the segment and unlink
+	 * it on destruction. Otherwise open an existing segment and throw if it
+	 * does not exist or has an incompatible layout.
+	 */
+	ShmChannel(const std::string& name, bool create);
+	~ShmChannel();
+
+	ShmChannel(const ShmChannel&) = delete;
+	ShmChannel& operator=(const ShmChannel&) = delete;
+
+	ShmLayout* layout() { return _layout; }
+
+	/**
+	 * @brief bump the state epoch and wake up the readers blocked in
+	 * waitForStateEpoch. To be called after each state publication.
+	 */
+	void notifyStatePublished();
+
+	/**
+	 * @brief block until the state epoch differs from epoch
+	 *
+	 * @param epoch last epoch seen by the caller
+	 * @param timeout_seconds maximum time to block
+	 * @return the current epoch (equal to epoch on timeout)
+	 */
+	uint32_t waitForStateEpoch(uint32_t epoch, double timeout_seconds);
+
+	/**
+	 * @brief same as notifyStatePublished for the command, to be called after
+	 * each command publication
+	 */
+	void notifyCommandPublished();
+
+	/**
+	 * @brief block until the command epoch differs from epoch
+	 */
+	uint32_t waitForCommandEpoch(uint32_t epoch, double timeout_seconds);
+
+	uint32_t commandEpoch() const {
+		return _layout->command_epoch.load(std::memory_order_acquire);
+	}
+
+private:
+	std::string _name;
+	bool _owner;
+	ShmLayout* _layout;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_SHM_CHANNEL_H
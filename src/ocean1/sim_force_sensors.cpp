@@ -0,0 +1,61 @@
+/**
+ * @file sim_force_sensors.cpp
+ * @brief Simulated force sensors addressed by handle
+ *
+ */
+
+#include "sim_force_sensors.h"
+
+#include <stdexcept>
+
+namespace Ocean1 {
+
+SimForceSensors::SimForceSensors(
+	std::shared_ptr<Sai2Simulation::Sai2Simulation> sim)
+	: _sim(sim) {}
+
+ForceSensorHandle SimForceSensors::add(const std::string& robot_name,
+									   const std::string& link_name,
+									   const Eigen::Affine3d& transform_in_link,
+									   double filter_cutoff_frequency) {
+	_sim->addSimulatedForceSensor(robot_name, link_name, transform_in_link,
+								  filter_cutoff_frequency);
+	const std::vector<Sai2Model::ForceSensorData> data =
+		_sim->getAllForceSensorData();
+	if (data.size() != _sensors.size() + 1 ||
+		data.back().robot_name != robot_name ||
+		data.back().link_name != link_name) {
+		throw std::runtime_error("force sensor on " + robot_name + " link " +
+								 link_name + " not added to the simulation");
+	}
+	_sensors.push_back(data.back());
+	_forces.push_back(Eigen::Vector3d::Zero());
+	_moments.push_back(Eigen::Vector3d::Zero());
+	ForceSensorHandle sensor;
+	sensor.index = _sensors.size() - 1;
+	return sensor;
+}
+
+void SimForceSensors::update() {
+	// the only copy of the sensor data per step, Sai2Simulation has no
+	// accessor for a single sensor
+	const std::vector<Sai2Model::ForceSensorData> data =
+		_sim->getAllForceSensorData();
+	if (data.size() != _sensors.size()) {
+		throw std::runtime_error(
+			"force sensors added to the simulation without SimForceSensors");
+	}
+	for (size_t i = 0; i < data.size(); ++i) {
+		_forces[i] = data[i].force_world_frame;
+		_moments[i] = data[i].moment_world_frame;
+	}
+}
+
+void SimForceSensors::readAll(std::vector<Eigen::Vector3d>& forces,
+							  std::vector<Eigen::Vector3d>& moments) const {
+	// assignment reuses the storage of vectors of the same size
+	forces = _forces;
+	moments = _moments;
+}
+
+}  // namespace Ocean1
@@ -0,0 +1,81 @@
+/**
+ * @file sim_force_sensors.h
+ * @brief Simulated force sensors addressed by handle. Sai2Simulation returns
+ * the data of all its sensors at once, with their robot and link names, in
+ * the order they were added. The handles are indices in that order, so the
+ * simulation loop reads a sensor without comparing names.
+ *
+ */
+
+#ifndef OCEAN1_SIM_FORCE_SENSORS_H
+#define OCEAN1_SIM_FORCE_SENSORS_H
+
+#include <Eigen/Dense>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Sai2Simulation.h"
+
+namespace Ocean1 {
+
+struct ForceSensorHandle {
+	int index = -1;
+};
+
+class SimForceSensors {
+public:
+	explicit SimForceSensors(
+		std::shared_ptr<Sai2Simulation::Sai2Simulation> sim);
+
+	/**
+	 * @brief add a simulated force sensor to the simulation (see
+	 * Sai2Simulation::addSimulatedForceSensor). All the sensors of the
+	 * simulation need to be added through this class. Throws
+	 * std::runtime_error if the simulation did not add it.
+	 */
+	ForceSensorHandle add(const std::string& robot_name,
+						  const std::string& link_name,
+						  const Eigen::Affine3d& transform_in_link,
+						  double filter_cutoff_frequency);
+
+	/**
+	 * @brief robot, link and transform of the sensors, in the order of the
+	 * handles, e.g. to add their graphics displays
+	 */
+	const std::vector<Sai2Model::ForceSensorData>& sensors() const {
+		return _sensors;
+	}
+
+	/**
+	 * @brief read all the sensors from the simulation, once per step
+	 */
+	void update();
+
+	/**
+	 * @brief force and moment in the world frame of a sensor at the last
+	 * update, copied into the caller's vectors
+	 */
+	void read(const ForceSensorHandle& sensor, Eigen::Vector3d& force,
+			  Eigen::Vector3d& moment) const {
+		force = _forces[sensor.index];
+		moment = _moments[sensor.index];
+	}
+
+	/**
+	 * @brief same for all the sensors, indexed by handle. The vectors are
+	 * only allocated if they do not have one element per sensor yet.
+	 */
+	void readAll(std::vector<Eigen::Vector3d>& forces,
+				 std::vector<Eigen::Vector3d>& moments) const;
+
+private:
+	std::shared_ptr<Sai2Simulation::Sai2Simulation> _sim;
+	std::vector<Sai2Model::ForceSensorData> _sensors;
+	std::vector<Eigen::Vector3d> _forces;
+	std::vector<Eigen::Vector3d> _moments;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_SIM_FORCE_SENSORS_H
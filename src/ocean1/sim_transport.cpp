@@ -0,0 +1,339 @@
+/**
+ * @file sim_transport.cpp
+ * @brief Redis and shared memory implementations of the sim transport
+ *
+ */
+
+#include "sim_transport.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "cli_args.h"
+#include "redis_binary_client.h"
+#include "redis_keys.h"
+#include "shm_channel.h"
+
+namespace Ocean1 {
+
+TransportType transportTypeFromArgs(int argc, char** argv) {
+	if (hasFlag(argc, argv, "--shm")) {
+		return TransportType::SHM;
+	}
+	if (hasFlag(argc, argv, "--binary")) {
+		return TransportType::REDIS_BINARY;
+	}
+	return TransportType::REDIS;
+}
+
+double monotonicSeconds() {
+	// steady_clock is CLOCK_MONOTONIC, which has the same origin in every
+	// process
+	return std::chrono::duration<double>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+namespace {
+
+std::chrono::steady_clock::time_point deadlineAfter(double seconds) {
+	return std::chrono::steady_clock::now() +
+		   std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			   std::chrono::duration<double>(seconds));
+}
+
+double secondsUntil(std::chrono::steady_clock::time_point deadline) {
+	return std::chrono::duration<double>(deadline -
+										 std::chrono::steady_clock::now())
+		.count();
+}
+
+// in binary mode, the text keys are still refreshed every that many
+// publications so that the sai2-interfaces tools keep working
+const int TEXT_MIRROR_DECIMATION = 20;
+
+class RedisSimTransport : public SimTransport {
+public:
+	RedisSimTransport(WireCodec codec, int dof, bool is_simulator)
+		: _codec(codec), _state_seq(0), _command_seq(0) {
+		_state.q.setZero(dof);
+		_state.dq.setZero(dof);
+		_torques.setZero(dof);
+		_state_stamp.setZero();
+		_command_stamp.setZero();
+		_redis_client.connect();
+
+		// both sides register both directions of the state and command
+		// groups, each side only uses one of them
+		const std::string suffix =
+			codec == WireCodec::BINARY ? BINARY_KEY_SUFFIX : "";
+		registerKey(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT + suffix,
+					_state.force_left, SIM_STATE_GROUP);
+		registerKey(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT + suffix,
+					_state.force_right, SIM_STATE_GROUP);
+		registerKey(JOINT_ANGLES_KEY + suffix, _state.q, SIM_STATE_GROUP);
+		registerKey(JOINT_VELOCITIES_KEY + suffix, _state.dq, SIM_STATE_GROUP);
+		registerKey(SIM_STATE_STAMP_KEY + suffix, _state_stamp,
+					SIM_STATE_GROUP);
+		registerKey(JOINT_TORQUES_COMMANDED_KEY + suffix, _torques,
+					SIM_COMMAND_GROUP);
+		registerKey(COMMAND_STATE_STAMP_KEY + suffix, _command_stamp,
+					SIM_COMMAND_GROUP);
+		_redis_client.setGroupNotifyChannel(SIM_STATE_GROUP,
+											SIM_STATE_PUBLISHED_CHANNEL);
+		_redis_client.setGroupNotifyChannel(SIM_COMMAND_GROUP,
+											SIM_COMMAND_PUBLISHED_CHANNEL);
+
+		// subscribe before the other side can publish, pub/sub does not
+		// keep the notifications sent before the subscription
+		if (is_simulator) {
+			_command_subscriber = std::make_unique<RedisSubscriber>();
+			_command_subscriber->subscribe(SIM_COMMAND_PUBLISHED_CHANNEL);
+		} else {
+			_state_subscriber = std::make_unique<RedisSubscriber>();
+			_state_subscriber->subscribe(SIM_STATE_PUBLISHED_CHANNEL);
+		}
+
+		if (codec == WireCodec::BINARY) {
+			_redis_client.addToSendGroup(
+				SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT, _state.force_left,
+				WireCodec::TEXT, TEXT_MIRROR_STATE_GROUP);
+			_redis_client.addToSendGroup(
+				SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT, _state.force_right,
+				WireCodec::TEXT, TEXT_MIRROR_STATE_GROUP);
+			_redis_client.addToSendGroup(JOINT_ANGLES_KEY, _state.q,
+										 WireCodec::TEXT,
+										 TEXT_MIRROR_STATE_GROUP);
+			_redis_client.addToSendGroup(JOINT_VELOCITIES_KEY, _state.dq,
+										 WireCodec::TEXT,
+										 TEXT_MIRROR_STATE_GROUP);
+			_redis_client.addToSendGroup(JOINT_TORQUES_COMMANDED_KEY, _torques,
+										 WireCodec::TEXT,
+										 TEXT_MIRROR_COMMAND_GROUP);
+		}
+	}
+
+	void publishState(const SimState& state) override {
+		_state.q = state.q;
+		_state.dq = state.dq;
+		_state.force_left = state.force_left;
+		_state.force_right = state.force_right;
+		// the stamp goes as doubles, exact for sequence numbers below 2^53
+		_state_stamp << (double)state.stamp.seq, state.stamp.timestamp;
+		++_state_seq;
+		if (_codec == WireCodec::BINARY &&
+			_state_seq % TEXT_MIRROR_DECIMATION == 1) {
+			_redis_client.sendAllFromGroup(TEXT_MIRROR_STATE_GROUP);
+		}
+		_redis_client.sendAllFromGroup(SIM_STATE_GROUP, _state_seq);
+	}
+
+	void readTorques(Eigen::VectorXd& torques,
+					 SimStamp& state_stamp) override {
+		_redis_client.receiveAllFromGroup(SIM_COMMAND_GROUP);
+		torques = _torques;
+		state_stamp.seq = (uint64_t)_command_stamp(0);
+		state_stamp.timestamp = _command_stamp(1);
+	}
+
+	bool readState(SimState& state) override {
+		// the keys do not exist before the first publication of the
+		// simulator, and seq 0 is no state
+		if (!_redis_client.tryReceiveAllFromGroup(SIM_STATE_GROUP) ||
+			_state_stamp(0) == 0) {
+			return false;
+		}
+		state.q = _state.q;
+		state.dq = _state.dq;
+		state.force_left = _state.force_left;
+		state.force_right = _state.force_right;
+		state.stamp.seq = (uint64_t)_state_stamp(0);
+		state.stamp.timestamp = _state_stamp(1);
+		return true;
+	}
+
+	void publishTorques(const Eigen::VectorXd& torques,
+						const SimStamp& state_stamp) override {
+		_torques = torques;
+		_command_stamp << (double)state_stamp.seq, state_stamp.timestamp;
+		++_command_seq;
+		if (_codec == WireCodec::BINARY &&
+			_command_seq % TEXT_MIRROR_DECIMATION == 1) {
+			_redis_client.sendAllFromGroup(TEXT_MIRROR_COMMAND_GROUP);
+		}
+		_redis_client.sendAllFromGroup(SIM_COMMAND_GROUP, _command_seq);
+	}
+
+	bool waitForNewState(double timeout_seconds) override {
+		return _state_subscriber->waitForMessage(timeout_seconds);
+	}
+
+	bool waitForTorques(const SimStamp& state_stamp,
+						double timeout_seconds) override {
+		const auto deadline = deadlineAfter(timeout_seconds);
+		while (true) {
+			_redis_client.receiveAllFromGroup(SIM_COMMAND_GROUP);
+			if ((uint64_t)_command_stamp(0) >= state_stamp.seq) {
+				return true;
+			}
+			const double remaining = secondsUntil(deadline);
+			if (remaining <= 0 ||
+				!_command_subscriber->waitForMessage(remaining)) {
+				return false;
+			}
+		}
+	}
+
+	RedisBinaryClient* redisClient() override { return &_redis_client; }
+
+private:
+	template <typename Derived>
+	void registerKey(const std::string& key,
+					 Eigen::PlainObjectBase<Derived>& object,
+					 const std::string& group_name) {
+		_redis_client.addToReceiveGroup(key, object, _codec, group_name);
+		_redis_client.addToSendGroup(key, object, _codec, group_name);
+	}
+
+	const std::string TEXT_MIRROR_STATE_GROUP = "text_mirror_state";
+	const std::string TEXT_MIRROR_COMMAND_GROUP = "text_mirror_command";
+
+	WireCodec _codec;
+	uint64_t _state_seq;
+	uint64_t _command_seq;
+	// registered buffers, sized once in the constructor
+	SimState _state;
+	Eigen::VectorXd _torques;
+	Eigen::Vector2d _state_stamp;
+	Eigen::Vector2d _command_stamp;
+	RedisBinaryClient _redis_client;
+	std::unique_ptr<RedisSubscriber> _state_subscriber;
+	std::unique_ptr<RedisSubscriber> _command_subscriber;
+};
+
+class ShmSimTransport : public SimTransport {
+public:
+	ShmSimTransport(int dof, bool is_simulator)
+		: _dof(dof), _channel(SHM_CHANNEL_NAME, is_simulator), _state_epoch(0) {
+		if (dof > SHM_MAX_DOF) {
+			throw std::invalid_argument(
+				"robot has too many joints for the shared memory transport");
+		}
+	}
+
+	void publishState(const SimState& state) override {
+		auto& block = _channel.layout()->state;
+		block.beginWrite();
+		block.data.dof = _dof;
+		block.data.seq = state.stamp.seq;
+		block.data.timestamp = state.stamp.timestamp;
+		Eigen::Map<Eigen::VectorXd>(block.data.q, _dof) = state.q;
+		Eigen::Map<Eigen::VectorXd>(block.data.dq, _dof) = state.dq;
+		Eigen::Map<Eigen::Vector3d>(block.data.force_left) = state.force_left;
+		Eigen::Map<Eigen::Vector3d>(block.data.force_right) =
+			state.force_right;
+		block.endWrite();
+		_channel.notifyStatePublished();
+	}
+
+	void readTorques(Eigen::VectorXd& torques,
+					 SimStamp& state_stamp) override {
+		// before the controller publishes anything, or if it died in the
+		// middle of a publication, the command is zero
+		torques.resize(_dof);
+		if (!_channel.layout()->command.read(_command) ||
+			_command.dof != _dof) {
+			torques.setZero();
+			state_stamp = SimStamp();
+			return;
+		}
+		state_stamp.seq = _command.state_seq;
+		state_stamp.timestamp = _command.state_timestamp;
+		torques = Eigen::Map<const Eigen::VectorXd>(_command.torques, _dof);
+	}
+
+	bool readState(SimState& state) override {
+		// the dof is zero until the simulator publishes its first state
+		if (!_channel.layout()->state.read(_state) || _state.dof == 0) {
+			return false;
+		}
+		if (_state.dof != _dof) {
+			throw std::runtime_error(
+				"inconsistent number of joints in the shared memory state");
+		}
+		state.stamp.seq = _state.seq;
+		state.stamp.timestamp = _state.timestamp;
+		state.q = Eigen::Map<const Eigen::VectorXd>(_state.q, _dof);
+		state.dq = Eigen::Map<const Eigen::VectorXd>(_state.dq, _dof);
+		state.force_left = Eigen::Map<const Eigen::Vector3d>(_state.force_left);
+		state.force_right =
+			Eigen::Map<const Eigen::Vector3d>(_state.force_right);
+		return true;
+	}
+
+	void publishTorques(const Eigen::VectorXd& torques,
+						const SimStamp& state_stamp) override {
+		auto& block = _channel.layout()->command;
+		block.beginWrite();
+		block.data.dof = _dof;
+		block.data.state_seq = state_stamp.seq;
+		block.data.state_timestamp = state_stamp.timestamp;
+		Eigen::Map<Eigen::VectorXd>(block.data.torques, _dof) = torques;
+		block.endWrite();
+		_channel.notifyCommandPublished();
+	}
+
+	bool waitForNewState(double timeout_seconds) override {
+		const uint32_t epoch =
+			_channel.waitForStateEpoch(_state_epoch, timeout_seconds);
+		if (epoch == _state_epoch) {
+			return false;
+		}
+		_state_epoch = epoch;
+		return true;
+	}
+
+	bool waitForTorques(const SimStamp& state_stamp,
+						double timeout_seconds) override {
+		const auto deadline = deadlineAfter(timeout_seconds);
+		while (true) {
+			// read the epoch first, so that a command published after the
+			// check below ends the wait
+			const uint32_t epoch = _channel.commandEpoch();
+			if (_channel.layout()->command.read(_command) &&
+				_command.dof == _dof && _command.state_seq >= state_stamp.seq) {
+				return true;
+			}
+			const double remaining = secondsUntil(deadline);
+			if (remaining <= 0) {
+				return false;
+			}
+			_channel.waitForCommandEpoch(epoch, remaining);
+		}
+	}
+
+private:
+	int _dof;
+	ShmChannel _channel;
+	uint32_t _state_epoch;
+	// local snapshots, kept as members so that reads do not allocate
+	ShmStatePayload _state;
+	ShmCommandPayload _command;
+};
+
+}  // namespace
+
+std::unique_ptr<SimTransport> createSimTransport(TransportType type, int dof,
+												 bool is_simulator) {
+	if (type == TransportType::SHM) {
+		return std::make_unique<ShmSimTransport>(dof, is_simulator);
+	}
+	if (type == TransportType::REDIS_BINARY) {
+		return std::make_unique<RedisSimTransport>(WireCodec::BINARY, dof,
+												   is_simulator);
+	}
+	return std::make_unique<RedisSimTransport>(WireCodec::TEXT, dof,
+											   is_simulator);
+}
+
+}  // namespace Ocean1
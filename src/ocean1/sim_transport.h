@@ -0,0 +1,132 @@
+/**
+ * @file sim_transport.h
+ * @brief Transport for the per tick sim <-> controller data (joint state,
+ * simulated end effector forces and commanded torques). Either goes through
+ * redis (default) or through a shared memory segment.
+ *
+ */
+
+#ifndef OCEAN1_SIM_TRANSPORT_H
+#define OCEAN1_SIM_TRANSPORT_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Ocean1 {
+
+class RedisBinaryClient;
+
+// names of the pipelined groups of the redis transports. The state group is
+// received by the controller at the start of a tick and the command group is
+// sent at the end, extra per tick keys can be registered in them.
+const std::string SIM_STATE_GROUP = "sim_state";
+const std::string SIM_COMMAND_GROUP = "sim_command";
+
+enum class TransportType { REDIS, REDIS_BINARY, SHM };
+
+/**
+ * @brief select the transport from the command line: "--shm" selects the
+ * shared memory transport, "--binary" selects redis with the binary wire
+ * format, redis with the text format is used otherwise
+ */
+TransportType transportTypeFromArgs(int argc, char** argv);
+
+/**
+ * @brief identifies a published sim state. seq starts at 1 and increases by
+ * one per simulator tick, 0 means no state. timestamp is the publication time
+ * on the monotonic clock (see monotonicSeconds), comparable across processes.
+ */
+struct SimStamp {
+	uint64_t seq = 0;
+	double timestamp = 0.0;
+};
+
+/**
+ * @brief time in seconds on the monotonic clock shared by all the processes
+ * of the machine
+ */
+double monotonicSeconds();
+
+struct SimState {
+	SimStamp stamp;
+	Eigen::VectorXd q;
+	Eigen::VectorXd dq;
+	Eigen::Vector3d force_left = Eigen::Vector3d::Zero();
+	Eigen::Vector3d force_right = Eigen::Vector3d::Zero();
+};
+
+/**
+ * @brief Interface for the hot path between simviz_ocean1 and
+ * controller_ocean1. The simulator side publishes the state and reads the
+ * torques, the controller side does the opposite. Slow changing configuration
+ * and the haptic device keys stay on the regular redis client.
+ *
+ */
+class SimTransport {
+public:
+	virtual ~SimTransport() = default;
+
+	// simulator side. readTorques also returns the stamp of the state the
+	// controller computed the torques from.
+	virtual void publishState(const SimState& state) = 0;
+	virtual void readTorques(Eigen::VectorXd& torques,
+							 SimStamp& state_stamp) = 0;
+
+	// controller side. publishTorques echoes the stamp of the state the
+	// torques were computed from.
+	/**
+	 * @brief read the latest state
+	 *
+	 * @return false, leaving state unchanged, if no complete state is
+	 * available: the simulator has not published one yet, or stopped in the
+	 * middle of a publication
+	 */
+	virtual bool readState(SimState& state) = 0;
+	virtual void publishTorques(const Eigen::VectorXd& torques,
+								const SimStamp& state_stamp) = 0;
+
+	/**
+	 * @brief controller side: block until the simulator published a state
+	 * newer than the one seen by the previous call
+	 *
+	 * @param timeout_seconds maximum time to block
+	 * @return false on timeout
+	 */
+	virtual bool waitForNewState(double timeout_seconds) = 0;
+
+	/**
+	 * @brief simulator side: block until the controller published torques
+	 * computed from the state with the given stamp (or a later one). Used by
+	 * the lockstep mode.
+	 *
+	 * @param timeout_seconds maximum time to block
+	 * @return false on timeout
+	 */
+	virtual bool waitForTorques(const SimStamp& state_stamp,
+								double timeout_seconds) = 0;
+
+	/**
+	 * @brief the pipelined client the redis transports exchange the hot keys
+	 * with, so that other per tick keys can join the same batches. nullptr
+	 * for the shared memory transport.
+	 */
+	virtual RedisBinaryClient* redisClient() { return nullptr; }
+};
+
+/**
+ * @brief Create the transport
+ *
+ * @param type redis (text or binary) or shared memory
+ * @param dof number of joints of the robot
+ * @param is_simulator true on the simviz side. For the shared memory
+ * transport, the simulator side creates the segment and the controller side
+ * attaches to it.
+ */
+std::unique_ptr<SimTransport> createSimTransport(TransportType type, int dof,
+												 bool is_simulator);
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_SIM_TRANSPORT_H
@@ -1,6 +1,9 @@
 // @file simviz.cpp
 
 #include <math.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <signal.h>
 #include <iostream>
 #include <mutex>
@@ -17,21 +20,31 @@
 #include "Sai2Model.h"
 #include "Sai2Simulation.h"
 #include "Sai2Primitives.h"
-#include "redis/RedisClient.h"
 #include "timer/LoopTimer.h"
 #include "logger/Logger.h"
 
-bool fSimulationRunning = false;
+// written by the signal handler and the render loop, read by the simulation
+// thread
+std::atomic<bool> fSimulationRunning{false};
 void sighandler(int){fSimulationRunning = false;}
 
 #include "redis_keys.h"
+#include "sim_force_sensors.h"
+#include "latency_stats.h"
+#include "cli_args.h"
+#include "controller_plugin.h"
+#include "sim_transport.h"
+#include "startup_timer.h"
+#include "telemetry_logger.h"
+#include "triple_buffer.h"
+#include "world_description.h"
 
 using namespace Eigen;
 using namespace std;
 
 // mutex and globals
 VectorXd ui_torques;
-mutex mutex_torques, mutex_update;
+mutex mutex_torques;
 
 //NEW VARIALBES
 Vector3d newCamLookat;
@@ -42,37 +55,90 @@ Vector3d newCamPos;
 static const string robot_name = "ocean1";
 static const string camera_name = "camera_fixed";
 
-// dynamic objects information
-const vector<std::string> object_names = {"cup", "bottle"};
-vector<Affine3d> object_poses;
-vector<VectorXd> object_velocities;
-const int n_objects = object_names.size();
-
-// simulation thread
-void simulation(std::shared_ptr<Sai2Simulation::Sai2Simulation> sim);
-
-int main() {
+// dynamic objects information, read from the world file at startup
+vector<std::string> object_names;
+int n_objects = 0;
+
+// end effector force sensors, added at startup
+Ocean1::ForceSensorHandle force_sensor_left;
+Ocean1::ForceSensorHandle force_sensor_right;
+
+// state of the simulated world handed from the simulation thread to the
+// render loop
+struct SimSnapshot {
+	// simulated time in seconds
+	double time = 0.0;
+	VectorXd q;
+	VectorXd dq;
+	vector<Affine3d> object_poses;
+	vector<VectorXd> object_velocities;
+	// force and moment in the world frame of each force sensor, indexed by
+	// its Ocean1::ForceSensorHandle
+	vector<Vector3d> forces;
+	vector<Vector3d> moments;
+};
+
+// run options of the simulation thread
+struct SimulationOptions {
+	// no window, the render loop does not run
+	bool headless = false;
+	// simulated time over wall clock time. 0 steps as fast as possible
+	double real_time_factor = 1.0;
+	// simulated seconds after which the simulation stops, 0 to run until
+	// stopped
+	double duration = 0.0;
+	// step in lockstep with the controller, one control tick per control
+	// period
+	bool lockstep = false;
+	// rate in Hz (of wall clock time) at which snapshots are published for the
+	// render loop, 0 to publish every iteration
+	double snapshot_rate = 240.0;
+};
+
+// default controller plugin of --in-process, set by cmake
+#ifndef OCEAN1_CONTROLLER_PLUGIN
+#define OCEAN1_CONTROLLER_PLUGIN "libocean1_controller.so"
+#endif
+
+// simulation thread. With a controller, the torques come from it instead of
+// the transport, which is then nullptr.
+void simulation(std::shared_ptr<Sai2Simulation::Sai2Simulation> sim,
+				Ocean1::SimForceSensors* force_sensors,
+				Ocean1::SimTransport* transport,
+				const SimulationOptions& options,
+				Ocean1::ControllerPlugin* controller,
+				Ocean1::TripleBuffer<SimSnapshot>* snapshots);
+
+int main(int argc, char** argv) {
 	
+	// time of each startup phase, reported before the simulation starts
+	Ocean1::StartupTimer startup_timer;
+
 	Sai2Model::URDF_FOLDERS["CS225A_URDF_FOLDER"] = string(CS225A_URDF_FOLDER);
-	static const string robot_file = string(CS225A_URDF_FOLDER) + "/ocean1/ocean1.urdf";
 	static const string world_file = string(OCEAN1_FOLDER) + "/world_ocean1.urdf";
 	std::cout << "Loading URDF world model file: " << world_file << endl;
 
-	// start redis client
-	auto redis_client = Sai2Common::RedisClient();
-	redis_client.connect();
+	// robots and objects of the world, read once. The robot file and the
+	// dynamic objects synchronized with the graphics come from it
+	const Ocean1::WorldDescription world = Ocean1::parseWorldDescription(world_file, Sai2Model::URDF_FOLDERS);
+	const string robot_file = world.robot(robot_name).model_file;
+	object_names = world.dynamicObjectNames();
+	n_objects = object_names.size();
+	startup_timer.phase("world description");
 
 	// set up signal handler
 	signal(SIGABRT, &sighandler);
 	signal(SIGTERM, &sighandler);
 	signal(SIGINT, &sighandler);
 
-	// load graphics scene
-	auto graphics = std::make_shared<Sai2Graphics::Sai2Graphics>(world_file, camera_name, false);
-	graphics->setBackgroundColor(66.0/255, 135.0/255, 245.0/255);  // set blue background 	
-	//graphics->showLinkFrame(true, robot_name, "link7", 0.15);  // can add frames for different links
-	// graphics->getCamera(camera_name)->setClippingPlanes(0.1, 50);  // set the near and far clipping planes 
-	graphics->addUIForceInteraction(robot_name);
+	// with --headless there is no window (and no GLFW context), and the
+	// simulation runs as fast as possible unless capped with --rtf=<factor>
+	SimulationOptions options;
+	options.headless = Ocean1::hasFlag(argc, argv, "--headless");
+	options.lockstep = Ocean1::hasFlag(argc, argv, "--lockstep");
+	options.real_time_factor = stod(Ocean1::flagValue(argc, argv, "--rtf", options.headless || options.lockstep ? "0" : "1"));
+	options.duration = stod(Ocean1::flagValue(argc, argv, "--duration", "0"));
+	options.snapshot_rate = stod(Ocean1::flagValue(argc, argv, "--snapshot-rate", "240"));
 
 	// load robots
 	auto robot = std::make_shared<Sai2Model::Sai2Model>(robot_file, false);
@@ -80,24 +146,74 @@ int main() {
 	//robot->setDq();
 	robot->updateModel();
 	ui_torques = VectorXd::Zero(robot->dof());
+	startup_timer.phase("robot model");
+
+	// load graphics scene. The graphics use the robot model above instead of
+	// parsing the robot file again; main only reads it before the render loop
+	std::shared_ptr<Sai2Graphics::Sai2Graphics> graphics;
+	if (!options.headless) {
+		// visual meshes converted by the ocean1_mesh_cache target are memory
+		// mapped instead of parsed (see mesh_cache.h)
+		Sai2Graphics::Sai2Graphics::setMeshCacheDirectory(OCEAN1_MESH_CACHE_DIR);
+		// and built by worker threads while the window already renders
+		// placeholder boxes
+		Sai2Graphics::Sai2Graphics::setMeshLoadingThreads(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+		// --offscreen renders without a window through EGL, and
+		// --offscreen=osmesa in software through OSMesa, for machines without
+		// a display or a GPU. Use with --capture to get the frames
+		const string offscreen = Ocean1::flagValue(argc, argv, "--offscreen", Ocean1::hasFlag(argc, argv, "--offscreen") ? "egl" : "");
+		if (!offscreen.empty()) {
+			Sai2Graphics::Sai2Graphics::setOffscreen(true, offscreen == "osmesa" ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+		}
+		const std::map<std::string, std::shared_ptr<Sai2Model::Sai2Model>> graphics_robot_models = {{robot_name, robot}};
+		graphics = std::make_shared<Sai2Graphics::Sai2Graphics>(world_file, graphics_robot_models, camera_name, false);
+		graphics->setBackgroundColor(66.0/255, 135.0/255, 245.0/255);  // set blue background 	
+		//graphics->showLinkFrame(true, robot_name, "link7", 0.15);  // can add frames for different links
+		// graphics->getCamera(camera_name)->setClippingPlanes(0.1, 50);  // set the near and far clipping planes 
+		graphics->addUIForceInteraction(robot_name);
+		// --capture=<file> records the camera view to a raw RGBA video file
+		// (see frame_writer.h for the ffmpeg command encoding it), of
+		// --capture-size=<width>x<height> at --capture-fps=<fps>
+		const string capture_path = Ocean1::flagValue(argc, argv, "--capture");
+		if (!capture_path.empty()) {
+			int capture_width = 1280, capture_height = 720;
+			sscanf(Ocean1::flagValue(argc, argv, "--capture-size", "1280x720").c_str(), "%dx%d", &capture_width, &capture_height);
+			const double capture_fps = stod(Ocean1::flagValue(argc, argv, "--capture-fps", "30"));
+			graphics->startFrameCapture(capture_path, capture_width, capture_height, capture_fps, camera_name);
+		}
+		startup_timer.phase("graphics world and window");
+	}
 
 	// load simulation world
 	auto sim = std::make_shared<Sai2Simulation::Sai2Simulation>(world_file, false);
+	startup_timer.phase("simulation world");
 	
-	sim->addSimulatedForceSensor(robot_name, "endEffector_left", Affine3d::Identity(),
-								 10.0);
-	sim->addSimulatedForceSensor(robot_name, "endEffector_right", Affine3d::Identity(),
-								 10.0);
-	graphics->addForceSensorDisplay(sim->getAllForceSensorData()[0]);
-	graphics->addForceSensorDisplay(sim->getAllForceSensorData()[1]);
+	// force sensors are read by handle, and their displays updated by
+	// handle, in the order they are added
+	Ocean1::SimForceSensors force_sensors(sim);
+	force_sensor_left = force_sensors.add(robot_name, "endEffector_left", Affine3d::Identity(), 10.0);
+	force_sensor_right = force_sensors.add(robot_name, "endEffector_right", Affine3d::Identity(), 10.0);
+	vector<Sai2Graphics::ForceSensorHandle> force_sensor_displays;
+	if (graphics) {
+		for (const auto& sensor_data : force_sensors.sensors()) {
+			force_sensor_displays.push_back(graphics->addForceSensorDisplay(sensor_data));
+		}
+	}
 	sim->setJointPositions(robot_name, robot->q());
 	sim->setJointVelocities(robot_name, robot->dq());
 
-	// fill in object information 
+	// fill in object information. The snapshot buffers are sized here, so
+	// that the simulation thread fills them in place
+	SimSnapshot initial_snapshot;
+	initial_snapshot.q = robot->q();
+	initial_snapshot.dq = robot->dq();
 	for (int i = 0; i < n_objects; ++i) {
-		object_poses.push_back(sim->getObjectPose(object_names[i]));
-		object_velocities.push_back(sim->getObjectVelocity(object_names[i]));
+		initial_snapshot.object_poses.push_back(sim->getObjectPose(object_names[i]));
+		initial_snapshot.object_velocities.push_back(sim->getObjectVelocity(object_names[i]));
 	}
+	force_sensors.update();
+	force_sensors.readAll(initial_snapshot.forces, initial_snapshot.moments);
+	Ocean1::TripleBuffer<SimSnapshot> sim_snapshots(initial_snapshot);
 
     // set co-efficient of restition to zero for force control
     sim->setCollisionRestitution(0.0);
@@ -105,49 +221,103 @@ int main() {
     // set co-efficient of friction
     sim->setCoeffFrictionStatic(0.0);
     sim->setCoeffFrictionDynamic(0.0);
+	startup_timer.phase("simulation setup");
 
 	/*------- Set up visualization -------*/
-	// init redis client values 
-	redis_client.setEigen(JOINT_ANGLES_KEY, robot->q()); 
-	redis_client.setEigen(JOINT_VELOCITIES_KEY, robot->dq()); 
-	redis_client.setEigen(JOINT_TORQUES_COMMANDED_KEY, 0 * robot->q());
-	redis_client.setEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT, Vector3d(0,0,0));
-	redis_client.setEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT, Vector3d(0,0,0));
-
+	// with --in-process, the controller plugin library is loaded and stepped
+	// in the simulation thread, instead of running controller_ocean1. There
+	// is then no transport, and no inter process communication at all
+	std::unique_ptr<Ocean1::ControllerPluginLibrary> controller_library;
+	std::unique_ptr<Ocean1::ControllerPlugin> controller;
+	std::unique_ptr<Ocean1::SimTransport> transport;
+	if (Ocean1::hasFlag(argc, argv, "--in-process")) {
+		controller_library = std::make_unique<Ocean1::ControllerPluginLibrary>(
+			Ocean1::flagValue(argc, argv, "--controller-plugin", OCEAN1_CONTROLLER_PLUGIN));
+		controller = controller_library->create();
+		auto controller_robot = std::make_shared<Sai2Model::Sai2Model>(robot_file, false);
+		controller_robot->setQ(robot->q());
+		controller_robot->setDq(robot->dq());
+		controller_robot->updateModel();
+		controller->init(controller_robot);
+		startup_timer.phase("controller plugin");
+	} else {
+		// init sim <-> controller values. the per tick keys go through redis
+		// or shared memory depending on the selected transport
+		transport = Ocean1::createSimTransport(
+			Ocean1::transportTypeFromArgs(argc, argv), robot->dof(), true);
+		Ocean1::SimState initial_state;
+		initial_state.q = robot->q();
+		initial_state.dq = robot->dq();
+		transport->publishState(initial_state);
+		transport->publishTorques(0 * robot->q(), Ocean1::SimStamp());
+		startup_timer.phase("transport");
+	}
+	startup_timer.print(std::cout);
 
 	// start simulation thread
-	thread sim_thread(simulation, sim);
+	fSimulationRunning = true;
+	thread sim_thread(simulation, sim, &force_sensors, transport.get(), options, controller.get(),
+					  options.headless ? nullptr : &sim_snapshots);
+
+	if (options.headless) {
+		// runs until the duration is simulated or a signal stops it
+		sim_thread.join();
+		return 0;
+	}
 		
-	VectorXd robot_q = robot->q(); //Makes robot_q the joint angles of the robot (since the body is prismatic, this is fine)
+	// handles, so that the render loop updates the graphics without any name
+	// lookup
+	const Sai2Graphics::RobotHandle robot_handle = graphics->getRobotHandle(robot_name);
+	vector<Sai2Graphics::ObjectHandle> object_handles;
+	for (int i = 0; i < n_objects; ++i) {
+		object_handles.push_back(graphics->getObjectHandle(object_names[i]));
+	}
+
+	// frames are presented at --fps=<Hz> (60 by default). The inputs and the
+	// UI torques sent to the simulation run at --input-rate=<Hz> (250 by
+	// default), whether or not a frame is presented. The swap shares this
+	// loop, so it is only synchronized with the display refresh with --vsync,
+	// at the cost of input ticks stretched up to a refresh period
+	Sai2Graphics::FramePacing frame_pacing;
+	frame_pacing.target_fps = stod(Ocean1::flagValue(argc, argv, "--fps", "60"));
+	frame_pacing.vsync = Ocean1::hasFlag(argc, argv, "--vsync");
+	graphics->setFramePacing(frame_pacing);
+	Sai2Common::LoopTimer input_timer(stod(Ocean1::flagValue(argc, argv, "--input-rate", "250")));
 
 	// while window is open:
-	while (graphics->isWindowOpen()) {
-		robot_q = redis_client.getEigen(JOINT_ANGLES_KEY); //Updates the joint angles on each iteration
-        graphics->updateRobotGraphics(robot_name, robot_q);
+	while (graphics->isWindowOpen() && fSimulationRunning) {
+		input_timer.waitForNextLoop();
+		graphics->handleInputs();
 		{
-			lock_guard<mutex> lock(mutex_update);
-			for (int i = 0; i < n_objects; ++i) {
-				graphics->updateObjectGraphics(object_names[i], object_poses[i]);
+			lock_guard<mutex> lock(mutex_torques);
+			ui_torques = graphics->getUITorques(robot_name);
+		}
+
+		if (!graphics->isFrameDue()) {
+			continue;
+		}
+		// latest snapshot of the simulation thread, never blocks. The previous
+		// one is kept, and the graphics are left as they are, if none was
+		// published since the last frame
+		const bool new_snapshot = sim_snapshots.update();
+		const SimSnapshot& snapshot = sim_snapshots.readBuffer();
+		const VectorXd& robot_q = snapshot.q; //Makes robot_q the joint angles of the robot (since the body is prismatic, this is fine)
+		if (new_snapshot) {
+			graphics->updateObjectsGraphics(object_handles, snapshot.object_poses);
+			graphics->updateRobotGraphics(robot_handle, robot_q);
+			for (size_t i = 0; i < force_sensor_displays.size(); ++i) {
+				graphics->updateDisplayedForceSensor(force_sensor_displays[i], snapshot.forces[i], snapshot.moments[i]);
 			}
 		}
-		graphics->updateDisplayedForceSensor(sim->getAllForceSensorData()[0]);
-		graphics->updateDisplayedForceSensor(sim->getAllForceSensorData()[1]);
-		graphics->renderGraphicsWorld();
 
 		newCamPos = robot_q.head(3) + Vector3d(-2, 0, 3); //Sets the camera position
 		newCamVert = Vector3d::UnitZ(); //Sets the reference vertical for the camera
 		newCamLookat = robot_q.head(3); //Tells the camera what to look at
-		
-		
-		graphics->renderGraphicsWorld();
 		// graphics->setCameraPose(camera_name, newCamPos, newCamVert, newCamLookat); //Updates the camera pose
-		// graphics->render(camera_name); //Renders the new camera
 
-		{
-			lock_guard<mutex> lock(mutex_torques);
-			ui_torques = graphics->getUITorques(robot_name);
-		}
+		graphics->presentFrame();
 	}
+	input_timer.stop();
 
     // stop simulation
 	fSimulationRunning = false;
@@ -157,52 +327,144 @@ int main() {
 }
 
 //------------------------------------------------------------------------------
-void simulation(std::shared_ptr<Sai2Simulation::Sai2Simulation> sim) {
-	fSimulationRunning = true;
-
-    // create redis client
-    auto redis_client = Sai2Common::RedisClient();
-    redis_client.connect();
-
-	// create a timer
+void simulation(std::shared_ptr<Sai2Simulation::Sai2Simulation> sim,
+				Ocean1::SimForceSensors* force_sensors,
+				Ocean1::SimTransport* transport,
+				const SimulationOptions& options,
+				Ocean1::ControllerPlugin* controller,
+				Ocean1::TripleBuffer<SimSnapshot>* snapshots) {
+	// in lockstep mode, each iteration waits for the torques computed from
+	// the last published state, then integrates a whole control period. An
+	// in process controller is stepped the same way, without waiting.
 	double sim_freq = 2000;
-	Sai2Common::LoopTimer timer(sim_freq);
+	const double control_freq = 1000;
+	const bool control_period_steps = options.lockstep || controller != nullptr;
+	const int substeps = control_period_steps ? (int)round(sim_freq / control_freq) : 1;
+
+	// create a timer. It ticks at the iteration rate times the real time
+	// factor, and is not waited on when the factor is 0
+	const bool paced = options.real_time_factor > 0;
+	Sai2Common::LoopTimer timer(paced ? sim_freq / substeps * options.real_time_factor : sim_freq);
+	const auto start_time = chrono::steady_clock::now();
+	unsigned long steps = 0;
 
 	sim->setTimestep(1.0 / sim_freq);
     sim->enableGravityCompensation(true);
 	sim->enableJointLimits(robot_name);
 
-	while (fSimulationRunning) {
-		timer.waitForNextLoop();
+	VectorXd control_torques;
+	Ocean1::SimState state;
+	// stamp of the state the applied torques were computed from
+	Ocean1::SimStamp command_stamp;
+	Ocean1::LatencyStats latency_stats;
+	uint64_t state_seq = 0;
+	Ocean1::RateLimiter snapshot_rate(options.snapshot_rate > 0 ? 1.0 / options.snapshot_rate : 0.0);
+
+	// joint state and contact forces at the simulation rate, written to disk
+	// by a background thread
+	Ocean1::TelemetryLogger telemetry("telemetry_simviz.bin");
+	const int dof = sim->getJointPositions(robot_name).size();
+	vector<string> state_columns = {"state_seq"};
+	for (int i = 0; i < dof; ++i) {
+		state_columns.push_back("q" + to_string(i));
+	}
+	for (int i = 0; i < dof; ++i) {
+		state_columns.push_back("dq" + to_string(i));
+	}
+	for (const char* side : {"left", "right"}) {
+		for (const char* axis : {"x", "y", "z"}) {
+			state_columns.push_back(string("force_") + side + "_" + axis);
+		}
+	}
+	const int state_stream = telemetry.addStream("sim_state", state_columns);
+	telemetry.start();
+
+	// the moments are not sent to the controller
+	Vector3d moment;
+	auto publishSimState = [&]() {
+		// force sensor data, also read by the snapshots
+		force_sensors->update();
+		force_sensors->read(force_sensor_left, state.force_left, moment);
+		force_sensors->read(force_sensor_right, state.force_right, moment);
+		state.q = sim->getJointPositions(robot_name);
+		state.dq = sim->getJointVelocities(robot_name);
+		state.stamp.seq = ++state_seq;
+		state.stamp.timestamp = Ocean1::monotonicSeconds();
+		if (!controller) {
+			transport->publishState(state);
+		}
+		if (auto* record = telemetry.beginRecord(state_stream, state.stamp.timestamp)) {
+			record->append(state.stamp.seq);
+			record->append(state.q);
+			record->append(state.dq);
+			record->append(state.force_left);
+			record->append(state.force_right);
+			telemetry.commitRecord();
+		}
+	};
 
-		VectorXd control_torques = redis_client.getEigen(JOINT_TORQUES_COMMANDED_KEY);
+	if (control_period_steps) {
+		// the controller computes its first tick from the initial state
+		publishSimState();
+	}
+	while (fSimulationRunning) {
+		if (paced) {
+			timer.waitForNextLoop();
+		}
+		if (controller) {
+			// the controller runs on simulated time
+			control_torques = controller->step(state, steps / sim_freq);
+			command_stamp = state.stamp;
+		} else {
+			// the timeout lets the loop notice a stop request. The state is
+			// published again, for a controller started after it was
+			// published: only notified states start the controller
+			if (options.lockstep && !transport->waitForTorques(state.stamp, 0.1)) {
+				transport->publishState(state);
+				continue;
+			}
+			transport->readTorques(control_torques, command_stamp);
+		}
+		latency_stats.recordCommand(command_stamp, Ocean1::monotonicSeconds());
 		{
 			lock_guard<mutex> lock(mutex_torques);
 			sim->setJointTorques(robot_name, control_torques + ui_torques);
 		}
-		sim->integrate();
-		// force sensor data
-		auto force_data = sim->getAllForceSensorData();
-		for (auto force : force_data) {
-			if (force.link_name == "endEffector_right") {
-				redis_client.setEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_RIGHT, force.force_world_frame);
-			} else if (force.link_name == "endEffector_left") {
-				redis_client.setEigen(SIMULATED_COMMANDED_FORCE_KEY_SUFFIX_LEFT, force.force_world_frame);
-			}
+		for (int i = 0; i < substeps; ++i) {
+			sim->integrate();
 		}
-        redis_client.setEigen(JOINT_ANGLES_KEY, sim->getJointPositions(robot_name));
-        redis_client.setEigen(JOINT_VELOCITIES_KEY, sim->getJointVelocities(robot_name));
-
-		// update object information 
-		{
-			lock_guard<mutex> lock(mutex_update);
+		publishSimState();
+
+		// update object information for the render loop, which picks up the
+		// latest snapshot without ever blocking this thread
+		if (snapshots && snapshot_rate.ready(state.stamp.timestamp)) {
+			SimSnapshot& snapshot = snapshots->writeBuffer();
+			snapshot.time = (steps + substeps) / sim_freq;
+			snapshot.q = state.q;
+			snapshot.dq = state.dq;
 			for (int i = 0; i < n_objects; ++i) {
-				object_poses[i] = sim->getObjectPose(object_names[i]);
-				object_velocities[i] = sim->getObjectVelocity(object_names[i]);
+				snapshot.object_poses[i] = sim->getObjectPose(object_names[i]);
+				snapshot.object_velocities[i] = sim->getObjectVelocity(object_names[i]);
 			}
+			force_sensors->readAll(snapshot.forces, snapshot.moments);
+			snapshots->publish();
+		}
+
+		steps += substeps;
+		if (options.duration > 0 && steps / sim_freq >= options.duration) {
+			fSimulationRunning = false;
 		}
 	}
 	timer.stop();
-	cout << "\nSimulation loop timer stats:\n";
-	timer.printInfoPostRun();
+	if (paced) {
+		cout << "\nSimulation loop timer stats:\n";
+		timer.printInfoPostRun();
+	}
+	const double wall_time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	cout << "\nSimulated " << steps / sim_freq << " s in " << wall_time
+		 << " s of wall time, real time factor " << steps / sim_freq / wall_time << "\n";
+	cout << "\nCommanded torques latency stats:\n";
+	latency_stats.printInfo(cout);
+	telemetry.stop();
+	telemetry.printInfoPostRun();
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock free single producer, single consumer ring buffer of fixed
+ * capacity. Slots are written and read in place, so the producer never
+ * allocates, locks or makes a system call.
+ *
+ */
+
+#ifndef OCEAN1_SPSC_RING_H
+#define OCEAN1_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace Ocean1 {
+
+template <typename T>
+class SpscRing {
+public:
+	/**
+	 * @param capacity number of slots, must be a power of two
+	 */
+	explicit SpscRing(size_t capacity)
+		: _slots(capacity),
+		  _mask(capacity - 1),
+		  _head(0),
+		  _tail(0),
+		  _cached_tail(0),
+		  _cached_head(0) {
+		if (capacity == 0 || (capacity & _mask) != 0) {
+			throw std::invalid_argument(
+				"SpscRing capacity must be a power of two");
+		}
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	size_t capacity() const { return _slots.size(); }
+
+	// producer side
+
+	/**
+	 * @brief slot to fill before publish(), or nullptr if the ring is full
+	 */
+	T* reserve() {
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _cached_tail == _slots.size()) {
+			_cached_tail = _tail.load(std::memory_order_acquire);
+			if (head - _cached_tail == _slots.size()) {
+				return nullptr;
+			}
+		}
+		return &_slots[head & _mask];
+	}
+
+	/**
+	 * @brief make the slot returned by reserve() visible to the consumer
+	 */
+	void publish() {
+		_head.store(_head.load(std::memory_order_relaxed) + 1,
+					std::memory_order_release);
+	}
+
+	// consumer side
+
+	/**
+	 * @brief oldest published slot, or nullptr if the ring is empty
+	 */
+	const T* front() {
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _cached_head) {
+			_cached_head = _head.load(std::memory_order_acquire);
+			if (tail == _cached_head) {
+				return nullptr;
+			}
+		}
+		return &_slots[tail & _mask];
+	}
+
+	/**
+	 * @brief release the slot returned by front()
+	 */
+	void pop() {
+		_tail.store(_tail.load(std::memory_order_relaxed) + 1,
+					std::memory_order_release);
+	}
+
+private:
+	std::vector<T> _slots;
+	const size_t _mask;
+	// the indices only increase, the slot is index & mask. Each side keeps a
+	// copy of the other side's index to touch the shared cache line less.
+	alignas(64) std::atomic<size_t> _head;
+	alignas(64) std::atomic<size_t> _tail;
+	alignas(64) size_t _cached_tail;  // producer only
+	alignas(64) size_t _cached_head;  // consumer only
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_SPSC_RING_H
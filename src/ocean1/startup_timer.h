@@ -0,0 +1,64 @@
+/**
+ * @file startup_timer.h
+ * @brief Wall clock time of the startup phases of an executable, printed as
+ * a report once startup is done
+ *
+ */
+
+#ifndef OCEAN1_STARTUP_TIMER_H
+#define OCEAN1_STARTUP_TIMER_H
+
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Ocean1 {
+
+class StartupTimer {
+public:
+	StartupTimer() : _start(Clock::now()), _phase_start(_start) {}
+
+	/**
+	 * @brief end the current phase (the time since the previous call, or since
+	 * construction) and record it under the given name
+	 */
+	void phase(const std::string& name) {
+		const auto now = Clock::now();
+		_phases.emplace_back(
+			name, std::chrono::duration<double>(now - _phase_start).count());
+		_phase_start = now;
+	}
+
+	/**
+	 * @brief print the duration and share of each phase, and the total
+	 */
+	void print(std::ostream& stream) const {
+		const double total =
+			std::chrono::duration<double>(_phase_start - _start).count();
+		stream << "startup phases:" << std::endl;
+		for (const auto& phase : _phases) {
+			stream << "  " << std::left << std::setw(28) << phase.first
+				   << std::right << std::fixed << std::setprecision(1)
+				   << std::setw(9) << 1e3 * phase.second << " ms "
+				   << std::setw(5)
+				   << (total > 0 ? 100.0 * phase.second / total : 0.0) << " %"
+				   << std::endl;
+		}
+		stream << "  " << std::left << std::setw(28) << "total" << std::right
+			   << std::setw(9) << 1e3 * total << " ms" << std::endl;
+		stream << std::defaultfloat;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point _start;
+	Clock::time_point _phase_start;
+	std::vector<std::pair<std::string, double>> _phases;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_STARTUP_TIMER_H
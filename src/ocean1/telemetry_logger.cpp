@@ -0,0 +1,197 @@
+/**
+ * @file telemetry_logger.cpp
+ * @brief Asynchronous binary telemetry for the real time loops
+ *
+ */
+
+#include "telemetry_logger.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace Ocean1 {
+
+namespace {
+
+const char TELEMETRY_MAGIC[8] = {'O', 'C', '1', 'T', 'L', 'M', '0', '1'};
+
+}  // namespace
+
+TelemetryLogger::TelemetryLogger(const std::string& path,
+								 size_t ring_capacity, size_t chunk_bytes)
+	: _path(path),
+	  _ring(ring_capacity),
+	  _next_seq(0),
+	  _dropped(0),
+	  _written(0),
+	  _fd(-1),
+	  _chunk_bytes(chunk_bytes),
+	  _chunk(nullptr),
+	  _chunk_offset(0),
+	  _file_offset(0),
+	  _running(false) {
+	// the chunks are mapped at multiples of their size, which must be page
+	// aligned
+	const size_t page = sysconf(_SC_PAGESIZE);
+	_chunk_bytes = std::max(page, (chunk_bytes + page - 1) / page * page);
+
+	_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (_fd < 0) {
+		throw std::runtime_error("TelemetryLogger: cannot open " + path + ": " +
+								 strerror(errno));
+	}
+}
+
+TelemetryLogger::~TelemetryLogger() {
+	stop();
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+int TelemetryLogger::addStream(const std::string& name,
+							   const std::vector<std::string>& columns) {
+	if (_running) {
+		throw std::runtime_error(
+			"TelemetryLogger: streams must be added before start()");
+	}
+	if (columns.size() > TELEMETRY_MAX_VALUES) {
+		throw std::invalid_argument("TelemetryLogger: stream " + name +
+									" has too many columns");
+	}
+	const int id = _stream_descriptions.size();
+	std::string description = std::to_string(id) + " " + name + " ";
+	for (size_t i = 0; i < columns.size(); ++i) {
+		description += (i ? "," : "") + columns[i];
+	}
+	_stream_descriptions.push_back(description);
+	return id;
+}
+
+void TelemetryLogger::start() {
+	if (_running) {
+		return;
+	}
+	mapChunk(0);
+
+	// header, then the records start at TELEMETRY_HEADER_SIZE
+	std::string header(TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+	header += std::to_string(sizeof(TelemetryRecord)) + "\n";
+	for (const auto& description : _stream_descriptions) {
+		header += description + "\n";
+	}
+	if (header.size() > TELEMETRY_HEADER_SIZE) {
+		throw std::runtime_error(
+			"TelemetryLogger: stream descriptions do not fit in the header");
+	}
+	memset(_chunk, 0, TELEMETRY_HEADER_SIZE);
+	memcpy(_chunk, header.data(), header.size());
+	_file_offset = TELEMETRY_HEADER_SIZE;
+
+	_running = true;
+	_writer = std::thread(&TelemetryLogger::writerLoop, this);
+}
+
+void TelemetryLogger::stop() {
+	if (!_running) {
+		return;
+	}
+	_running = false;
+	_writer.join();
+
+	if (_chunk) {
+		munmap(_chunk, _chunk_bytes);
+		_chunk = nullptr;
+	}
+	if (ftruncate(_fd, _file_offset) != 0) {
+		std::cerr << "TelemetryLogger: cannot trim " << _path << ": "
+				  << strerror(errno) << std::endl;
+	}
+}
+
+TelemetryRecord* TelemetryLogger::beginRecord(int stream, double time) {
+	TelemetryRecord* record = _ring.reserve();
+	if (!record) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		++_next_seq;
+		return nullptr;
+	}
+	record->stream = stream;
+	record->num_values = 0;
+	record->reserved = 0;
+	record->seq = _next_seq++;
+	record->time = time;
+	return record;
+}
+
+void TelemetryLogger::writerLoop() {
+	// drain the ring, then sleep a bit. The loop threads never wait on the
+	// writer, so it can be slow to wake up as long as the ring does not fill
+	// (4096 records is 2 seconds at 2 kHz).
+	while (true) {
+		const bool running = _running.load();
+		while (const TelemetryRecord* record = _ring.front()) {
+			writeRecord(*record);
+			_ring.pop();
+		}
+		if (!running) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void TelemetryLogger::mapChunk(size_t offset) {
+	if (_chunk) {
+		munmap(_chunk, _chunk_bytes);
+		_chunk = nullptr;
+	}
+	// preallocate the blocks of the chunk so that writing to the mapping does
+	// not fault on a full disk
+	if (posix_fallocate(_fd, offset, _chunk_bytes) != 0 &&
+		ftruncate(_fd, offset + _chunk_bytes) != 0) {
+		throw std::runtime_error("TelemetryLogger: cannot grow " + _path);
+	}
+	void* chunk = mmap(nullptr, _chunk_bytes, PROT_READ | PROT_WRITE,
+					   MAP_SHARED, _fd, offset);
+	if (chunk == MAP_FAILED) {
+		throw std::runtime_error("TelemetryLogger: cannot map " + _path + ": " +
+								 strerror(errno));
+	}
+	_chunk = static_cast<char*>(chunk);
+	_chunk_offset = offset;
+}
+
+void TelemetryLogger::writeRecord(const TelemetryRecord& record) {
+	const char* data = reinterpret_cast<const char*>(&record);
+	size_t remaining = sizeof(TelemetryRecord);
+	// a record can straddle two chunks
+	while (remaining > 0) {
+		if (_file_offset == _chunk_offset + _chunk_bytes) {
+			mapChunk(_file_offset);
+		}
+		const size_t n = std::min(remaining,
+								  _chunk_offset + _chunk_bytes - _file_offset);
+		memcpy(_chunk + (_file_offset - _chunk_offset), data, n);
+		data += n;
+		remaining -= n;
+		_file_offset += n;
+	}
+	_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TelemetryLogger::printInfoPostRun() const {
+	std::cout << "\nTelemetry (" << _path << "):\n";
+	std::cout << "records written : " << writtenRecords() << "\n";
+	std::cout << "records dropped : " << droppedRecords() << "\n";
+}
+
+}  // namespace Ocean1
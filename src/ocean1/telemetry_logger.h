@@ -0,0 +1,161 @@
+/**
+ * @file telemetry_logger.h
+ * @brief Asynchronous binary telemetry for the real time loops. The loop
+ * thread fills fixed size records in place in a lock free ring, and a
+ * background thread copies them to a memory mapped, preallocated log file.
+ *
+ * File format (little endian):
+ * - a TELEMETRY_HEADER_SIZE bytes header: the 8 bytes magic "OC1TLM01",
+ *   the size of a record as a text line, then a text description of the
+ *   streams, one per line:
+ *   "<stream id> <stream name> <column>,<column>,...", padded with zeros
+ * - then TelemetryRecord structs back to back
+ *
+ */
+
+#ifndef OCEAN1_TELEMETRY_LOGGER_H
+#define OCEAN1_TELEMETRY_LOGGER_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+namespace Ocean1 {
+
+constexpr int TELEMETRY_MAX_VALUES = 64;
+constexpr size_t TELEMETRY_HEADER_SIZE = 4096;
+
+struct TelemetryRecord {
+	uint16_t stream;
+	uint16_t num_values;
+	uint32_t reserved;
+	// sequence number of the record in the logger, a gap means that records
+	// were dropped because the ring was full
+	uint64_t seq;
+	double time;
+	double values[TELEMETRY_MAX_VALUES];
+
+	/**
+	 * @brief append values to the record, the ones past
+	 * TELEMETRY_MAX_VALUES are dropped
+	 */
+	void append(const Eigen::Ref<const Eigen::VectorXd>& v) {
+		const int n = std::min<int>(v.size(), TELEMETRY_MAX_VALUES - num_values);
+		Eigen::Map<Eigen::VectorXd>(values + num_values, n) = v.head(n);
+		num_values += n;
+	}
+	void append(double value) {
+		if (num_values < TELEMETRY_MAX_VALUES) {
+			values[num_values++] = value;
+		}
+	}
+};
+
+class TelemetryLogger {
+public:
+	/**
+	 * @param path log file, truncated
+	 * @param ring_capacity number of records the ring holds (power of two)
+	 * @param chunk_bytes the file is grown and mapped by chunks of that size
+	 */
+	TelemetryLogger(const std::string& path, size_t ring_capacity = 4096,
+					size_t chunk_bytes = 64 << 20);
+	~TelemetryLogger();
+
+	TelemetryLogger(const TelemetryLogger&) = delete;
+	TelemetryLogger& operator=(const TelemetryLogger&) = delete;
+
+	/**
+	 * @brief declare a stream, before start()
+	 *
+	 * @return stream id to pass to beginRecord
+	 */
+	int addStream(const std::string& name,
+				  const std::vector<std::string>& columns);
+
+	/**
+	 * @brief write the header and start the writer thread
+	 */
+	void start();
+
+	/**
+	 * @brief drain the ring, trim the file to its content and stop the writer
+	 * thread. Called by the destructor.
+	 */
+	void stop();
+
+	/**
+	 * @brief real time side: slot of a new record, to be filled with append()
+	 * and committed with commitRecord(). Returns nullptr, and counts a dropped
+	 * record, if the writer thread is behind.
+	 */
+	TelemetryRecord* beginRecord(int stream, double time);
+	void commitRecord() { _ring.publish(); }
+
+	uint64_t droppedRecords() const {
+		return _dropped.load(std::memory_order_relaxed);
+	}
+	uint64_t writtenRecords() const {
+		return _written.load(std::memory_order_relaxed);
+	}
+
+	void printInfoPostRun() const;
+
+private:
+	void writerLoop();
+	void mapChunk(size_t offset);
+	void writeRecord(const TelemetryRecord& record);
+
+	std::string _path;
+	std::vector<std::string> _stream_descriptions;
+	SpscRing<TelemetryRecord> _ring;
+	uint64_t _next_seq;
+	std::atomic<uint64_t> _dropped;
+	std::atomic<uint64_t> _written;
+
+	// writer thread state
+	int _fd;
+	size_t _chunk_bytes;
+	char* _chunk;
+	size_t _chunk_offset;	// file offset of the mapped chunk
+	size_t _file_offset;	// end of the written data
+	std::atomic<bool> _running;
+	std::thread _writer;
+};
+
+/**
+ * @brief lets a periodic action (console output) through at most once per
+ * period
+ *
+ */
+class RateLimiter {
+public:
+	explicit RateLimiter(double period_seconds)
+		: _period(period_seconds), _next_time(0.0) {}
+
+	/**
+	 * @param time current time in seconds
+	 * @return true if the period elapsed since the last time it returned true
+	 */
+	bool ready(double time) {
+		if (time < _next_time) {
+			return false;
+		}
+		_next_time = time + _period;
+		return true;
+	}
+
+private:
+	double _period;
+	double _next_time;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_TELEMETRY_LOGGER_H
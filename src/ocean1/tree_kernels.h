@@ -0,0 +1,187 @@
+/**
+ * @file tree_kernels.h
+ * @brief Block sparse task model kernels for a kinematic tree of BASE_DOF
+ * base joints shared by NUM_CHAINS chains of CHAIN_DOF joints, in this order
+ * in the joint vector (ocean1: a 6 dof base and two 7 dof arms). A 6 dof
+ * task on the end of chain i only moves with the base and chain i joints, so
+ * its Jacobian is zero on the columns of the other chains. The kernels take
+ * a Jacobian stacking one such task per chain, 6 rows per chain in chain
+ * order, and skip the products with those zero columns.
+ *
+ */
+
+#ifndef OCEAN1_TREE_KERNELS_H
+#define OCEAN1_TREE_KERNELS_H
+
+#include <Eigen/Dense>
+
+namespace Ocean1 {
+
+template <int BASE_DOF, int CHAIN_DOF, int NUM_CHAINS>
+struct TreeKernels {
+	static constexpr int DOF = BASE_DOF + CHAIN_DOF * NUM_CHAINS;
+	static constexpr int TASK_DOF = 6 * NUM_CHAINS;
+
+	// first joint of a chain
+	static constexpr int chainStart(int chain) {
+		return BASE_DOF + CHAIN_DOF * chain;
+	}
+
+	/**
+	 * @brief true if J (TASK_DOF x DOF) has the tree structure: the rows of
+	 * the task of each chain are zero on the columns of the other chains.
+	 * Checked once, the columns of the joints a task does not depend on are
+	 * exactly zero whatever the configuration.
+	 */
+	template <typename JacobianType>
+	static bool hasTreeStructure(const JacobianType& J) {
+		if (J.rows() != TASK_DOF || J.cols() != DOF) {
+			return false;
+		}
+		for (int task = 0; task < NUM_CHAINS; ++task) {
+			for (int chain = 0; chain < NUM_CHAINS; ++chain) {
+				if (chain != task &&
+					!J.template block<6, CHAIN_DOF>(6 * task,
+													chainStart(chain))
+						 .isZero(0.0)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief M^-1 J^T (DOF x 6) of the task J (6 x DOF) of one chain
+	 */
+	template <typename JacobianType, typename MassType, typename OutType>
+	static void taskMInvJt(int chain, const JacobianType& J,
+						   const MassType& M_inv, OutType&& out) {
+		out.noalias() = M_inv.template leftCols<BASE_DOF>() *
+						J.template leftCols<BASE_DOF>().transpose();
+		out.noalias() +=
+			M_inv.template middleCols<CHAIN_DOF>(chainStart(chain)) *
+			J.template middleCols<CHAIN_DOF>(chainStart(chain)).transpose();
+	}
+
+	/**
+	 * @brief J M^-1 J^T (6 x 6) of the task J of one chain, from its M^-1 J^T
+	 */
+	template <typename JacobianType, typename MInvJtType, typename OutType>
+	static void taskLambdaInv(int chain, const JacobianType& J,
+							  const MInvJtType& M_inv_Jt, OutType&& out) {
+		out.noalias() = J.template leftCols<BASE_DOF>() *
+						M_inv_Jt.template topRows<BASE_DOF>();
+		out.noalias() +=
+			J.template middleCols<CHAIN_DOF>(chainStart(chain)) *
+			M_inv_Jt.template middleRows<CHAIN_DOF>(chainStart(chain));
+	}
+
+	/**
+	 * @brief M^-1 J^T (DOF x TASK_DOF) of the stacked Jacobian
+	 */
+	template <typename JacobianType, typename MassType, typename OutType>
+	static void MInvJt(const JacobianType& J, const MassType& M_inv,
+					   OutType& out) {
+		for (int chain = 0; chain < NUM_CHAINS; ++chain) {
+			taskMInvJt(chain, J.template middleRows<6>(6 * chain), M_inv,
+					   out.template middleCols<6>(6 * chain));
+		}
+	}
+
+	/**
+	 * @brief J M^-1 J^T (TASK_DOF x TASK_DOF) of the stacked Jacobian, from
+	 * its M^-1 J^T. The blocks below the diagonal are copied from those
+	 * above.
+	 */
+	template <typename JacobianType, typename MInvJtType, typename OutType>
+	static void lambdaInv(const JacobianType& J, const MInvJtType& M_inv_Jt,
+						  OutType& out) {
+		for (int row = 0; row < NUM_CHAINS; ++row) {
+			for (int col = row; col < NUM_CHAINS; ++col) {
+				taskLambdaInv(row, J.template middleRows<6>(6 * row),
+							  M_inv_Jt.template middleCols<6>(6 * col),
+							  out.template block<6, 6>(6 * row, 6 * col));
+				if (col != row) {
+					out.template block<6, 6>(6 * col, 6 * row) =
+						out.template block<6, 6>(6 * row, 6 * col)
+							.transpose();
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief factorizations and temporaries of lambda
+	 */
+	struct LambdaWorkspace {
+		Eigen::LLT<Eigen::Matrix<double, 6, 6>> llt_first;
+		Eigen::LLT<Eigen::Matrix<double, 6, 6>> llt_schur;
+		Eigen::Matrix<double, 6, 6> first_inv;
+		Eigen::Matrix<double, 6, 6> coupling;
+		Eigen::Matrix<double, 6, 6> schur_inv;
+	};
+
+	/**
+	 * @brief Lambda = (J M^-1 J^T)^-1 for two chains, inverted by 6 x 6
+	 * blocks: the block of the first chain, then the Schur complement of the
+	 * second one. Two 6 x 6 factorizations replace the factorization of the
+	 * whole matrix and its triangular solves. Returns false, leaving Lambda
+	 * unspecified, if a block is not positive definite (singular task).
+	 */
+	template <typename LambdaInvType, typename OutType>
+	static bool lambda(const LambdaInvType& Lambda_inv, LambdaWorkspace& ws,
+					   OutType& Lambda) {
+		static_assert(NUM_CHAINS == 2, "block inverse of two chains only");
+		ws.llt_first.compute(Lambda_inv.template topLeftCorner<6, 6>());
+		if (ws.llt_first.info() != Eigen::Success) {
+			return false;
+		}
+		ws.first_inv.setIdentity();
+		ws.llt_first.solveInPlace(ws.first_inv);
+		// A^-1 B
+		ws.coupling.noalias() =
+			ws.first_inv * Lambda_inv.template topRightCorner<6, 6>();
+		// S = C - B^T A^-1 B
+		ws.schur_inv = Lambda_inv.template bottomRightCorner<6, 6>();
+		ws.schur_inv.noalias() -=
+			Lambda_inv.template topRightCorner<6, 6>().transpose() *
+			ws.coupling;
+		ws.llt_schur.compute(ws.schur_inv);
+		if (ws.llt_schur.info() != Eigen::Success) {
+			return false;
+		}
+		ws.schur_inv.setIdentity();
+		ws.llt_schur.solveInPlace(ws.schur_inv);
+		Lambda.template bottomRightCorner<6, 6>() = ws.schur_inv;
+		Lambda.template topRightCorner<6, 6>().noalias() =
+			-ws.coupling * ws.schur_inv;
+		Lambda.template bottomLeftCorner<6, 6>() =
+			Lambda.template topRightCorner<6, 6>().transpose();
+		Lambda.template topLeftCorner<6, 6>() = ws.first_inv;
+		Lambda.template topLeftCorner<6, 6>().noalias() -=
+			Lambda.template topRightCorner<6, 6>() * ws.coupling.transpose();
+		return true;
+	}
+
+	/**
+	 * @brief N = I - Jbar J (DOF x DOF) of the stacked Jacobian, given its
+	 * dynamically consistent inverse Jbar (DOF x TASK_DOF)
+	 */
+	template <typename JacobianType, typename JbarType, typename OutType>
+	static void nullspace(const JacobianType& J, const JbarType& Jbar,
+						  OutType& N) {
+		N.setIdentity();
+		N.template leftCols<BASE_DOF>().noalias() -=
+			Jbar * J.template leftCols<BASE_DOF>();
+		for (int chain = 0; chain < NUM_CHAINS; ++chain) {
+			N.template middleCols<CHAIN_DOF>(chainStart(chain)).noalias() -=
+				Jbar.template middleCols<6>(6 * chain) *
+				J.template block<6, CHAIN_DOF>(6 * chain, chainStart(chain));
+		}
+	}
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_TREE_KERNELS_H
@@ -0,0 +1,98 @@
+/**
+ * @file triple_buffer.h
+ * @brief Lock free triple buffer, to hand the latest value of a single
+ * producer to a single consumer. Neither side ever waits: the producer
+ * overwrites values the consumer did not pick up, and the consumer keeps its
+ * current value until a newer one is published.
+ *
+ */
+
+#ifndef OCEAN1_TRIPLE_BUFFER_H
+#define OCEAN1_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace Ocean1 {
+
+template <typename T>
+class TripleBuffer {
+public:
+	/**
+	 * @param initial value of the three buffers. The values are assigned in
+	 * place afterwards, so with a correctly sized initial value, publishing
+	 * Eigen vectors and std::vectors of the same size does not allocate.
+	 */
+	explicit TripleBuffer(const T& initial = T())
+		: _slots{{initial}, {initial}, {initial}},
+		  _write_index(0),
+		  _middle(1),
+		  _read_index(2) {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// producer side
+
+	/**
+	 * @brief buffer to fill before publish(). It is not seen by the consumer
+	 * and keeps the value written before the previous publication but one.
+	 */
+	T& writeBuffer() { return _slots[_write_index].value; }
+
+	/**
+	 * @brief make the write buffer the latest value, and get a new write
+	 * buffer
+	 */
+	void publish() {
+		_write_index =
+			_middle.exchange(_write_index | FRESH, std::memory_order_acq_rel) &
+			INDEX_MASK;
+	}
+
+	// consumer side
+
+	/**
+	 * @brief pick up the latest published value, if any
+	 *
+	 * @return true if the read buffer changed
+	 */
+	bool update() {
+		if (!(_middle.load(std::memory_order_relaxed) & FRESH)) {
+			return false;
+		}
+		_read_index =
+			_middle.exchange(_read_index, std::memory_order_acq_rel) &
+			INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * @brief value picked up by the last update(), owned by the consumer until
+	 * the next one
+	 */
+	const T& readBuffer() const { return _slots[_read_index].value; }
+
+private:
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	// set in the middle index when it holds a value the consumer did not
+	// pick up yet
+	static constexpr uint8_t FRESH = 0x4;
+
+	// one cache line per buffer, so the two sides do not share lines
+	struct alignas(64) Slot {
+		T value;
+	};
+	Slot _slots[3];
+
+	// only used by the producer
+	alignas(64) uint8_t _write_index;
+	// exchanged by both sides
+	alignas(64) std::atomic<uint8_t> _middle;
+	// only used by the consumer
+	alignas(64) uint8_t _read_index;
+};
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_TRIPLE_BUFFER_H
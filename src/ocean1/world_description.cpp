@@ -0,0 +1,104 @@
+/**
+ * @file world_description.cpp
+ * @brief Parser of the robots and objects of a sai2 world file
+ *
+ */
+
+#include "world_description.h"
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace Ocean1 {
+
+namespace {
+
+std::string attribute(const std::string& element, const std::string& name) {
+	const std::regex attribute_regex("\\b" + name + "\\s*=\\s*\"([^\"]*)\"");
+	std::smatch match;
+	if (std::regex_search(element, match, attribute_regex)) {
+		return match[1];
+	}
+	return "";
+}
+
+std::string substituteFolders(
+	std::string value, const std::map<std::string, std::string>& folders) {
+	for (const auto& folder : folders) {
+		const std::string variable = "${" + folder.first + "}";
+		size_t position;
+		while ((position = value.find(variable)) != std::string::npos) {
+			value.replace(position, variable.size(), folder.second);
+		}
+	}
+	return value;
+}
+
+}  // namespace
+
+const RobotDescription& WorldDescription::robot(const std::string& name) const {
+	for (const auto& robot : robots) {
+		if (robot.name == name) {
+			return robot;
+		}
+	}
+	throw std::invalid_argument("robot " + name + " not found in " +
+								world_file);
+}
+
+std::vector<std::string> WorldDescription::dynamicObjectNames() const {
+	std::vector<std::string> names;
+	for (const auto& object : objects) {
+		if (object.dynamic) {
+			names.push_back(object.name);
+		}
+	}
+	return names;
+}
+
+WorldDescription parseWorldDescription(
+	const std::string& world_file,
+	const std::map<std::string, std::string>& urdf_folders) {
+	std::ifstream file(world_file);
+	if (!file) {
+		throw std::runtime_error("cannot read world file " + world_file);
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string xml = std::regex_replace(
+		contents.str(), std::regex("<!--[\\s\\S]*?-->"), "");
+
+	WorldDescription world;
+	world.world_file = world_file;
+	// top level elements: <tag name="..."> ... </tag>, or <tag .../>
+	const std::regex element_regex(
+		"<(robot|static_object|dynamic_object)\\b([^>]*?)(/>|>([\\s\\S]*?)</"
+		"\\1\\s*>)");
+	for (std::sregex_iterator it(xml.begin(), xml.end(), element_regex), end;
+		 it != end; ++it) {
+		const std::string tag = (*it)[1];
+		const std::string name = attribute((*it)[2], "name");
+		const std::string body = (*it)[4];
+		if (tag == "robot") {
+			RobotDescription robot;
+			robot.name = name;
+			std::smatch model;
+			if (std::regex_search(body, model, std::regex("<model[^>]*>"))) {
+				robot.model_file =
+					substituteFolders(attribute(model[0], "dir"), urdf_folders) +
+					"/" + attribute(model[0], "path");
+			}
+			world.robots.push_back(robot);
+		} else {
+			ObjectDescription object;
+			object.name = name;
+			object.dynamic = tag == "dynamic_object";
+			world.objects.push_back(object);
+		}
+	}
+	return world;
+}
+
+}  // namespace Ocean1
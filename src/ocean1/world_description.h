@@ -0,0 +1,59 @@
+/**
+ * @file world_description.h
+ * @brief Robots and objects of a sai2 world file, read once at
+ * startup so that simviz does not hardcode them nor parse robot files again
+ * to find them
+ *
+ */
+
+#ifndef OCEAN1_WORLD_DESCRIPTION_H
+#define OCEAN1_WORLD_DESCRIPTION_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Ocean1 {
+
+struct RobotDescription {
+	std::string name;
+	// robot urdf file, with the folder variables substituted
+	std::string model_file;
+};
+
+struct ObjectDescription {
+	std::string name;
+	// moved by the simulation (dynamic_object) or not (static_object)
+	bool dynamic = false;
+};
+
+struct WorldDescription {
+	std::string world_file;
+	std::vector<RobotDescription> robots;
+	std::vector<ObjectDescription> objects;
+
+	/**
+	 * @brief the robot with the given name, throws std::invalid_argument if
+	 * there is none
+	 */
+	const RobotDescription& robot(const std::string& name) const;
+
+	/**
+	 * @brief names of the dynamic objects, in the order of the world file
+	 */
+	std::vector<std::string> dynamicObjectNames() const;
+};
+
+/**
+ * @brief read the robots and objects of a world file. Commented out
+ * elements are ignored, and the "${NAME}" folder variables of the robot model
+ * directories are replaced by their value in urdf_folders. Throws
+ * std::runtime_error if the file cannot be read.
+ */
+WorldDescription parseWorldDescription(
+	const std::string& world_file,
+	const std::map<std::string, std::string>& urdf_folders);
+
+}  // namespace Ocean1
+
+#endif	// OCEAN1_WORLD_DESCRIPTION_H